@@ -0,0 +1,95 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include "tinyshell.h"
+
+double now_seconds(void){ // Creating a function to read the monotonic clock in seconds
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+double run_pipeline(struct tinyshell *shell, int stages, const char *pipeSize, const char *stage, long bytes, bool spread){ // Creating a function to measure the throughput of a pipeline in GB/s
+
+    size_t length = 128 + stages * (strlen(stage) + 4);
+    char *command = malloc(length);
+    if(command==NULL){
+        perror("Unable to allocate memory!");
+        return -1;
+    }
+
+    // The first stage produces the data and the last one throws it away, every stage in between copies it
+    int written = snprintf(command, length, "pipesize %s %shead -c %ld /dev/zero", pipeSize, spread ? "sched -s " : "", bytes); // 'sched -s' pins the stages to neighbouring cores of one socket
+    for(int i=1; i<stages-1; i++){
+        written += snprintf(command + written, length - written, " | %s", stage);
+    }
+    snprintf(command + written, length - written, " | cat > /dev/null");
+
+    double start = now_seconds();
+    int status = tinyshell_run(shell, command);
+    double elapsed = now_seconds() - start;
+    if(status!=0){
+        fprintf(stderr,"Error: '%s' failed with status %d\n", command, status);
+        free(command);
+        return -1;
+    }
+    free(command);
+    return bytes / elapsed / 1e9;
+}
+
+int main(int argc, char **argv){
+
+    long mib = 1024; // The amount of data pushed through every pipeline
+    const char *stage = "cat"; // The command of the middle stages
+    bool spread = false; // Whether every depth is measured a second time with its stages spread over neighbouring cores
+    const char *sizes[] = {"64K", "256K", "1M"}; // The pipe sizes which are compared
+    int depths[] = {2, 4, 8}; // The number of stages which are compared
+
+    for(int i=1; i<argc; i++){ // Parsing the command line options
+        if(strcmp(argv[i],"-s")==0 && i+1<argc){
+            mib = atol(argv[++i]);
+        }else if(strcmp(argv[i],"--stage")==0 && i+1<argc){
+            stage = argv[++i];
+        }else if(strcmp(argv[i],"--spread")==0){
+            spread = true;
+        }else{
+            fprintf(stderr,"Usage: %s [-s MiB] [--stage command] [--spread]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    struct tinyshell *shell = tinyshell_create();
+    if(shell==NULL){
+        perror("Unable to allocate memory!");
+        return EXIT_FAILURE;
+    }
+
+    printf("%-8s", "stages");
+    for(size_t s=0; s<sizeof(sizes)/sizeof(sizes[0]); s++){
+        printf("%12s", sizes[s]);
+    }
+    printf("   (GB/s, %ld MiB, middle stage '%s')\n", mib, stage);
+
+    for(size_t d=0; d<sizeof(depths)/sizeof(depths[0]) * (spread ? 2 : 1); d++){ // Measuring every depth with every pipe size, then again spread
+        size_t depth = d % (sizeof(depths)/sizeof(depths[0]));
+        bool spreading = d>=sizeof(depths)/sizeof(depths[0]);
+        char label[16];
+        snprintf(label, sizeof(label), spreading ? "%d-spread" : "%d", depths[depth]);
+        printf("%-8s", label);
+        for(size_t s=0; s<sizeof(sizes)/sizeof(sizes[0]); s++){
+            double rate = run_pipeline(shell, depths[depth], sizes[s], stage, mib << 20, spreading);
+            if(rate<0){
+                tinyshell_destroy(shell);
+                return EXIT_FAILURE;
+            }
+            printf("%12.2f", rate);
+            fflush(stdout);
+        }
+        printf("\n");
+    }
+    tinyshell_destroy(shell);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,80 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include "tinyshell.h"
+
+double now_seconds(void){ // Creating a function to read the monotonic clock in seconds
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+double run_backend(struct tinyshell *shell, const char *backend, const char *command, int iterations){ // Creating a function to measure the spawn rate of a backend
+
+    struct tinyshell_prepared *prepared = tinyshell_prepare(shell, command); // Parsing once, so that only launching is measured
+    if(prepared==NULL || tinyshell_select_spawn_backend(backend)!=0){ // Selecting the backend under test
+        fprintf(stderr,"Error: Unable to prepare '%s' with the %s backend\n", command, backend); // Output error message
+        tinyshell_prepared_free(prepared);
+        return -1;
+    }
+
+    double start = now_seconds();
+    for(int i=0; i<iterations; i++){ // Launching and reaping the command repeatedly
+        if(tinyshell_execute(shell, prepared)!=0){
+            fprintf(stderr,"Error: '%s' failed with the %s backend\n", command, backend); // Output error message
+            tinyshell_prepared_free(prepared);
+            return -1;
+        }
+    }
+    double rate = iterations / (now_seconds() - start); // Commands per second
+    tinyshell_prepared_free(prepared);
+    return rate;
+}
+
+int main(int argc, char **argv){
+
+    int iterations = 2000; // Number of commands launched per backend
+    size_t rssMiB = 0; // Extra resident memory, to show how fork() slows down as the shell grows
+    const char *command = "/bin/true"; // The command which is launched, a path so that no builtin runs instead
+
+    for(int i=1; i<argc; i++){ // Parsing the command line options
+        if(strcmp(argv[i],"-n")==0 && i+1<argc){
+            iterations = atoi(argv[++i]);
+        }else if(strcmp(argv[i],"--rss")==0 && i+1<argc){
+            rssMiB = strtoul(argv[++i], NULL, 10);
+        }else{
+            fprintf(stderr,"Usage: %s [-n iterations] [--rss MiB]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if(rssMiB>0){ // Growing the resident set, touching every page so that it has to be mapped
+        char *ballast = malloc(rssMiB << 20);
+        if(ballast==NULL){
+            perror("Unable to allocate memory!");
+            return EXIT_FAILURE;
+        }
+        memset(ballast, 1, rssMiB << 20);
+    }
+
+    struct tinyshell *shell = tinyshell_create();
+    if(shell==NULL){
+        perror("Unable to allocate memory!");
+        return EXIT_FAILURE;
+    }
+
+    const char *backends[] = {"fork", "posix_spawn"};
+    for(size_t b=0; b<sizeof(backends)/sizeof(backends[0]); b++){ // Measuring every backend
+        double rate = run_backend(shell, backends[b], command, iterations);
+        if(rate<0){
+            tinyshell_destroy(shell);
+            return EXIT_FAILURE;
+        }
+        printf("%-12s %10.0f commands/sec (%d runs, %zu MiB extra RSS)\n", backends[b], rate, iterations, rssMiB);
+    }
+    tinyshell_destroy(shell);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,385 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "tinyshell.h"
+
+struct bench_options{ // Defining the settings shared by every benchmark
+    bool smoke; // Running every benchmark a few times only, to check that it works
+    const char *filter; // Running only the benchmarks whose name contains this text, or NULL
+    struct tinyshell *shell; // The context which runs every command
+    FILE *out; // Where the JSON report is written
+    bool first; // Whether no result was written yet
+    int failures; // The number of benchmarks which failed
+};
+
+double now_ns(void){ // Creating a function to read the monotonic clock in nanoseconds
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int compare_double(const void *a, const void *b){ // Creating a function to order samples, for 'qsort'
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+double percentile(const double *sorted, int count, double p){ // Creating a function to read a percentile of sorted samples
+    int index = (int)(p / 100.0 * (count - 1) + 0.5);
+    return sorted[index];
+}
+
+void report(struct bench_options *options, const char *name, const char *unit, double *samples, int count){ // Creating a function to write the percentiles of a benchmark as JSON
+
+    qsort(samples, count, sizeof(double), compare_double);
+    double sum = 0;
+    for(int i=0; i<count; i++){
+        sum += samples[i];
+    }
+    fprintf(options->out, "%s    {\"name\": \"%s\", \"unit\": \"%s\", \"samples\": %d, \"min\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f, \"mean\": %.3f}",
+        options->first ? "" : ",\n", name, unit, count, samples[0], percentile(samples, count, 50), percentile(samples, count, 90), percentile(samples, count, 99), samples[count-1], sum / count);
+    options->first = false;
+    fflush(options->out);
+}
+
+bool selected(struct bench_options *options, const char *name){ // Creating a function to apply the '--filter' option
+    return options->filter==NULL || strstr(name, options->filter)!=NULL;
+}
+
+void bench_parse(struct bench_options *options, const char *name, const char *line){ // Creating a function to measure the parser on a command line, in ns per line, including freeing what it allocated
+
+    if(!selected(options, name)){
+        return;
+    }
+    int batches = options->smoke ? 10 : 2000;
+    int batch = 100; // Lines parsed per sample, so that reading the clock does not dominate
+    double *samples = malloc(batches * sizeof(double));
+    if(samples==NULL){
+        options->failures++;
+        return;
+    }
+
+    for(int b=0; b<batches; b++){
+        double start = now_ns();
+        for(int i=0; i<batch; i++){
+            struct tinyshell_prepared *prepared = tinyshell_prepare(options->shell, line);
+            tinyshell_prepared_free(prepared);
+            if(prepared==NULL){
+                fprintf(stderr, "Error: '%s' does not parse\n", name);
+                options->failures++;
+                free(samples);
+                return;
+            }
+        }
+        samples[b] = (now_ns() - start) / batch;
+    }
+    report(options, name, "ns/line", samples, batches);
+    free(samples);
+}
+
+void bench_command(struct bench_options *options, const char *name, const char *line, int runs, int batch){ // Creating a function to measure a whole command line, in us per command
+
+    if(!selected(options, name)){
+        return;
+    }
+    if(options->smoke){
+        runs = runs < 5 ? runs : 5;
+    }
+    double *samples = malloc(runs * sizeof(double));
+    if(samples==NULL){
+        options->failures++;
+        return;
+    }
+
+    for(int r=0; r<runs; r++){
+        double start = now_ns();
+        for(int i=0; i<batch; i++){
+            if(tinyshell_run(options->shell, line)!=0){
+                fprintf(stderr, "Error: '%s' failed\n", line);
+                options->failures++;
+                free(samples);
+                return;
+            }
+        }
+        samples[r] = (now_ns() - start) / batch / 1e3;
+    }
+    report(options, name, "us/command", samples, runs);
+    free(samples);
+}
+
+void bench_spawn(struct bench_options *options){ // Creating a function to measure launching and reaping a single program, in us
+
+    if(!selected(options, "spawn/true")){
+        return;
+    }
+    int runs = options->smoke ? 5 : 2000;
+    struct tinyshell_prepared *prepared = tinyshell_prepare(options->shell, "/bin/true"); // Parsed once, so that only launching is measured
+    double *samples = malloc(runs * sizeof(double));
+    if(samples==NULL || prepared==NULL){
+        free(samples);
+        tinyshell_prepared_free(prepared);
+        options->failures++;
+        return;
+    }
+
+    for(int r=0; r<runs; r++){
+        double start = now_ns();
+        if(tinyshell_execute(options->shell, prepared)!=0){
+            fprintf(stderr, "Error: '/bin/true' failed\n");
+            options->failures++;
+            free(samples);
+            tinyshell_prepared_free(prepared);
+            return;
+        }
+        samples[r] = (now_ns() - start) / 1e3;
+    }
+    report(options, "spawn/true", "us/command", samples, runs);
+    free(samples);
+    tinyshell_prepared_free(prepared);
+}
+
+void bench_pipeline(struct bench_options *options, int stages, bool spread){ // Creating a function to measure the throughput of a pipeline of 'cat', in MB/s, optionally with its stages spread over neighbouring cores
+
+    char name[32];
+    snprintf(name, sizeof(name), spread ? "pipeline/%d/spread" : "pipeline/%d", stages);
+    if(!selected(options, name)){
+        return;
+    }
+    int runs = options->smoke ? 1 : 10;
+    long bytes = options->smoke ? 1L << 20 : 64L << 20;
+
+    char command[512];
+    int length = snprintf(command, sizeof(command), "%shead -c %ld /dev/zero", spread ? "sched -s " : "", bytes);
+    for(int i=1; i<stages; i++){
+        length += snprintf(command + length, sizeof(command) - length, " | cat");
+    }
+    snprintf(command + length, sizeof(command) - length, " > /dev/null");
+
+    double samples[10];
+    for(int r=0; r<runs; r++){
+        double start = now_ns();
+        if(tinyshell_run(options->shell, command)!=0){
+            fprintf(stderr, "Error: '%s' failed\n", command);
+            options->failures++;
+            return;
+        }
+        samples[r] = bytes / ((now_ns() - start) / 1e9) / 1e6;
+    }
+    report(options, name, "MB/s", samples, runs);
+}
+
+void count_candidate(void *data, const char *candidate){ // Creating a function to count completion candidates
+    (void)candidate;
+    (*(size_t*)data)++;
+}
+
+void bench_complete(struct bench_options *options){ // Creating a function to measure Tab completion of a command with 12000 programs on $PATH, in us
+
+    if(!selected(options, "complete/command")){
+        return;
+    }
+    int programs = options->smoke ? 500 : 12000;
+    char dir[] = "/tmp/tinyshell_bench_XXXXXX";
+    if(mkdtemp(dir)==NULL){
+        perror("Unable to create directory!");
+        options->failures++;
+        return;
+    }
+    char path[64];
+    for(int i=0; i<programs; i++){ // Empty executables are enough, completion never runs them
+        snprintf(path, sizeof(path), "%s/tool%05d", dir, i);
+        FILE *file = fopen(path, "w");
+        if(file!=NULL){
+            fclose(file);
+            chmod(path, 0755);
+        }
+    }
+    char *oldPath = getenv("PATH")!=NULL ? strdup(getenv("PATH")) : NULL;
+    setenv("PATH", dir, 1);
+
+    int runs = options->smoke ? 5 : 2000;
+    double *samples = malloc(runs * sizeof(double));
+    size_t found = 0;
+    tinyshell_complete("tool0", 5, count_candidate, &found); // The first completion builds the trie
+    for(int r=0; r<runs && samples!=NULL; r++){ // Every later one only checks that the directories did not change
+        found = 0;
+        double start = now_ns();
+        tinyshell_complete("tool001", 7, count_candidate, &found); // tool00100 to tool00199
+        samples[r] = (now_ns() - start) / 1e3;
+    }
+    if(samples==NULL || found!=100){
+        fprintf(stderr, "Error: completion found %zu candidates\n", found);
+        options->failures++;
+    }else{
+        report(options, "complete/command", "us/completion", samples, runs);
+    }
+    free(samples);
+
+    if(oldPath!=NULL){
+        setenv("PATH", oldPath, 1);
+        free(oldPath);
+    }
+    for(int i=0; i<programs; i++){
+        snprintf(path, sizeof(path), "%s/tool%05d", dir, i);
+        unlink(path);
+    }
+    rmdir(dir);
+}
+
+void bench_glob(struct bench_options *options){ // Creating a function to measure expanding a pattern in a directory of 100000 files, in ms
+
+    if(!selected(options, "glob/100k")){
+        return;
+    }
+    int files = options->smoke ? 1000 : 100000;
+    char dir[] = "/tmp/tinyshell_bench_XXXXXX";
+    if(mkdtemp(dir)==NULL){
+        perror("Unable to create directory!");
+        options->failures++;
+        return;
+    }
+    char path[64];
+    for(int i=0; i<files; i++){
+        snprintf(path, sizeof(path), "%s/file%06d", dir, i);
+        FILE *file = fopen(path, "w");
+        if(file!=NULL){
+            fclose(file);
+        }
+    }
+
+    char command[128];
+    snprintf(command, sizeof(command), "echo %s/file00*1 > /dev/null", dir); // Every directory entry is matched, a tenth of them are kept
+    int runs = options->smoke ? 5 : 50;
+    double samples[50];
+    for(int r=0; r<runs; r++){ // Every command line reads the directory again
+        double start = now_ns();
+        if(tinyshell_run(options->shell, command)!=0){
+            fprintf(stderr, "Error: '%s' failed\n", command);
+            options->failures++;
+            runs = 0;
+            break;
+        }
+        samples[r] = (now_ns() - start) / 1e6;
+    }
+    if(runs>0){
+        report(options, "glob/100k", "ms/command", samples, runs);
+    }
+
+    for(int i=0; i<files; i++){
+        snprintf(path, sizeof(path), "%s/file%06d", dir, i);
+        unlink(path);
+    }
+    rmdir(dir);
+}
+
+void bench_memo(struct bench_options *options){ // Creating a function to compare sorting 100000 lines with replaying the output of 'memo', in us
+
+    if(!selected(options, "memo/off") && !selected(options, "memo/hit")){
+        return;
+    }
+    char dir[] = "/tmp/tinyshell_bench_XXXXXX";
+    if(mkdtemp(dir)==NULL){
+        perror("Unable to create directory!");
+        options->failures++;
+        return;
+    }
+    char input[64];
+    snprintf(input, sizeof(input), "%s/input", dir);
+    FILE *file = fopen(input, "w");
+    for(int i=0; file!=NULL && i<100000; i++){
+        fprintf(file, "line %d\n", (i * 7919) % 100000);
+    }
+    if(file!=NULL){
+        fclose(file);
+    }
+    char *oldCache = getenv("TINYSHELL_CACHE")!=NULL ? strdup(getenv("TINYSHELL_CACHE")) : NULL;
+    setenv("TINYSHELL_CACHE", dir, 1); // A store of its own, so earlier runs cannot make the first command a hit
+
+    char command[128];
+    snprintf(command, sizeof(command), "/usr/bin/sort < %s > /dev/null", input);
+    bench_command(options, "memo/off", command, 50, 1);
+    snprintf(command, sizeof(command), "memo /usr/bin/sort < %s > /dev/null", input);
+    if(selected(options, "memo/hit")){
+        tinyshell_run(options->shell, command); // Warming up: this run sorts and stores, so every sample below is a hit
+    }
+    bench_command(options, "memo/hit", command, 1000, 1);
+
+    if(oldCache!=NULL){
+        setenv("TINYSHELL_CACHE", oldCache, 1);
+        free(oldCache);
+    }else{
+        unsetenv("TINYSHELL_CACHE");
+    }
+    snprintf(command, sizeof(command), "/bin/rm -rf %s", dir); // Removing the input and the store
+    tinyshell_run(options->shell, command);
+}
+
+int main(int argc, char **argv){
+
+    struct bench_options options = {false, NULL, NULL, stdout, true, 0};
+
+    for(int i=1; i<argc; i++){ // Parsing the command line options
+        if(strcmp(argv[i],"--smoke")==0){
+            options.smoke = true;
+        }else if(strcmp(argv[i],"--filter")==0 && i+1<argc){
+            options.filter = argv[++i];
+        }else if(strcmp(argv[i],"-o")==0 && i+1<argc){
+            options.out = fopen(argv[++i], "w");
+            if(options.out==NULL){
+                perror("Unable to open output file!");
+                return EXIT_FAILURE;
+            }
+        }else{
+            fprintf(stderr, "Usage: %s [--smoke] [--filter text] [-o file]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    options.shell = tinyshell_create();
+    if(options.shell==NULL){
+        perror("Unable to allocate memory!");
+        return EXIT_FAILURE;
+    }
+
+    // Generating the command lines for the parser
+    char longLine[4096] = "command";
+    for(int i=0; i<200; i++){
+        snprintf(longLine + strlen(longLine), sizeof(longLine) - strlen(longLine), " argument%d", i);
+    }
+    strcat(longLine, " | filter -v < input >> output");
+    char quotedLine[4096] = "printf";
+    for(int i=0; i<100; i++){
+        snprintf(quotedLine + strlen(quotedLine), sizeof(quotedLine) - strlen(quotedLine), i%2==0 ? " 'single %d quoted'" : " \"double \\\"%d\\\" quoted\"", i);
+    }
+
+    fprintf(options.out, "{\n  \"smoke\": %s,\n  \"benchmarks\": [\n", options.smoke ? "true" : "false");
+
+    bench_parse(&options, "parse/short", "ls -l /tmp");
+    bench_parse(&options, "parse/long", longLine);
+    bench_parse(&options, "parse/quoted", quotedLine);
+    bench_command(&options, "builtin/true", "true", 1000, 100);
+    bench_command(&options, "builtin/redirected", "true > /dev/null 2>&1 < /dev/null", 1000, 100);
+    bench_spawn(&options);
+    bench_command(&options, "spawn/redirected", "/bin/true > /dev/null 2>&1 < /dev/null", 1000, 1);
+    bench_command(&options, "pipeline/builtin", "echo hello | /bin/cat > /dev/null", 1000, 1); // The builtin stage runs on a thread, only 'cat' is forked
+    bench_pipeline(&options, 2, false);
+    bench_pipeline(&options, 4, false);
+    bench_pipeline(&options, 8, false);
+    bench_pipeline(&options, 4, true);
+    bench_pipeline(&options, 8, true);
+    bench_complete(&options);
+    bench_memo(&options);
+    bench_glob(&options);
+
+    fprintf(options.out, "\n  ],\n  \"failures\": %d\n}\n", options.failures);
+    if(options.out!=stdout){
+        fclose(options.out);
+    }
+    tinyshell_destroy(options.shell);
+    return options.failures==0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,8364 @@
+#define _GNU_SOURCE
+#include "tinyshell.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <stdalign.h>
+#include <stddef.h>
+#include <signal.h>
+#include <termios.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/sendfile.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/file.h>
+#include <sys/uio.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <dirent.h>
+#include <fnmatch.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/timerfd.h>
+#include <poll.h>
+
+struct arena_block{ // Defining the structure for a block of memory handed out by an arena
+    struct arena_block *next; // The next block of the arena
+    size_t size; // The number of bytes in 'data'
+    size_t used; // The number of bytes of 'data' already handed out
+    alignas(max_align_t) char data[]; // The memory of the block
+};
+
+struct arena{ // Defining the structure of an arena, which frees everything allocated from it at once
+    struct arena_block *head; // The first block, kept across resets
+    struct arena_block *current; // The block allocations are currently taken from
+};
+
+enum redirection_type{ // Defining the kinds of redirection
+    REDIRECT_IN, // '<', reading from a file
+    REDIRECT_OUT, // '>', writing a file afresh
+    REDIRECT_APPEND, // '>>', appending to a file
+    REDIRECT_DUP, // '>&' or '<&', making a descriptor a copy of another one
+    REDIRECT_HEREDOC // '<<' or '<<<', reading the text in 'target', which becomes a REDIRECT_DUP of a memfd when it is executed
+};
+
+struct redirection{ // Defining the structure for a redirection of a pipeline stage
+    enum redirection_type type; // The kind of redirection
+    int fd; // The file descriptor of the stage being redirected
+    char *target; // The file name, unused by REDIRECT_DUP
+    int source_fd; // The descriptor copied by REDIRECT_DUP
+    struct redirection *next; // The next redirection of the stage, applied in order
+    unsigned char target_flags; // WORD_VARIABLE when the file name refers to variables
+};
+
+#define SCHED_MAX_LIMITS 8 // The number of resource limits a single stage can set
+
+struct stage_limit{ // Defining the structure for a resource limit of a stage, set with 'sched -l'
+    int resource; // The RLIMIT_ constant
+    struct rlimit limit;
+};
+
+struct stage_sched{ // Defining how a stage is scheduled, set with 'sched' before its command
+    cpu_set_t cpus; // The CPUs the stage may run on, when 'pinned'
+    bool pinned;
+    bool niced; // Whether 'nice' is set
+    int nice;
+    int policy; // The SCHED_ policy, or -1 to keep that of the shell
+    int priority; // The static priority of SCHED_FIFO and SCHED_RR
+    struct stage_limit limits[SCHED_MAX_LIMITS];
+    int limit_count;
+};
+
+struct shell_command{ // Defining the structure for a single command (one pipeline stage)
+    char **argv; // The NULL terminated argument vector
+    int argc; // The number of arguments in 'argv'
+    struct redirection *redirections; // The redirections of the command, in the order they were written
+    unsigned char *word_flags; // The WORD_ flags of every argument, or NULL when no argument has to be expanded
+    struct stage_sched *sched; // The CPUs, priority and limits of the stage, or NULL to inherit those of the shell
+};
+
+#define WORD_GLOB 1 // The argument is a pattern to expand, with quoted metacharacters escaped by '\\'
+#define WORD_VARIABLE 2 // The argument refers to variables or commands, written as '${NAME}' and '$(<length>:command)' with a literal '$' escaped by '\\'
+#define WORD_QUOTED 4 // The argument had quotes, so it is kept even when its variables expand to nothing
+
+struct memo_options{ // Defining what 'memo' adds to the key of a pipeline, besides its words, its programs and its input files
+    char **inputs; // The files read without a redirection, given with '-i'
+    int input_count;
+    char **variables; // The environment variables the output depends on, given with '-e'
+    int variable_count;
+};
+
+struct watch_options{ // Defining what 'watch' waits for before running its pipeline again, besides its '<' input files
+    char **paths; // The files and directories given with '--paths'
+    int path_count;
+    int delay; // How long the files must stay unchanged before the pipeline runs again, in milliseconds
+};
+
+enum list_operator{ // Defining the operators joining the pipelines of a command list
+    LIST_SEQUENCE, // ';', '&' or the end of the line: the next pipeline always runs
+    LIST_AND, // '&&': the next pipeline only runs if this one succeeded
+    LIST_OR // '||': the next pipeline only runs if this one failed
+};
+
+struct shell_pipeline{ // Defining the structure for a pipeline of commands
+    struct shell_command *stages; // The stages, from left to right
+    int stage_count; // The number of stages
+    bool background; // Whether the pipeline ended with '&'
+    const char *text; // The pipeline as written, shown by 'jobs'
+    int pipe_size; // The buffer size of the pipes between the stages, or 0 for 'pipe_buffer_size' of the context
+    bool timed; // Whether the pipeline was prefixed with 'time'
+    bool time_json; // Whether 'time -j' asked for JSON output
+    bool batch; // Whether the pipeline was prefixed with 'batch', splitting it when its arguments exceed ARG_MAX
+    bool spread; // Whether 'sched -s' spreads the stages over neighbouring cores of one socket
+    struct memo_options *memo; // What the output depends on when the pipeline was prefixed with 'memo', or NULL
+    struct watch_options *watch; // What makes the pipeline run again when it was prefixed with 'watch', or NULL
+    enum list_operator then; // How the next pipeline of the command list depends on the status of this one
+    struct shell_pipeline *next; // The next pipeline of the command list, or NULL
+};
+
+struct builtin_io{ // Defining the streams a builtin command reads from and writes to
+    FILE *in;
+    FILE *out;
+    FILE *err;
+};
+
+typedef int(*builtin_t)(char**, struct builtin_io*); // Defining the type of builtin commands.
+
+enum builtin_threading{ // Defining where a builtin runs when it is a stage of a pipeline
+    BUILTIN_FORKED, // In a child, as it uses the state of the shell
+    BUILTIN_THREADED, // On a thread of the shell, as it only uses its streams
+    BUILTIN_THREADED_INPUT // On a thread, unless it would read the terminal of an interactive shell
+};
+
+struct builtin_command{ // Defining the structure for builtin commands.
+    char *name;
+    builtin_t method;
+    enum builtin_threading threading;
+};
+
+const struct builtin_command *find_builtin(const char *name); // Builtins can also run as stages of a pipeline
+void jobs_forget(void);
+const char *variable_get(const char *name, size_t length); // $PATH is read from the variables of the running context
+
+struct stage_usage{ // Defining the structure for the resources used by a pipeline stage
+    struct rusage usage; // The CPU time, memory and context switches reported by 'wait4'
+    double elapsed; // The wall time from the launch of the pipeline until the stage was reaped, in seconds
+};
+
+struct parser{ // Defining the state of the lexer and parser
+    const char *input; // The line being parsed
+    size_t pos; // The offset of the next character of 'input'
+    size_t token_start; // The offset of the last token
+    char *text; // The text of the last word token, allocated from 'arena'
+    int io_number; // The descriptor written before the last redirection token (as in '2>'), or -1
+    struct arena arena; // The memory of the parsed command line, released when the next line is parsed
+    char *word; // Scratch space for the word being lexed, kept across lines
+    size_t word_capacity;
+    char *pattern; // Scratch space for the word being lexed as a pattern, with quoted metacharacters escaped
+    size_t pattern_capacity;
+    unsigned char word_flags; // The WORD_ flags of the last word token
+    unsigned char *flags; // Scratch space for the flags of the words of the stage being parsed, kept across lines
+    size_t flags_capacity;
+    char **words; // Scratch space for the words of the stage being parsed, kept across lines
+    size_t words_capacity;
+    struct shell_command *stages; // Scratch space for the stages of the pipeline being parsed, kept across lines
+    size_t stages_capacity;
+    bool word_quoted; // Whether the last word token had quotes or escapes
+    bool quiet; // Whether syntax errors are left unreported
+    char *(*next_line)(void *data); // Reads the lines after the one being parsed, for here-documents, or NULL
+    void *next_line_data;
+};
+
+struct shell_pipeline *prepare_pipeline(struct parser *parser, const char *line); // Command substitution runs whole command lines
+int execute_parsed(struct shell_pipeline *parsed);
+int execute_list(struct shell_pipeline *list);
+int execute_memo(struct shell_pipeline *pipeline); // The memo store lives in the cache directory, next to compiled scripts
+int execute_watch(struct shell_pipeline *parsed);
+int builtin_memo(char **args, struct builtin_io *io);
+
+struct tinyshell{ // Defining the state of a shell context, everything else belongs to the process
+    struct parser parser; // The parser, whose arena holds the last command line
+    int *pipeline_status; // Storing the exit status of every stage of the last waited pipeline (pipefail-style)
+    struct stage_usage *pipeline_usage; // Storing the resources used by every stage of the last waited pipeline
+    int pipeline_status_count; // Storing the number of entries in 'pipeline_status' and 'pipeline_usage'
+    int last_status; // Storing the exit status of the last command line
+    int pipe_buffer_size; // The buffer size of new pipes, set with 'pipesize', or 0 for the kernel default
+    bool exit_requested; // Set by 'exit', which stops the lines being run instead of terminating the process
+    tinyshell_output_callback output; // Receives the output of foreground commands, or NULL to leave it on the descriptors of the process
+    void *output_data;
+    tinyshell_status_callback status; // Receives the status of every command line, or NULL
+    void *status_data;
+    bool detach; // Whether captured foreground pipelines are left running instead of waited for, as the server does
+    struct job *detached; // The pipeline left running, whose output is read from 'detached_fds' (stdout, stderr)
+    int detached_fds[2];
+    struct arena expansion; // The expanded copy of the pipeline being executed, released when the next one is expanded
+    int *expansion_fds; // The memfds holding the here-documents of the pipeline being executed, closed once it was started
+    size_t expansion_fd_count;
+    size_t expansion_fd_capacity;
+    int batch_prefix; // The number of arguments of the first stage before its first pattern, or -1 without one
+    int batch_suffix; // The number of arguments of the first stage after its last pattern
+    struct environment *environment; // The variables of a context with a state of its own, as clients of the server have, swapped in while it runs, or NULL to share those of the process
+    int cwd_fd; // The working directory of such a context, entered with 'fchdir' while it runs
+    char *cwd; // Its path, as 'shell_cwd' tracks it
+};
+
+struct tinyshell default_shell = {0}; // The context used until an API call selects another one
+struct tinyshell *current_shell = &default_shell; // The context of the command being run
+
+
+double monotonic_seconds(void){ // Creating a function to read the monotonic clock in seconds
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+bool write_all(int fd, const char *buffer, size_t length){ // Creating a function to write a whole buffer, retrying short writes
+
+    while(length>0){
+        ssize_t written = write(fd, buffer, length);
+        if(written==-1 && errno==EINTR){
+            continue;
+        }
+        if(written<=0){
+            return false;
+        }
+        buffer += written;
+        length -= written;
+    }
+    return true;
+}
+
+enum trace_type{ // Defining the phases recorded by the execution trace
+    TRACE_READ_LINE, // Reading a command line
+    TRACE_PARSE, // Lexing and parsing a command line
+    TRACE_GLOB, // Expanding the patterns of a command line, the value being the arguments of the first stage
+    TRACE_BUILTIN_LOOKUP, // Looking up a builtin command
+    TRACE_PIPE_CREATE, // Creating the pipes of a pipeline
+    TRACE_SPAWN, // Forking or spawning a stage
+    TRACE_EXEC, // A stage replacing its image, the value being the error (0 on success)
+    TRACE_WAIT, // The shell waiting for a foreground job
+    TRACE_CHILD_EXIT // The life of a stage until it was reaped, the value being its exit status
+};
+
+const char *trace_names[] = {"read_line", "parse", "glob", "builtin_lookup", "pipe_create", "spawn", "exec", "wait", "child_exit"};
+
+struct trace_event{ // Defining the structure for a recorded event
+    enum trace_type type;
+    long long start; // Nanoseconds on the monotonic clock
+    long long duration; // Nanoseconds
+    pid_t pid; // The process the event belongs to
+    int value; // A number which depends on the type of event
+    char name[32]; // The command the event belongs to, if any
+};
+
+#define TRACE_BUFFER_EVENTS 4096 // The number of events kept in memory between writes to the trace file
+
+struct trace_buffer{ // Defining the structure for the in-memory buffer of events, written out when full and at exit
+    int fd; // The trace file
+    bool chrome; // Whether the file uses the Chrome trace format instead of JSON Lines
+    bool first; // Whether no event was written to the file yet
+    int count; // The number of buffered events
+    struct trace_event events[TRACE_BUFFER_EVENTS];
+};
+
+bool tracing = false; // Whether TINYSHELL_TRACE enabled tracing, tested before doing any work for it
+struct trace_buffer *trace_buffer = NULL;
+
+// Recording costs one predictable branch while tracing is off
+#define TRACE_START() (tracing ? trace_clock() : 0)
+#define TRACE(type, start, pid, name, value) do{ if(tracing){ trace_record(type, start, pid, name, value); } }while(0)
+
+long long trace_clock(void){ // Creating a function to read the monotonic clock in nanoseconds
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+void trace_flush(void){ // Creating a function to write the buffered events to the trace file
+
+    char line[512];
+    pid_t shell = getpid();
+    for(int i=0; i<trace_buffer->count; i++){
+        struct trace_event *event = &trace_buffer->events[i];
+        char name[sizeof(event->name)*2]; // The name, escaped for JSON
+        size_t n = 0;
+        for(const char *c=event->name; *c!='\0'; c++){
+            if(*c=='"' || *c=='\\'){
+                name[n++] = '\\';
+            }
+            name[n++] = (unsigned char)*c<0x20 ? '?' : *c;
+        }
+        name[n] = '\0';
+
+        int length;
+        if(trace_buffer->chrome){ // A complete event ('X') per phase, children on their own tracks
+            length = snprintf(line, sizeof(line), "%s{\"name\":\"%s\",\"cat\":\"shell\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d,\"args\":{\"command\":\"%s\",\"value\":%d}}",
+                trace_buffer->first ? "[\n" : ",\n", trace_names[event->type], event->start / 1e3, event->duration / 1e3, (int)shell, (int)event->pid, name, event->value);
+        }else{
+            length = snprintf(line, sizeof(line), "{\"ts_ns\":%lld,\"dur_ns\":%lld,\"event\":\"%s\",\"pid\":%d,\"command\":\"%s\",\"value\":%d}\n",
+                event->start, event->duration, trace_names[event->type], (int)event->pid, name, event->value);
+        }
+        trace_buffer->first = false;
+        if(length>0 && !write_all(trace_buffer->fd, line, length<(int)sizeof(line) ? length : (int)sizeof(line)-1)){
+            break;
+        }
+    }
+    trace_buffer->count = 0;
+}
+
+void trace_record(enum trace_type type, long long start, pid_t pid, const char *name, int value){ // Creating a function to add an event to the buffer, lasting from 'start' until now
+
+    if(trace_buffer->count==TRACE_BUFFER_EVENTS){
+        trace_flush();
+    }
+    struct trace_event *event = &trace_buffer->events[trace_buffer->count++];
+    event->type = type;
+    event->start = start;
+    event->duration = trace_clock() - start;
+    event->pid = pid;
+    event->value = value;
+    event->name[0] = '\0';
+    if(name!=NULL){
+        strncat(event->name, name, sizeof(event->name)-1);
+    }
+}
+
+void trace_close(void){ // Creating a function to write the remaining events and close the trace file, at exit
+
+    if(!tracing){
+        return;
+    }
+    trace_flush();
+    if(trace_buffer->chrome){
+        const char *end = trace_buffer->first ? "[]\n" : "\n]\n"; // Closing the array, which Perfetto also accepts unclosed after a crash
+        write_all(trace_buffer->fd, end, strlen(end));
+    }
+    close(trace_buffer->fd);
+    tracing = false;
+}
+
+void tinyshell_trace_init(void){ // Creating a function to start tracing when TINYSHELL_TRACE names a file
+
+    const char *path = getenv("TINYSHELL_TRACE");
+    if(trace_buffer!=NULL){ // Already tracing
+        return;
+    }
+    if(path==NULL || *path=='\0'){
+        return;
+    }
+    const char *format = getenv("TINYSHELL_TRACE_FORMAT"); // 'jsonl' (the default) or 'chrome', which Perfetto loads
+    bool chrome = format!=NULL && strcmp(format,"chrome")==0;
+    if(format!=NULL && !chrome && strcmp(format,"jsonl")!=0 && strcmp(format,"json")!=0){
+        fprintf(stderr,"Error: Unknown TINYSHELL_TRACE_FORMAT '%s', using jsonl\n", format); // Output error message
+    }
+
+    trace_buffer = malloc(sizeof(struct trace_buffer));
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if(trace_buffer==NULL || fd==-1){
+        fprintf(stderr,"Error: Unable to open trace file '%s': %s\n", path, strerror(errno)); // Output error message
+        free(trace_buffer);
+        trace_buffer = NULL;
+        if(fd>=0){
+            close(fd);
+        }
+        return;
+    }
+    trace_buffer->fd = fd;
+    trace_buffer->chrome = chrome;
+    trace_buffer->first = true;
+    trace_buffer->count = 0;
+    tracing = true;
+    atexit(trace_close);
+}
+
+int decode_status(int status){ // Creating a function to convert a raw 'waitpid' status into a shell exit status
+
+    if(WIFEXITED(status)){ // If the child exited normally
+        return WEXITSTATUS(status); // Returning the exit code of the child
+    }else if(WIFSIGNALED(status)){ // If the child was terminated by a signal
+        return 128 + WTERMSIG(status); // Following the shell convention of 128 + signal number
+    }
+    return 1;
+}
+
+pid_t fork_exec(char **args){ // Defining a new function to perform fork-exec
+
+    pid_t forkPID = fork(); // Creating a copy of the process
+
+    if(forkPID==-1){ // If an error is encountered
+
+        perror("Unable to create new process!\n"); // Outputting error message
+        return -1;
+
+    }else if(forkPID==0){ // Child process
+
+        execvp(args[0],args); // Replacing the current process image with a new process image, according to the inputted arguments
+        // If 'execvp' returns then the following is executed:
+        perror("Unable to execute program!"); // Outputting error message
+        _exit(127); // Terminating the child, so that it never returns into the shell code
+    }
+
+    int status;
+    waitpid(forkPID, &status, 0); // Waiting for this child only, so that unrelated children are not reaped by mistake
+
+    return forkPID; // Returning the PID
+}
+
+void close_pipes(int fds[][2], int pipeCount){ // Creating a function to close both ends of every pipe in a pipeline
+
+    for(int i=0; i<pipeCount; i++){ // Looping through every pipe object
+        if(fds[i][0]>=0){
+            close(fds[i][0]); // Closing the read end
+        }
+        if(fds[i][1]>=0){
+            close(fds[i][1]); // Closing the write end
+        }
+    }
+}
+
+struct path_dir{ // Defining the structure for a directory of $PATH, as seen by the command hash
+    char *path; // The directory name
+    struct timespec mtime; // The modification time of the directory when it was last checked
+    bool checked; // Whether 'mtime' holds a valid value
+    unsigned long generation; // The command line in which the directory was last checked
+};
+
+struct hash_entry{ // Defining the structure for a cached command
+    char *name; // The command name, as typed by the user, or NULL for an empty slot
+    char *path; // The absolute path of the executable
+    int dir_index; // The index of the $PATH directory containing the executable
+    unsigned hits; // The number of times the entry was used
+};
+
+struct command_hash{ // Defining the structure of the command path cache
+    char *path_value; // A copy of $PATH, used to detect changes to it
+    struct path_dir *dirs; // The directories of 'path_value', in search order
+    int dir_count; // The number of entries in 'dirs'
+    struct hash_entry *entries; // An open addressing hash table of commands
+    size_t capacity; // The number of slots in 'entries' (always a power of two)
+    size_t count; // The number of used slots in 'entries'
+    unsigned long generation; // Incremented for every command line, so a directory is checked once per line
+};
+
+struct command_hash command_hash = {NULL, NULL, 0, NULL, 0, 0, 0}; // The command path cache of the shell
+
+unsigned long hash_string(const char *string){ // Creating a function to hash a string (FNV-1a)
+
+    unsigned long hash = 14695981039346656037UL;
+    while(*string!='\0'){
+        hash = (hash ^ (unsigned char)*string++) * 1099511628211UL;
+    }
+    return hash;
+}
+
+void command_hash_clear(void){ // Creating a function to forget every cached command
+
+    for(size_t i=0; i<command_hash.capacity; i++){ // Freeing every used slot
+        free(command_hash.entries[i].name);
+        free(command_hash.entries[i].path);
+        command_hash.entries[i].name = NULL;
+        command_hash.entries[i].path = NULL;
+    }
+    command_hash.count = 0;
+
+    for(int i=0; i<command_hash.dir_count; i++){ // Directory times are taken again when next needed
+        command_hash.dirs[i].checked = false;
+    }
+}
+
+void command_hash_load_path(void){ // Creating a function to split $PATH into directories, if it has changed
+
+    const char *path = variable_get("PATH", 4); // The PATH of the context, which clients of the server may set
+    if(path==NULL){ // Using the same default as 'execvp'
+        path = "/bin:/usr/bin";
+    }
+    if(command_hash.path_value!=NULL && strcmp(command_hash.path_value, path)==0){ // $PATH is unchanged
+        return;
+    }
+
+    command_hash_clear(); // Every cached path may now be wrong
+    for(int i=0; i<command_hash.dir_count; i++){
+        free(command_hash.dirs[i].path);
+    }
+    free(command_hash.dirs);
+    free(command_hash.path_value);
+    command_hash.dirs = NULL;
+    command_hash.dir_count = 0;
+    command_hash.path_value = strdup(path);
+    if(command_hash.path_value==NULL){
+        return;
+    }
+
+    int dirCount = 1; // Counting the directories, which are separated by ':'
+    for(const char *c=path; *c!='\0'; c++){
+        if(*c==':'){
+            dirCount++;
+        }
+    }
+    command_hash.dirs = calloc(dirCount, sizeof(struct path_dir));
+    if(command_hash.dirs==NULL){
+        return;
+    }
+
+    const char *start = path;
+    for(int i=0; i<dirCount; i++){ // Storing every directory, an empty entry meaning the current directory
+        size_t length = strcspn(start, ":");
+        command_hash.dirs[i].path = length>0 ? strndup(start, length) : strdup(".");
+        start += length + 1;
+    }
+    command_hash.dir_count = dirCount;
+}
+
+bool command_hash_dir_unchanged(int index){ // Creating a function to check that a directory was not modified since it was recorded
+
+    struct path_dir *dir = &command_hash.dirs[index];
+    if(dir->checked && dir->generation==command_hash.generation){ // Already checked for this command line
+        return true;
+    }
+
+    struct stat info;
+    if(stat(dir->path, &info)==-1){ // A missing directory counts as unchanged, a later one cannot be shadowed by it
+        info.st_mtim.tv_sec = 0;
+        info.st_mtim.tv_nsec = 0;
+    }
+
+    bool unchanged = dir->checked && dir->mtime.tv_sec==info.st_mtim.tv_sec && dir->mtime.tv_nsec==info.st_mtim.tv_nsec;
+    dir->mtime = info.st_mtim; // Recording the time before any lookup in the directory takes place
+    dir->checked = true;
+    dir->generation = command_hash.generation;
+    return unchanged;
+}
+
+struct hash_entry *command_hash_slot(const char *name){ // Creating a function to find the slot of a command (used or empty)
+
+    size_t mask = command_hash.capacity - 1;
+    size_t i = hash_string(name) & mask;
+    while(command_hash.entries[i].name!=NULL && strcmp(command_hash.entries[i].name, name)!=0){ // Linear probing
+        i = (i + 1) & mask;
+    }
+    return &command_hash.entries[i];
+}
+
+bool command_hash_insert(const char *name, const char *path, int dir_index){ // Creating a function to add a command to the cache
+
+    if(command_hash.count*2 >= command_hash.capacity){ // Keeping the table at most half full
+        size_t capacity = command_hash.capacity>0 ? command_hash.capacity*2 : 64;
+        struct hash_entry *old = command_hash.entries;
+        size_t oldCapacity = command_hash.capacity;
+        command_hash.entries = calloc(capacity, sizeof(struct hash_entry));
+        if(command_hash.entries==NULL){
+            command_hash.entries = old;
+            return false;
+        }
+        command_hash.capacity = capacity;
+        for(size_t i=0; i<oldCapacity; i++){ // Moving the existing entries into the new table
+            if(old[i].name!=NULL){
+                *command_hash_slot(old[i].name) = old[i];
+            }
+        }
+        free(old);
+    }
+
+    struct hash_entry *entry = command_hash_slot(name);
+    if(entry->name==NULL){
+        entry->name = strdup(name);
+        command_hash.count++;
+    }
+    free(entry->path);
+    entry->path = strdup(path);
+    entry->dir_index = dir_index;
+    entry->hits = 0;
+    return entry->name!=NULL && entry->path!=NULL;
+}
+
+const char *command_hash_lookup(const char *name){ // Creating a function to resolve a command name to an absolute path
+
+    if(name==NULL || strchr(name,'/')!=NULL){ // Paths are executed as they are
+        return NULL;
+    }
+
+    command_hash_load_path(); // Picking up changes to $PATH
+
+    if(command_hash.capacity>0){ // Checking the cache first
+        struct hash_entry *entry = command_hash_slot(name);
+        if(entry->name!=NULL){
+            bool valid = true;
+            for(int i=0; i<=entry->dir_index && valid; i++){ // A new file in an earlier directory could shadow the entry
+                valid = command_hash_dir_unchanged(i);
+            }
+            if(valid){
+                entry->hits++;
+                return entry->path;
+            }
+            command_hash_clear(); // A directory changed, so every entry found after it is suspect
+        }
+    }
+
+    for(int i=0; i<command_hash.dir_count; i++){ // Searching $PATH in order, as 'execvp' does
+        command_hash_dir_unchanged(i); // Recording the directory time before looking inside it
+
+        char candidate[PATH_MAX];
+        struct stat info;
+        if(snprintf(candidate, sizeof(candidate), "%s/%s", command_hash.dirs[i].path, name)>=(int)sizeof(candidate)){
+            continue;
+        }
+        if(stat(candidate, &info)==0 && S_ISREG(info.st_mode) && access(candidate, X_OK)==0){ // An executable file was found
+            if(command_hash.dirs[i].path[0]!='/'){ // Relative directories depend on the working directory, so they are not cached
+                return NULL;
+            }
+            if(!command_hash_insert(name, candidate, i)){
+                return NULL;
+            }
+            struct hash_entry *entry = command_hash_slot(name);
+            entry->hits++;
+            return entry->path;
+        }
+    }
+    return NULL; // Not found, the exec call reports the error
+}
+
+struct stage_spawn{ // Defining the structure describing how a single pipeline stage is started
+    char **args; // The argument vector of the stage
+    const char *path; // The resolved executable from the command hash, or NULL to search $PATH
+    builtin_t builtin; // The builtin run by the stage in a forked child, or NULL for a program
+    int in_fd; // The descriptor which becomes the stage's stdin (a pipe read end), or -1 to inherit it
+    int out_fd; // The descriptor which becomes the stage's stdout (a pipe write end), or -1 to inherit it
+    int err_fd; // The descriptor which becomes the stage's stderr, or -1 to inherit it
+    struct redirection *redirections; // The redirections of the stage, applied after the pipes
+    int (*fds)[2]; // Every pipe of the pipeline, which the stage has to close
+    int pipeCount; // The number of pipes in 'fds'
+    pid_t pgid; // The process group to join (0 for a new group led by the stage), or -1 without job control
+    bool foreground; // Whether the process group is given the terminal
+    char **envp; // The environment of the program
+    const struct stage_sched *sched; // The CPUs, priority and limits set with 'sched', or NULL
+    int cpu; // The CPU chosen by 'sched -s', or -1
+};
+
+bool job_control = false; // Whether jobs get their own process groups and the terminal (interactive shells only)
+int shell_terminal = STDIN_FILENO; // The terminal controlled by the shell
+pid_t shell_pgid = 0; // The process group of the shell
+sigset_t child_sigmask; // The signal mask the shell started with, restored in every child
+int sigchld_fd = -1; // A signalfd reporting SIGCHLD, so children are reaped from the event loop
+int event_fd = -1; // The epoll instance the shell blocks on
+int thread_fd = -1; // An eventfd signalled by every builtin stage whose thread finished, also watched by 'event_fd'
+
+void child_reset_signals(void){ // Creating a function to give a forked child the default signal handling
+
+    int signals[] = {SIGINT, SIGQUIT, SIGTSTP, SIGTTIN, SIGTTOU, SIGCHLD};
+    for(size_t i=0; i<sizeof(signals)/sizeof(signals[0]); i++){
+        signal(signals[i], SIG_DFL);
+    }
+    sigprocmask(SIG_SETMASK, &child_sigmask, NULL); // Unblocking SIGCHLD, which the shell reads through 'sigchld_fd'
+}
+
+enum spawn_backend{ // Defining the available ways of launching a process
+    SPAWN_FORK, // fork() followed by the redirections and execvpe() in the child
+    SPAWN_POSIX_SPAWN // posix_spawnp(), which glibc implements with clone(CLONE_VM|CLONE_VFORK)
+};
+
+enum spawn_backend spawn_backend = SPAWN_FORK; // The backend used by 'spawn_stage', selectable at runtime
+
+struct variable{ // Defining the structure for a variable of the environment
+    char *entry; // "NAME=VALUE", as passed to programs
+    size_t name_length; // The length of NAME
+    struct variable *next; // The next variable in the same bucket
+};
+
+struct environment{ // Defining the structure of the environment of the shell, a hash map of its variables
+    struct variable **buckets;
+    size_t bucket_count;
+    size_t count;
+    char **envp; // The entries of every variable, as passed to programs, rebuilt only after a variable changed
+    size_t envp_size; // The space 'envp' takes in a new process, counted against ARG_MAX
+    bool changed; // Whether 'envp' has to be rebuilt
+};
+
+struct environment environment = {NULL, 0, 0, NULL, 0, true}; // Loaded from the environment of the process when first used
+
+int compare_strings(const void *a, const void *b){ // Creating a function to order strings, for 'qsort'
+    return strcmp(*(char *const*)a, *(char *const*)b);
+}
+
+bool valid_identifier(const char *name, size_t length){ // Creating a function to check a variable name: letters, digits and '_', not starting with a digit
+    if(length==0 || isdigit((unsigned char)name[0])){
+        return false;
+    }
+    for(size_t i=0; i<length; i++){
+        if(!isalnum((unsigned char)name[i]) && name[i]!='_'){
+            return false;
+        }
+    }
+    return true;
+}
+
+unsigned long hash_name(const char *name, size_t length){ // Creating a function to hash a variable name which is not terminated (FNV-1a)
+
+    unsigned long hash = 14695981039346656037UL;
+    for(size_t i=0; i<length; i++){
+        hash ^= (unsigned char)name[i];
+        hash *= 1099511628211UL;
+    }
+    return hash;
+}
+
+void environment_insert(struct variable *variable){ // Creating a function to link a variable into its bucket, growing the table when it gets full
+
+    if(environment.count>=environment.bucket_count){ // Keeping the chains short
+        size_t bucketCount = environment.bucket_count * 2;
+        struct variable **buckets = calloc(bucketCount, sizeof(struct variable*));
+        if(buckets==NULL){
+            perror("Unable to allocate memory!"); // Outputting error message
+            exit(EXIT_FAILURE);
+        }
+        for(size_t i=0; i<environment.bucket_count; i++){ // Moving every variable to the larger table
+            struct variable *moved = environment.buckets[i];
+            while(moved!=NULL){
+                struct variable *next = moved->next;
+                struct variable **bucket = &buckets[hash_name(moved->entry, moved->name_length) % bucketCount];
+                moved->next = *bucket;
+                *bucket = moved;
+                moved = next;
+            }
+        }
+        free(environment.buckets);
+        environment.buckets = buckets;
+        environment.bucket_count = bucketCount;
+    }
+    struct variable **bucket = &environment.buckets[hash_name(variable->entry, variable->name_length) % environment.bucket_count];
+    variable->next = *bucket;
+    *bucket = variable;
+    environment.count++;
+    environment.changed = true;
+}
+
+struct variable **environment_find(const char *name, size_t length){ // Creating a function to find the link to a variable, pointing to NULL when it is not set
+
+    static struct variable *missing = NULL;
+    if(environment.bucket_count==0){
+        return &missing;
+    }
+    struct variable **link = &environment.buckets[hash_name(name, length) % environment.bucket_count];
+    while(*link!=NULL && ((*link)->name_length!=length || memcmp((*link)->entry, name, length)!=0)){
+        link = &(*link)->next;
+    }
+    return link;
+}
+
+void environment_load(void){ // Creating a function to copy the environment of the process into the shell, once
+
+    extern char **environ;
+
+    if(environment.buckets!=NULL){
+        return;
+    }
+    environment.bucket_count = 256;
+    environment.buckets = calloc(environment.bucket_count, sizeof(struct variable*));
+    if(environment.buckets==NULL){
+        perror("Unable to allocate memory!"); // Outputting error message
+        exit(EXIT_FAILURE);
+    }
+    for(char **entry=environ; *entry!=NULL; entry++){
+        char *equals = strchr(*entry, '=');
+        struct variable *variable = malloc(sizeof(struct variable));
+        if(equals==NULL || variable==NULL || (variable->entry = strdup(*entry))==NULL){
+            free(variable);
+            continue;
+        }
+        variable->name_length = equals - *entry;
+        if(*environment_find(*entry, variable->name_length)!=NULL){ // Keeping the first of duplicated names, as getenv does
+            free(variable->entry);
+            free(variable);
+            continue;
+        }
+        environment_insert(variable);
+    }
+}
+
+const char *variable_get(const char *name, size_t length){ // Creating a function to read a variable, or NULL when it is not set
+
+    environment_load();
+    struct variable *variable = *environment_find(name, length);
+    return variable!=NULL ? variable->entry + length + 1 : NULL;
+}
+
+void variable_set(const char *name, const char *value){ // Creating a function to set a variable, for the shell, its programs and the process itself
+
+    environment_load();
+    size_t length = strlen(name);
+    size_t valueLength = strlen(value);
+    char *entry = malloc(length + valueLength + 2);
+    if(entry==NULL){
+        perror("Unable to allocate memory!"); // Outputting error message
+        return;
+    }
+    memcpy(entry, name, length);
+    entry[length] = '=';
+    memcpy(entry + length + 1, value, valueLength + 1);
+
+    struct variable *variable = *environment_find(name, length);
+    if(variable!=NULL){ // Replacing the value
+        free(variable->entry);
+        variable->entry = entry;
+        environment.changed = true;
+    }else if((variable = malloc(sizeof(struct variable)))!=NULL){
+        variable->entry = entry;
+        variable->name_length = length;
+        environment_insert(variable);
+    }else{
+        free(entry);
+        return;
+    }
+    if(current_shell->environment==NULL || strcmp(name,"PATH")==0){ // getenv("HOME") stays in step, a context with variables of its own only sets the PATH which 'execvpe' searches
+        setenv(name, value, 1);
+    }
+}
+
+void variable_unset(const char *name){ // Creating a function to remove a variable
+
+    environment_load();
+    struct variable **link = environment_find(name, strlen(name));
+    struct variable *variable = *link;
+    if(variable!=NULL){
+        *link = variable->next;
+        free(variable->entry);
+        free(variable);
+        environment.count--;
+        environment.changed = true;
+    }
+    if(current_shell->environment==NULL || strcmp(name,"PATH")==0){
+        unsetenv(name);
+    }
+}
+
+char **environment_envp(void){ // Creating a function to obtain the environment passed to programs, rebuilding it only after a variable changed
+
+    environment_load();
+    if(!environment.changed){ // Every spawn between two changes shares the same array
+        return environment.envp;
+    }
+    char **envp = realloc(environment.envp, (environment.count + 1) * sizeof(char*));
+    if(envp==NULL){
+        perror("Unable to allocate memory!"); // Outputting error message
+        exit(EXIT_FAILURE);
+    }
+    size_t count = 0;
+    size_t size = sizeof(char*);
+    for(size_t i=0; i<environment.bucket_count; i++){
+        for(struct variable *variable=environment.buckets[i]; variable!=NULL; variable=variable->next){
+            envp[count++] = variable->entry;
+            size += strlen(variable->entry) + 1 + sizeof(char*);
+        }
+    }
+    envp[count] = NULL;
+    environment.envp = envp;
+    environment.envp_size = size;
+    environment.changed = false;
+    return envp;
+}
+
+void environment_copy(struct environment *copy){ // Creating a function to copy the variables of the shell, for a context with variables of its own
+
+    environment_load();
+    *copy = (struct environment){calloc(environment.bucket_count, sizeof(struct variable*)), environment.bucket_count, 0, NULL, 0, true};
+    if(copy->buckets==NULL){
+        perror("Unable to allocate memory!"); // Outputting error message
+        exit(EXIT_FAILURE);
+    }
+    for(size_t i=0; i<environment.bucket_count; i++){ // The tables have the same size, so every variable goes to the same bucket
+        for(struct variable *variable=environment.buckets[i]; variable!=NULL; variable=variable->next){
+            struct variable *copied = malloc(sizeof(struct variable));
+            if(copied==NULL || (copied->entry = strdup(variable->entry))==NULL){
+                perror("Unable to allocate memory!"); // Outputting error message
+                exit(EXIT_FAILURE);
+            }
+            copied->name_length = variable->name_length;
+            copied->next = copy->buckets[i];
+            copy->buckets[i] = copied;
+            copy->count++;
+        }
+    }
+}
+
+void environment_free(struct environment *freed){ // Creating a function to release the variables of a context
+
+    for(size_t i=0; i<freed->bucket_count; i++){
+        struct variable *variable = freed->buckets[i];
+        while(variable!=NULL){
+            struct variable *next = variable->next;
+            free(variable->entry);
+            free(variable);
+            variable = next;
+        }
+    }
+    free(freed->buckets);
+    free(freed->envp);
+}
+
+int select_spawn_backend(const char *name){ // Creating a function to select the spawn backend by name
+
+    if(name==NULL || strcmp(name,"fork")==0){ // The default backend
+        spawn_backend = SPAWN_FORK;
+    }else if(strcmp(name,"posix_spawn")==0 || strcmp(name,"spawn")==0 || strcmp(name,"vfork")==0){
+        spawn_backend = SPAWN_POSIX_SPAWN;
+    }else{
+        fprintf(stderr,"Error: Unknown spawn backend '%s'\n", name); // Output error message
+        return -10;
+    }
+    return 0;
+}
+
+int redirection_flags(enum redirection_type type){ // Creating a function to obtain the 'open' flags of a redirection
+
+    if(type==REDIRECT_IN){
+        return O_RDONLY;
+    }else if(type==REDIRECT_APPEND){
+        return O_WRONLY | O_CREAT | O_APPEND; // Output is appended to the file
+    }
+    return O_WRONLY | O_CREAT | O_TRUNC; // Output to the file is written afresh
+}
+
+enum copy_method{ // Defining the ways of copying data inside the kernel, tried in order
+    COPY_FILE_RANGE, // Between two files, even across filesystems on recent kernels
+    COPY_SPLICE, // When either descriptor is a pipe
+    COPY_SENDFILE, // From a file to any descriptor
+    COPY_READ_WRITE // Through a buffer, which always works
+};
+
+bool copy_data(int from, int to){ // Creating a function to copy everything left in one descriptor to another, inside the kernel when possible
+
+    enum copy_method method = COPY_FILE_RANGE;
+
+    while(method!=COPY_READ_WRITE){
+        ssize_t copied;
+        if(method==COPY_FILE_RANGE){
+            copied = copy_file_range(from, NULL, to, NULL, SSIZE_MAX, 0);
+        }else if(method==COPY_SPLICE){
+            copied = splice(from, NULL, to, NULL, SSIZE_MAX, SPLICE_F_MOVE);
+        }else{
+            copied = sendfile(to, from, NULL, SSIZE_MAX);
+        }
+        if(copied==0){ // End of the input
+            return true;
+        }
+        if(copied>0){
+            continue;
+        }
+        if(errno==EINTR){
+            continue;
+        }
+        if(errno==EXDEV || errno==EINVAL || errno==ENOSYS || errno==EOPNOTSUPP || errno==EBADF || errno==ESPIPE){ // Not supported for these descriptors, trying the next method
+            method++;
+            continue;
+        }
+        return false;
+    }
+
+    char buffer[65536];
+    while(true){ // Copying the rest through a buffer
+        ssize_t length = read(from, buffer, sizeof(buffer));
+        if(length==-1 && errno==EINTR){
+            continue;
+        }
+        if(length<=0){
+            return length==0;
+        }
+        if(!write_all(to, buffer, length)){
+            return false;
+        }
+    }
+}
+
+bool copy_fd(int from, int to){ // Creating a function to copy a whole file, from its start, to another descriptor
+
+    if(lseek(from, 0, SEEK_SET)==-1){
+        return false;
+    }
+    return copy_data(from, to);
+}
+
+const char *redirection_error(const struct redirection *r){ // Creating a function to obtain the error message of a failed redirection
+
+    if(r->type==REDIRECT_DUP){
+        return "Unable to duplicate file descriptor!";
+    }
+    return r->type==REDIRECT_IN ? "Unable to redirect input to file!" : "Unable to redirect output to file!";
+}
+
+bool apply_redirection(const struct redirection *r){ // Creating a function to apply a redirection to the descriptors of the current process
+
+    if(r->type==REDIRECT_DUP){
+        if(r->source_fd==r->fd){ // 'n>&n' leaves the descriptor as it is, but still checks it
+            if(fcntl(r->fd, F_SETFD, 0)==-1){
+                perror(redirection_error(r)); // Outputting error message
+                return false;
+            }
+            return true;
+        }
+        if(dup2(r->source_fd, r->fd)==-1){
+            perror(redirection_error(r)); // Outputting error message
+            return false;
+        }
+        return true;
+    }
+
+    int fd = open(r->target, redirection_flags(r->type) | O_CLOEXEC, 0666); // Close-on-exec until it is moved into place, so no stray copy leaks into the program
+    if(fd==-1){
+        perror(redirection_error(r)); // Outputting error message
+        return false;
+    }
+    if(fd==r->fd){ // The file landed on the right descriptor, which has to survive the exec
+        fcntl(fd, F_SETFD, 0);
+        return true;
+    }
+    if(dup2(fd, r->fd)==-1){ // 'dup2' clears close-on-exec on the new descriptor
+        perror(redirection_error(r)); // Outputting error message
+        close(fd);
+        return false;
+    }
+    close(fd);
+    return true;
+}
+
+struct cpu_place{ // Defining where a CPU sits, to order the CPUs handed out by 'sched -s'
+    int cpu;
+    int core; // The core in its socket, or -1 if unknown
+    int thread; // 0 for the first CPU of its core, 1 for its first hyperthread sibling, and so on
+};
+
+struct cpu_order{ // Defining the order in which 'sched -s' hands out CPUs, found once per process
+    int *cpus;
+    int count;
+    bool loaded;
+};
+
+struct cpu_order cpu_order = {NULL, 0, false};
+
+int read_topology(int cpu, const char *name){ // Creating a function to read a number describing a CPU from sysfs, or -1
+
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, name);
+    FILE *file = fopen(path, "re");
+    int value = -1;
+    if(file!=NULL){
+        if(fscanf(file, "%d", &value)!=1){
+            value = -1;
+        }
+        fclose(file);
+    }
+    return value;
+}
+
+int compare_cpu_places(const void *a, const void *b){ // Creating a function to order CPUs by core, every core getting a stage before any core gets a second one, for 'qsort'
+    const struct cpu_place *x = a;
+    const struct cpu_place *y = b;
+    if(x->thread!=y->thread){
+        return x->thread - y->thread;
+    }
+    if(x->core!=y->core){
+        return x->core - y->core;
+    }
+    return x->cpu - y->cpu;
+}
+
+void load_cpu_order(void){ // Creating a function to list the CPUs of the socket the shell runs on, neighbouring cores next to each other
+
+    cpu_order.loaded = true;
+    cpu_set_t allowed;
+    if(sched_getaffinity(0, sizeof(allowed), &allowed)==-1){
+        return;
+    }
+    int current = sched_getcpu();
+    int package = current>=0 ? read_topology(current, "physical_package_id") : -1;
+    struct cpu_place *places = malloc(CPU_COUNT(&allowed) * sizeof(struct cpu_place));
+    cpu_order.cpus = malloc(CPU_COUNT(&allowed) * sizeof(int));
+    if(places==NULL || cpu_order.cpus==NULL){
+        free(places);
+        free(cpu_order.cpus);
+        cpu_order.cpus = NULL;
+        return;
+    }
+    int count = 0;
+    for(int cpu=0; cpu<CPU_SETSIZE; cpu++){
+        if(!CPU_ISSET(cpu, &allowed) || (package>=0 && read_topology(cpu, "physical_package_id")!=package)){ // Staying on one socket, so the pipes between the stages stay in its caches
+            continue;
+        }
+        struct cpu_place place = {cpu, read_topology(cpu, "core_id"), 0};
+        for(int i=0; i<count && place.core>=0; i++){
+            place.thread += places[i].core==place.core;
+        }
+        places[count++] = place;
+    }
+    qsort(places, count, sizeof(struct cpu_place), compare_cpu_places);
+    for(int i=0; i<count; i++){
+        cpu_order.cpus[i] = places[i].cpu;
+    }
+    cpu_order.count = count;
+    free(places);
+}
+
+int spread_cpu(int stage){ // Creating a function to choose the CPU of a stage of a spread pipeline, or -1 to leave it to the kernel
+
+    if(!cpu_order.loaded){
+        load_cpu_order();
+    }
+    return cpu_order.count>0 ? cpu_order.cpus[stage % cpu_order.count] : -1; // Stages beyond the socket's CPUs start over from its first core
+}
+
+bool apply_sched(const struct stage_sched *sched, int cpu){ // Creating a function to set the CPUs, priority and limits of the current process, in a stage before exec
+
+    cpu_set_t single;
+    const cpu_set_t *cpus = sched!=NULL && sched->pinned ? &sched->cpus : NULL; // CPUs given with '-c' win over those of '-s'
+    if(cpus==NULL && cpu>=0){
+        CPU_ZERO(&single);
+        CPU_SET(cpu, &single);
+        cpus = &single;
+    }
+    if(cpus!=NULL && sched_setaffinity(0, sizeof(cpu_set_t), cpus)==-1){
+        perror("Unable to set CPU affinity!"); // Outputting error message
+        return false;
+    }
+    if(sched==NULL){
+        return true;
+    }
+    if(sched->niced && setpriority(PRIO_PROCESS, 0, sched->nice)==-1){
+        perror("Unable to set priority!"); // Outputting error message
+        return false;
+    }
+    if(sched->policy>=0){
+        struct sched_param parameters = {.sched_priority = sched->priority};
+        if(sched_setscheduler(0, sched->policy, &parameters)==-1){
+            perror("Unable to set scheduling policy!"); // Outputting error message
+            return false;
+        }
+    }
+    for(int i=0; i<sched->limit_count; i++){
+        if(prlimit(0, sched->limits[i].resource, &sched->limits[i].limit, NULL)==-1){
+            perror("Unable to set resource limit!"); // Outputting error message
+            return false;
+        }
+    }
+    return true;
+}
+
+pid_t fork_exec_pipe(struct stage_spawn *stage){
+
+    int execPipe[2] = {-1, -1}; // While tracing, the child reports a failed exec through a close-on-exec pipe, end-of-file meaning success
+    long long started = TRACE_START();
+    if(tracing && pipe2(execPipe, O_CLOEXEC)==-1){
+        execPipe[0] = execPipe[1] = -1;
+    }
+
+    pid_t forkPID = fork(); // Creating a copy of the process
+
+    if(forkPID==-1){ // If an error is encountered
+
+        perror("Unable to create new process!"); // Outputting error message
+        if(execPipe[0]>=0){
+            close(execPipe[0]);
+            close(execPipe[1]);
+        }
+        return -1;
+
+    }else if(forkPID>0){ // Parent process
+        if(stage->pgid>=0){
+            setpgid(forkPID, stage->pgid>0 ? stage->pgid : forkPID);
+        }
+        if(execPipe[0]>=0){ // Waiting for the exec, which serialises the stages but only while tracing
+            close(execPipe[1]);
+            int error = 0;
+            while(read(execPipe[0], &error, sizeof(error))==-1 && errno==EINTR){
+            }
+            close(execPipe[0]);
+            TRACE(TRACE_EXEC, started, forkPID, stage->args[0], error);
+        }
+
+    }else if(forkPID==0){ // Child process
+
+        if(execPipe[0]>=0){
+            close(execPipe[0]);
+        }
+
+        if(stage->pgid>=0){ // Joining the process group of the job, as the parent does too (whichever runs first wins the race)
+            setpgid(0, stage->pgid);
+            if(stage->foreground){
+                tcsetpgrp(shell_terminal, getpgrp()); // SIGTTOU is still ignored at this point
+            }
+        }
+        child_reset_signals();
+        if(!apply_sched(stage->sched, stage->cpu)){
+            _exit(126);
+        }
+
+        // Input pipe
+        if(stage->in_fd>=0){ // Valid pipe descriptor
+            dup2(stage->in_fd, STDIN_FILENO); // Making STDIN FD point to input pipe read end
+        }
+
+        // Output pipe
+        if(stage->out_fd>=0){ // Valid pipe descriptor
+            dup2(stage->out_fd, STDOUT_FILENO); // Making STDOUT FD point to output pipe write end
+        }
+
+        if(stage->err_fd>=0){
+            dup2(stage->err_fd, STDERR_FILENO);
+        }
+
+        // Every pipe end of the pipeline is closed in the child, otherwise a reader never sees end-of-file
+        close_pipes(stage->fds, stage->pipeCount);
+
+        for(struct redirection *r=stage->redirections; r!=NULL; r=r->next){ // Opening the files in the child, leaving the shell's own descriptors untouched
+            if(!apply_redirection(r)){
+                _exit(1);
+            }
+        }
+
+        if(stage->builtin!=NULL){ // A builtin in a pipeline runs in the child, as in other shells
+            if(execPipe[1]>=0){ // There is no exec to wait for
+                close(execPipe[1]);
+            }
+            jobs_forget(); // The builtin may start jobs of its own, which need an event loop of this process
+            current_shell->output = NULL; // Its output already goes where the stage writes
+            struct builtin_io io = {stdin, stdout, stderr};
+            int result = stage->builtin(stage->args, &io);
+            fflush(stdout);
+            fflush(stderr);
+            _exit(result<0 ? 1 : result);
+        }
+
+        if(stage->path!=NULL){ // The command hash already knows where the program is
+            execve(stage->path,stage->args,stage->envp);
+        }else{
+            execvpe(stage->args[0],stage->args,stage->envp);
+        }
+        // Replacing the current process image with a new process image, according to the inputted arguments
+        // If 'execvpe' returns then the following is executed:
+        int error = errno;
+        perror("Unable to execute program!"); // Outputting error message
+        if(execPipe[1]>=0){
+            write_all(execPipe[1], (const char*)&error, sizeof(error));
+        }
+        _exit(127); // Terminating the child, so that it never returns into the shell code
+    }
+
+    return forkPID; // Returning the PID without waiting, so that all stages run concurrently
+}
+
+pid_t posix_spawn_pipe(struct stage_spawn *stage){ // Creating a function to launch a stage through 'posix_spawnp'
+
+    posix_spawn_file_actions_t actions; // The dup2/close/open calls which the child performs before exec
+    posix_spawnattr_t attributes; // The process group and signal settings of the child
+    pid_t spawnPID = -1;
+
+    if(posix_spawn_file_actions_init(&actions)!=0){
+        perror("Unable to create new process!"); // Outputting error message
+        return -1;
+    }
+    if(posix_spawnattr_init(&attributes)!=0){
+        posix_spawn_file_actions_destroy(&actions);
+        perror("Unable to create new process!"); // Outputting error message
+        return -1;
+    }
+
+    sigset_t defaults; // The signals which the shell ignores get their default action back
+    sigemptyset(&defaults);
+    int signals[] = {SIGINT, SIGQUIT, SIGTSTP, SIGTTIN, SIGTTOU, SIGCHLD};
+    for(size_t i=0; i<sizeof(signals)/sizeof(signals[0]); i++){
+        sigaddset(&defaults, signals[i]);
+    }
+    short flags = POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK;
+    posix_spawnattr_setsigdefault(&attributes, &defaults);
+    posix_spawnattr_setsigmask(&attributes, &child_sigmask);
+    if(stage->pgid>=0){ // Joining the process group of the job
+        flags |= POSIX_SPAWN_SETPGROUP;
+        posix_spawnattr_setpgroup(&attributes, stage->pgid);
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 35))
+        if(stage->foreground){ // Giving the terminal to the new group before exec, as 'fork_exec_pipe' does
+            posix_spawn_file_actions_addtcsetpgrp_np(&actions, shell_terminal);
+        }
+#endif
+    }
+    posix_spawnattr_setflags(&attributes, flags);
+
+    // The same steps as in 'fork_exec_pipe', expressed as file actions
+    if(stage->in_fd>=0){
+        posix_spawn_file_actions_adddup2(&actions, stage->in_fd, STDIN_FILENO);
+    }
+    if(stage->out_fd>=0){
+        posix_spawn_file_actions_adddup2(&actions, stage->out_fd, STDOUT_FILENO);
+    }
+    if(stage->err_fd>=0){
+        posix_spawn_file_actions_adddup2(&actions, stage->err_fd, STDERR_FILENO);
+    }
+    for(int i=0; i<stage->pipeCount; i++){ // Closing every pipe end of the pipeline
+        posix_spawn_file_actions_addclose(&actions, stage->fds[i][0]);
+        posix_spawn_file_actions_addclose(&actions, stage->fds[i][1]);
+    }
+    int lowest = STDERR_FILENO + 1; // The files are opened above every descriptor which a redirection replaces
+    size_t redirectionCount = 0;
+    for(struct redirection *r=stage->redirections; r!=NULL; r=r->next){
+        lowest = r->fd >= lowest ? r->fd + 1 : lowest;
+        redirectionCount++;
+    }
+    int *opened = redirectionCount>0 ? malloc(redirectionCount * sizeof(int)) : NULL; // The files opened here, so a failure is reported like 'apply_redirection' does and not as a failed exec
+    int openedCount = 0;
+    if(redirectionCount>0 && opened==NULL){
+        posix_spawn_file_actions_destroy(&actions);
+        posix_spawnattr_destroy(&attributes);
+        perror("Unable to create new process!"); // Outputting error message
+        return -1;
+    }
+    for(struct redirection *r=stage->redirections; r!=NULL; r=r->next){
+        if(r->type==REDIRECT_DUP){
+            posix_spawn_file_actions_adddup2(&actions, r->source_fd, r->fd); // glibc clears close-on-exec when both are the same
+            continue;
+        }
+        int fd = open(r->target, redirection_flags(r->type) | O_CLOEXEC, 0666);
+        if(fd>=0 && fd<lowest){ // A later action must not replace the file before it is moved into place
+            int moved = fcntl(fd, F_DUPFD_CLOEXEC, lowest);
+            close(fd);
+            fd = moved;
+        }
+        if(fd==-1){
+            perror(redirection_error(r)); // Outputting error message
+            for(int i=0; i<openedCount; i++){
+                close(opened[i]);
+            }
+            free(opened);
+            posix_spawn_file_actions_destroy(&actions);
+            posix_spawnattr_destroy(&attributes);
+            return -3;
+        }
+        opened[openedCount++] = fd;
+        posix_spawn_file_actions_adddup2(&actions, fd, r->fd); // The copy in the child loses close-on-exec, the original is closed by exec
+    }
+
+    int error;
+    long long started = TRACE_START();
+    if(stage->path!=NULL){ // The command hash already knows where the program is
+        error = posix_spawn(&spawnPID, stage->path, &actions, &attributes, stage->args, stage->envp);
+    }else{
+        error = posix_spawnp(&spawnPID, stage->args[0], &actions, &attributes, stage->args, stage->envp);
+    }
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attributes);
+    for(int i=0; i<openedCount; i++){ // The child holds its own copies
+        close(opened[i]);
+    }
+    free(opened);
+    TRACE(TRACE_EXEC, started, error==0 ? spawnPID : 0, stage->args[0], error); // glibc returns once the child has exec'd
+
+    if(error!=0){ // 'posix_spawnp' reports exec and file action failures through its return value
+        fprintf(stderr,"Unable to execute program!: %s\n", strerror(error)); // Outputting error message
+        return -2;
+    }
+    return spawnPID;
+}
+
+pid_t spawn_stage(struct stage_spawn *stage){ // Creating a function to launch a stage with the selected backend
+
+    if(spawn_backend==SPAWN_POSIX_SPAWN && stage->builtin==NULL && stage->sched==NULL && stage->cpu<0){ // Builtins, and stages changing their CPUs or limits before exec, always need a fork
+        return posix_spawn_pipe(stage);
+    }
+    return fork_exec_pipe(stage);
+}
+
+struct stage_thread{ // Defining the structure of a builtin stage running on a thread of the shell instead of in a child
+    pthread_t thread;
+    builtin_t builtin;
+    char **args; // A copy of the arguments, as the command line may be freed while the thread runs in the background
+    int fds[3]; // The stdin, stdout and stderr of the builtin, owned by the thread
+    int status; // The exit status of the builtin, once 'done'
+    struct rusage usage; // The resources used by the thread
+    atomic_bool done; // Set once the builtin returned, before 'thread_fd' is signalled
+};
+
+char **copy_arguments(char **args){ // Creating a function to copy an argument vector into a single allocation
+
+    size_t count = 0;
+    size_t size = 0;
+    while(args[count]!=NULL){
+        size += strlen(args[count++]) + 1;
+    }
+    char **copy = malloc((count + 1) * sizeof(char*) + size);
+    if(copy==NULL){
+        return NULL;
+    }
+    char *text = (char*)(copy + count + 1);
+    for(size_t i=0; i<count; i++){
+        copy[i] = text;
+        text = stpcpy(text, args[i]) + 1;
+    }
+    copy[count] = NULL;
+    return copy;
+}
+
+void *stage_thread_main(void *data){ // Creating a function to run a builtin stage on its thread, signalling the event loop when it is done
+
+    struct stage_thread *thread = data;
+    sigset_t blocked; // Signals are left to the main thread, and a write to a closed pipe fails with EPIPE instead of raising SIGPIPE
+    sigfillset(&blocked);
+    pthread_sigmask(SIG_BLOCK, &blocked, NULL);
+
+    FILE *in = fdopen(thread->fds[0], "r");
+    FILE *out = fdopen(thread->fds[1], "w");
+    FILE *err = fdopen(thread->fds[2], "w");
+    thread->status = 1;
+    if(in!=NULL && out!=NULL && err!=NULL){
+        struct builtin_io io = {in, out, err};
+        int result = thread->builtin(thread->args, &io);
+        thread->status = result<0 ? 1 : result;
+    }
+    FILE *streams[3] = {in, out, err};
+    for(int i=0; i<3; i++){ // Closing the pipe ends, so the next stage sees end-of-file
+        if(streams[i]!=NULL){
+            fclose(streams[i]);
+        }else{
+            close(thread->fds[i]);
+        }
+    }
+    sigset_t brokenPipe;
+    sigemptyset(&brokenPipe);
+    sigaddset(&brokenPipe, SIGPIPE);
+    struct timespec now = {0, 0};
+    if(sigtimedwait(&brokenPipe, NULL, &now)==SIGPIPE){ // Writing to a pipe nobody reads anymore ends the stage as SIGPIPE would end a child
+        thread->status = 128 + SIGPIPE;
+    }
+    getrusage(RUSAGE_THREAD, &thread->usage);
+    atomic_store(&thread->done, true);
+    uint64_t one = 1;
+    while(write(thread_fd, &one, sizeof(one))==-1 && errno==EINTR){
+    }
+    return NULL;
+}
+
+bool redirect_thread(int fds[3], const struct redirection *r){ // Creating a function to apply the redirections of a builtin stage to the descriptors its thread will use
+
+    for(; r!=NULL; r=r->next){
+        int fd;
+        if(r->type==REDIRECT_DUP){
+            fd = fcntl(r->source_fd<=STDERR_FILENO ? fds[r->source_fd] : r->source_fd, F_DUPFD_CLOEXEC, 0);
+        }else{
+            fd = open(r->target, redirection_flags(r->type) | O_CLOEXEC, 0666);
+        }
+        if(fd==-1){
+            perror(redirection_error(r)); // Outputting error message
+            return false;
+        }
+        close(fds[r->fd]);
+        fds[r->fd] = fd;
+    }
+    return true;
+}
+
+struct stage_thread *start_stage_thread(builtin_t builtin, char **args, const int stdio[3], const struct redirection *redirections){ // Creating a function to start a builtin stage on a thread, or NULL if it cannot run
+
+    struct stage_thread *thread = calloc(1, sizeof(struct stage_thread));
+    if(thread==NULL){
+        perror("Unable to allocate memory!"); // Outputting error message
+        return NULL;
+    }
+    thread->builtin = builtin;
+    thread->args = copy_arguments(args);
+    atomic_init(&thread->done, false);
+    int opened = 0;
+    for(; opened<3; opened++){ // Copies which later stages do not inherit, so readers still see end-of-file
+        thread->fds[opened] = fcntl(stdio[opened]>=0 ? stdio[opened] : opened, F_DUPFD_CLOEXEC, 0);
+        if(thread->fds[opened]==-1){
+            break;
+        }
+    }
+    bool ready = thread->args!=NULL && opened==3 && redirect_thread(thread->fds, redirections);
+    if(ready && pthread_create(&thread->thread, NULL, stage_thread_main, thread)==0){
+        return thread;
+    }
+    if(ready){
+        perror("Unable to create thread!"); // Outputting error message
+    }
+    for(int i=0; i<opened; i++){
+        close(thread->fds[i]);
+    }
+    free(thread->args);
+    free(thread);
+    return NULL;
+}
+
+bool thread_redirectable(const struct redirection *r){ // Creating a function to check that the redirections of a stage only concern stdin, stdout and stderr
+    for(; r!=NULL; r=r->next){
+        if(r->fd>STDERR_FILENO){
+            return false;
+        }
+    }
+    return true;
+}
+
+enum job_state{ // Defining the states of a job
+    JOB_RUNNING,
+    JOB_STOPPED,
+    JOB_DONE
+};
+
+struct job{ // Defining the structure for a job, one per launched pipeline
+    int id; // The job number, used as '%id'
+    pid_t pgid; // The process group of the job (the PID of its first stage)
+    pid_t *pids; // The PID of every stage, 0 for stages which could not be started or run on a thread
+    struct stage_thread **threads; // The thread running each builtin stage, or NULL
+    int *statuses; // The exit status of every stage
+    bool *finished; // Whether each stage has been reaped
+    struct stage_usage *usages; // The resources used by each reaped stage
+    double started; // When the job was launched, on the monotonic clock
+    int stage_count; // The number of stages
+    int running; // The number of stages still running (not reaped and not stopped)
+    enum job_state state; // The state of the job as a whole
+    bool background; // Whether the job runs in the background
+    char *command; // The pipeline as written
+    struct tinyshell *owner; // The context which started the job, the only one whose builtins see it, or NULL once it is destroyed
+    struct job *next; // The next job, in order of creation
+};
+
+struct job *job_list = NULL; // Every job which has not been reported as done yet
+
+struct job *owned_job(struct job *job){ // Creating a function to find the first job from 'job' on which belongs to the current context
+
+    while(job!=NULL && job->owner!=current_shell){
+        job = job->next;
+    }
+    return job;
+}
+
+void jobs_forget(void){ // Creating a function to drop the job table and event loop inherited from the shell, in a forked child
+
+    job_list = NULL; // The jobs of the shell are not children of this process
+    job_control = false;
+    if(event_fd>=0){ // A signalfd only wakes the epoll instance of the process which registered it, so all three are set up again when needed
+        close(event_fd);
+        close(sigchld_fd);
+        close(thread_fd);
+        event_fd = sigchld_fd = thread_fd = -1;
+    }
+}
+
+bool job_control_init(bool interactive){ // Creating a function to set up child reaping and, for interactive shells, job control
+
+    if(event_fd<0){ // Setting up child reaping once
+
+        sigset_t blocked; // SIGCHLD is only received through 'sigchld_fd'
+        sigemptyset(&blocked);
+        sigaddset(&blocked, SIGCHLD);
+        sigprocmask(SIG_BLOCK, &blocked, &child_sigmask);
+        sigdelset(&child_sigmask, SIGCHLD);
+
+        sigchld_fd = signalfd(-1, &blocked, SFD_NONBLOCK | SFD_CLOEXEC);
+        thread_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        event_fd = epoll_create1(EPOLL_CLOEXEC);
+        struct epoll_event event = {.events = EPOLLIN, .data.fd = sigchld_fd};
+        struct epoll_event threadEvent = {.events = EPOLLIN, .data.fd = thread_fd};
+        if(sigchld_fd==-1 || thread_fd==-1 || event_fd==-1 || epoll_ctl(event_fd, EPOLL_CTL_ADD, sigchld_fd, &event)==-1 || epoll_ctl(event_fd, EPOLL_CTL_ADD, thread_fd, &threadEvent)==-1){
+            perror("Unable to set up child reaping!"); // Outputting error message
+            return false;
+        }
+    }
+
+    if(interactive && !job_control && isatty(shell_terminal)){ // Taking control of the terminal
+        while(tcgetpgrp(shell_terminal)!=(shell_pgid = getpgrp())){ // Waiting until the shell is in the foreground
+            kill(-shell_pgid, SIGTTIN);
+        }
+        signal(SIGINT, SIG_IGN); // The shell itself ignores the job control signals, its children do not
+        signal(SIGQUIT, SIG_IGN);
+        signal(SIGTSTP, SIG_IGN);
+        signal(SIGTTIN, SIG_IGN);
+        signal(SIGTTOU, SIG_IGN);
+        shell_pgid = getpid();
+        setpgid(shell_pgid, shell_pgid); // Putting the shell in its own process group
+        tcsetpgrp(shell_terminal, shell_pgid);
+        job_control = true;
+    }
+    return true;
+}
+
+int job_status(struct job *job){ // Creating a function to obtain the pipefail-style status of a job
+
+    int result = 0;
+    for(int i=0; i<job->stage_count; i++){ // The rightmost failing stage decides the status of the pipeline
+        if(job->statuses[i]!=0){
+            result = job->statuses[i];
+        }
+    }
+    return result;
+}
+
+struct job *job_create(struct shell_pipeline *pipeline){ // Creating a function to add a job for a pipeline to the job table
+
+    struct job *job = calloc(1, sizeof(struct job));
+    if(job==NULL){
+        return NULL;
+    }
+    job->pids = calloc(pipeline->stage_count, sizeof(pid_t));
+    job->threads = calloc(pipeline->stage_count, sizeof(struct stage_thread*));
+    job->statuses = calloc(pipeline->stage_count, sizeof(int));
+    job->finished = calloc(pipeline->stage_count, sizeof(bool));
+    job->usages = calloc(pipeline->stage_count, sizeof(struct stage_usage));
+    job->command = strdup(pipeline->text!=NULL ? pipeline->text : pipeline->stages[0].argv[0]);
+    if(job->pids==NULL || job->threads==NULL || job->statuses==NULL || job->finished==NULL || job->usages==NULL || job->command==NULL){
+        free(job->pids);
+        free(job->threads);
+        free(job->statuses);
+        free(job->finished);
+        free(job->usages);
+        free(job->command);
+        free(job);
+        return NULL;
+    }
+    job->stage_count = pipeline->stage_count;
+    job->background = pipeline->background;
+    job->state = JOB_RUNNING;
+    job->started = monotonic_seconds();
+    job->owner = current_shell;
+
+    job->id = 1; // Numbering the job after the newest one of the same context
+    struct job **last = &job_list;
+    while(*last!=NULL){
+        if((*last)->owner==current_shell){
+            job->id = (*last)->id + 1;
+        }
+        last = &(*last)->next;
+    }
+    *last = job;
+    return job;
+}
+
+void job_free(struct job *job){ // Creating a function to remove a job from the job table
+
+    for(struct job **j=&job_list; *j!=NULL; j=&(*j)->next){
+        if(*j==job){
+            *j = job->next;
+            break;
+        }
+    }
+    free(job->pids);
+    free(job->threads);
+    free(job->statuses);
+    free(job->finished);
+    free(job->usages);
+    free(job->command);
+    free(job);
+}
+
+void job_update_state(struct job *job){ // Creating a function to derive the state of a job from its stages
+
+    bool allFinished = true;
+    for(int i=0; i<job->stage_count; i++){
+        allFinished = allFinished && job->finished[i];
+    }
+    if(allFinished){
+        job->state = JOB_DONE;
+    }else if(job->running==0){ // Every stage left is stopped
+        job->state = JOB_STOPPED;
+    }else{
+        job->state = JOB_RUNNING;
+    }
+}
+
+void reap_children(void){ // Creating a function to collect every child which changed state, without blocking
+
+    struct signalfd_siginfo info;
+    while(sigchld_fd>=0 && read(sigchld_fd, &info, sizeof(info))==sizeof(info)){ // Draining the pending SIGCHLD notifications
+    }
+    uint64_t finishedThreads;
+    if(thread_fd>=0 && read(thread_fd, &finishedThreads, sizeof(finishedThreads))==-1){ // Nothing to drain, the threads are checked anyway
+    }
+
+    int status;
+    pid_t pid;
+    struct rusage usage;
+    for(struct job *job=job_list; job!=NULL; job=job->next){ // Waiting for the stages of every job by their PIDs, so other children of an embedding program are left alone
+        for(int i=0; i<job->stage_count; i++){
+            struct stage_thread *thread = job->threads[i];
+            if(thread!=NULL && atomic_load(&thread->done)){ // A builtin stage returned, its thread is joined from here as a child would be reaped
+                pthread_join(thread->thread, NULL);
+                job->running--;
+                job->finished[i] = true;
+                job->statuses[i] = thread->status;
+                job->usages[i].usage = thread->usage;
+                job->usages[i].elapsed = monotonic_seconds() - job->started;
+                job->threads[i] = NULL;
+                free(thread->args);
+                free(thread);
+                job_update_state(job);
+            }
+            while(job->pids[i]>0 && !job->finished[i] && (pid = wait4(job->pids[i], &status, WNOHANG | WUNTRACED | WCONTINUED, &usage))>0){ // Collecting every change of the stage, with the resources it used
+
+                if(WIFSTOPPED(status)){
+                    job->running--;
+                }else if(WIFCONTINUED(status)){
+                    job->running++;
+                }else{ // The stage exited or was killed
+                    if(job->state!=JOB_STOPPED || job->running>0){
+                        job->running--;
+                    }
+                    job->finished[i] = true;
+                    job->statuses[i] = decode_status(status); // Storing the exit status of the stage
+                    job->usages[i].usage = usage;
+                    job->usages[i].elapsed = monotonic_seconds() - job->started;
+                    TRACE(TRACE_CHILD_EXIT, (long long)(job->started * 1e9), pid, job->command, job->statuses[i]);
+                }
+                job_update_state(job);
+            }
+        }
+    }
+
+    struct job *job = job_list;
+    while(job!=NULL){ // Nobody collects the status of jobs whose context was destroyed
+        struct job *next = job->next;
+        if(job->owner==NULL && job->state==JOB_DONE){
+            job_free(job);
+        }
+        job = next;
+    }
+}
+
+#define WATCH_EVENTS (IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF) // The changes of a watched directory or of its entries
+
+struct watch_target{ // Defining the structure for a file or directory watched by 'watch'
+    int wd; // The inotify watch, on the directory holding a file so that replacing the file is seen too
+    char *name; // The name of the file in that directory, or NULL when the directory itself is watched
+};
+
+struct watch_state{ // Defining the state of a running 'watch'
+    int fd; // The inotify descriptor, also watched by 'event_fd' so that a change cancels the run in progress
+    struct watch_target *targets;
+    size_t target_count;
+    size_t target_capacity;
+    bool changed; // Whether a watched file changed since the last run started
+};
+
+struct watch_state *active_watch = NULL; // The 'watch' whose pipeline is running, or NULL
+
+bool watch_poll(struct watch_state *watch){ // Creating a function to read the pending inotify events, returning whether one of them concerns a watched file
+
+    alignas(struct inotify_event) char buffer[4096];
+    bool changed = false;
+    ssize_t length;
+    while((length = read(watch->fd, buffer, sizeof(buffer)))>0 || (length==-1 && errno==EINTR)){
+        for(char *next = buffer; length>0 && next<buffer + length; ){
+            const struct inotify_event *event = (const struct inotify_event*)next;
+            next += sizeof(struct inotify_event) + event->len;
+            changed = changed || (event->mask & IN_Q_OVERFLOW); // Events were lost, any of them may have mattered
+            for(size_t i=0; i<watch->target_count && !changed; i++){ // The other entries of the directory of a watched file are ignored
+                changed = watch->targets[i].wd==event->wd && (watch->targets[i].name==NULL || (event->len>0 && strcmp(event->name, watch->targets[i].name)==0));
+            }
+        }
+    }
+    watch->changed = watch->changed || changed;
+    return changed;
+}
+
+void job_cancel(struct job *job){ // Creating a function to terminate the stages of a job whose result is no longer wanted, threads ending once their pipes close
+
+    if(job_control && job->pgid>0){ // The whole process group, so that the programs the stages started stop too
+        kill(-job->pgid, SIGTERM);
+        return;
+    }
+    for(int i=0; i<job->stage_count; i++){
+        if(job->pids[i]>0 && !job->finished[i]){
+            kill(job->pids[i], SIGTERM);
+        }
+    }
+}
+
+void wait_event(void){ // Creating a function to block until a child changes state
+
+    struct epoll_event event;
+    while(epoll_wait(event_fd, &event, 1, -1)==-1 && errno==EINTR){ // Sleeping in the event loop instead of in 'wait'
+    }
+}
+
+int job_finish(struct job *job){ // Creating a function to collect the statuses of a finished job and remove it, returning the pipefail-style status
+
+    int *statuses = realloc(current_shell->pipeline_status, job->stage_count * sizeof(int)); // Keeping the status of every stage
+    if(statuses!=NULL){
+        current_shell->pipeline_status = statuses;
+        struct stage_usage *usages = realloc(current_shell->pipeline_usage, job->stage_count * sizeof(struct stage_usage)); // And the resources it used, for 'time'
+        if(usages!=NULL){
+            current_shell->pipeline_usage = usages;
+            current_shell->pipeline_status_count = job->stage_count;
+            memcpy(current_shell->pipeline_status, job->statuses, job->stage_count * sizeof(int));
+            memcpy(current_shell->pipeline_usage, job->usages, job->stage_count * sizeof(struct stage_usage));
+        }
+    }
+
+    int result = job_status(job);
+    job_free(job);
+    return result;
+}
+
+int wait_for_job(struct job *job){ // Creating a function to wait for a foreground job to finish or stop
+
+    if(job_control && job->pgid>0){ // Giving the terminal to the job
+        tcsetpgrp(shell_terminal, job->pgid);
+    }
+
+    long long started = TRACE_START();
+    reap_children();
+    while(job->state==JOB_RUNNING){
+        wait_event();
+        reap_children();
+        if(active_watch!=NULL && watch_poll(active_watch)){ // The files of 'watch' changed, so this run is out of date
+            job_cancel(job);
+        }
+    }
+    TRACE(TRACE_WAIT, started, getpid(), job->command, job_status(job));
+
+    if(job_control){ // Taking the terminal back
+        tcsetpgrp(shell_terminal, shell_pgid);
+    }
+
+    if(job->state==JOB_STOPPED){ // The job stays in the table, to be continued with 'fg' or 'bg'
+        job->background = true;
+        fprintf(stderr,"\n[%d]+  Stopped                 %s\n", job->id, job->command);
+        return 128 + SIGTSTP;
+    }
+    return job_finish(job);
+}
+
+void notify_jobs(bool interactive){ // Creating a function to reap finished background jobs, reporting them in interactive shells
+
+    reap_children();
+    if(!interactive){ // Scripts keep finished jobs until 'wait' or 'jobs' collects their status
+        return;
+    }
+
+    struct job *job = owned_job(job_list);
+    while(job!=NULL){
+        struct job *next = owned_job(job->next);
+        if(job->state==JOB_DONE){
+            int status = job_status(job);
+            if(status==0){
+                fprintf(stderr,"[%d]+  Done                    %s\n", job->id, job->command);
+            }else{
+                fprintf(stderr,"[%d]+  Exit %-3d                %s\n", job->id, status, job->command);
+            }
+            job_free(job);
+        }
+        job = next;
+    }
+}
+
+struct launch_options{ // Defining the structure of the settings used to launch a pipeline
+    bool background; // Whether the job is left running in the background
+    bool process_group; // Whether the job gets its own process group (only with job control)
+    int in_fd; // The stdin of the first stage, or -1 to inherit the shell's
+    int out_fd; // The stdout of the last stage, or -1 to inherit the shell's
+    int err_fd; // The stderr of every stage, or -1 to inherit the shell's
+    builtin_t first_stage; // Run in a child in place of the command of the first stage, with its arguments, or NULL
+};
+
+struct job *launch_pipeline(struct shell_pipeline *pipeline, const struct launch_options *options, int *error){ // Creating a function to start every stage of a pipeline as a job, without waiting for it
+
+    int pipelineStage = pipeline->stage_count; // Obtaining the number of pipeline stages
+
+    *error = 0;
+    if(!job_control_init(false)){
+        *error = -1;
+        return NULL;
+    }
+
+    int pipeCount = pipelineStage-1; // Obtaining the number of pipe objects
+    int fds[pipeCount>0 ? pipeCount : 1][2]; // Creating an array to store, each pipe object and the pipe file descriptors
+
+    long long started = TRACE_START();
+    for(int i=0; i<pipeCount; i++){ // Looping for as many times, as there are pipe objects
+        if(pipe2(fds[i], O_CLOEXEC)==-1){ // Creating a pipe, which later children do not inherit
+            // If '-1' is returned from 'pipe' then the following is executed:
+            perror("Cannot create pipe!"); // Outputting error message
+            close_pipes(fds, i); // Closing the pipes created so far
+            *error = -3;
+            return NULL;
+        }
+    }
+
+    int pipeSize = pipeline->pipe_size>0 ? pipeline->pipe_size : current_shell->pipe_buffer_size;
+    if(pipeCount>0){
+        TRACE(TRACE_PIPE_CREATE, started, getpid(), NULL, pipeCount);
+    }
+    for(int i=0; i<pipeCount && pipeSize>0; i++){ // Larger pipes mean fewer context switches between the stages
+        if(fcntl(fds[i][0], F_SETPIPE_SZ, pipeSize)==-1){
+            perror("Unable to set pipe size!"); // Outputting error message, the pipeline still runs with the default size
+            break;
+        }
+    }
+
+    struct job *job = job_create(pipeline); // Every pipeline is tracked as a job
+    if(job==NULL){
+        perror("Unable to create job!"); // Outputting error message
+        close_pipes(fds, pipeCount);
+        *error = -1;
+        return NULL;
+    }
+    job->background = options->background;
+    bool ownGroup = job_control && options->process_group;
+
+    int result = 0; // Creating a variable to store the error code, if any
+    char **envp = environment_envp(); // Rebuilt only when a variable changed since the last pipeline
+    fflush(stdout); // Forked builtins must not inherit buffered output of the shell
+
+    for(int i=0; i<pipelineStage; i++){ // Looping through every stage, forking all of them up front
+
+        struct shell_command *command = &pipeline->stages[i]; // Obtaining current command
+        const struct builtin_command *builtin = pipelineStage>1 || command->sched!=NULL || pipeline->spread ? find_builtin(command->argv[0]) : NULL; // A builtin given CPUs or limits runs in a child, never in the shell
+        builtin_t method = i==0 && options->first_stage!=NULL ? options->first_stage : builtin!=NULL ? builtin->method : NULL;
+        builtin = i==0 && options->first_stage!=NULL ? NULL : builtin;
+        int stdio[3] = {i>0 ? fds[i-1][0] : options->in_fd, i<pipelineStage-1 ? fds[i][1] : options->out_fd, options->err_fd};
+        bool terminalInput = job_control && stdio[0]<0; // A thread of the shell cannot read the terminal while the job owns it
+        if(builtin!=NULL && command->sched==NULL && !pipeline->spread && (builtin->threading==BUILTIN_THREADED || (builtin->threading==BUILTIN_THREADED_INPUT && !terminalInput)) && thread_redirectable(command->redirections)){ // Builtins which only use their streams run on a thread, saving a fork
+            long long threadStarted = TRACE_START();
+            job->threads[i] = start_stage_thread(builtin->method, command->argv, stdio, command->redirections);
+            TRACE(TRACE_SPAWN, threadStarted, getpid(), command->argv[0], job->threads[i]!=NULL ? 0 : -1);
+            if(job->threads[i]==NULL){ // The stage fails as one whose redirection failed, the other stages still run
+                job->finished[i] = true;
+                job->statuses[i] = 1;
+            }else{
+                job->running++;
+            }
+            continue;
+        }
+        struct stage_spawn stage = { // Describing the current stage
+            .args = command->argv,
+            .path = method==NULL ? command_hash_lookup(command->argv[0]) : NULL,
+            .builtin = method,
+            .in_fd = stdio[0], // Every stage but the first reads from the previous pipe
+            .out_fd = stdio[1], // Every stage but the last writes to the next pipe
+            .err_fd = stdio[2],
+            .redirections = command->redirections, // Files are opened by the child
+            .fds = fds,
+            .pipeCount = pipeCount,
+            .pgid = ownGroup ? job->pgid : -1, // The first stage leads a new process group
+            .foreground = ownGroup && !options->background && job->pgid==0, // The first process of the job, builtin stages before it having no process
+            .envp = envp,
+            .sched = command->sched,
+            .cpu = pipeline->spread ? spread_cpu(i) : -1
+        };
+
+        long long spawnStarted = TRACE_START();
+        pid_t forkPID = spawn_stage(&stage); // Launching the stage with the selected backend
+        TRACE(TRACE_SPAWN, spawnStarted, forkPID>0 ? forkPID : getpid(), command->argv[0], forkPID);
+
+        if(forkPID==-1){ // If an error is encountered
+            printf("Program was unable to create a new process!\n"); // Outputting error message
+            result = -1;
+            break;
+        }else if(forkPID==-2 || forkPID==-3){ // The program could not be executed, or a redirection failed before the spawn, the other stages still run
+            job->finished[i] = true;
+            job->statuses[i] = forkPID==-2 ? 127 : 1; // Status 1 like a child of 'fork_exec_pipe' whose redirection fails
+            continue;
+        }
+
+        job->pids[i] = forkPID;
+        job->running++;
+        if(job->pgid==0){
+            job->pgid = forkPID;
+        }
+    }
+
+    for(int i=0; i<pipelineStage; i++){ // Stages which were never started count as finished
+        if(job->pids[i]==0 && job->threads[i]==NULL && !job->finished[i]){
+            job->finished[i] = true;
+            job->statuses[i] = 127;
+        }
+    }
+    job_update_state(job);
+
+    close_pipes(fds, pipeCount); // The parent uses no pipe end, so all of them are closed once every stage is forked
+
+    if(result!=0){ // If the pipeline could not be started completely
+        wait_for_job(job); // Reaping the stages which were already started
+        *error = result;
+        return NULL;
+    }
+    return job;
+}
+
+void deliver_output(int fd, int stream){ // Creating a function to pass everything left in a descriptor to the output callback of the context
+
+    char buffer[65536];
+    ssize_t length;
+    while((length = read(fd, buffer, sizeof(buffer)))>0 || (length==-1 && errno==EINTR)){
+        if(length>0){
+            current_shell->output(current_shell->output_data, stream, buffer, length);
+        }
+    }
+}
+
+void capture_job_output(struct job *job, int outFd, int errFd){ // Creating a function to pass the output of a job to the callback while it runs, reaping it from the same event loop
+
+    int fds[2] = {outFd, errFd};
+    int openCount = 0;
+    for(int i=0; i<2; i++){
+        struct epoll_event event = {.events = EPOLLIN, .data.fd = fds[i]};
+        if(epoll_ctl(event_fd, EPOLL_CTL_ADD, fds[i], &event)==0){
+            openCount++;
+        }else{ // Without the event loop the output is read once the job is done
+            perror("Unable to capture output!"); // Outputting error message
+        }
+    }
+
+    char buffer[65536];
+    while(openCount>0){
+        bool done = job->state!=JOB_RUNNING; // Once the job is done, only what is already in the pipes is read, in case a grandchild keeps them open
+        struct epoll_event events[4];
+        int count = epoll_wait(event_fd, events, 4, done ? 0 : -1);
+        if(count==-1 && errno==EINTR){
+            continue;
+        }
+        if(count<=0){
+            break;
+        }
+        for(int e=0; e<count; e++){
+            if(events[e].data.fd==sigchld_fd || events[e].data.fd==thread_fd){
+                reap_children();
+                continue;
+            }
+            if(active_watch!=NULL && events[e].data.fd==active_watch->fd){
+                if(watch_poll(active_watch)){
+                    job_cancel(job);
+                }
+                continue;
+            }
+            int stream = events[e].data.fd==outFd ? STDOUT_FILENO : STDERR_FILENO;
+            ssize_t length = read(events[e].data.fd, buffer, sizeof(buffer));
+            if(length>0){
+                current_shell->output(current_shell->output_data, stream, buffer, length);
+            }else if(length==0 || errno!=EINTR){ // Every writer is gone
+                epoll_ctl(event_fd, EPOLL_CTL_DEL, events[e].data.fd, NULL);
+                openCount--;
+            }
+        }
+        if(job->state==JOB_STOPPED){ // A stopped job may never write again
+            break;
+        }
+    }
+
+    for(int i=0; i<2; i++){
+        epoll_ctl(event_fd, EPOLL_CTL_DEL, fds[i], NULL);
+        close(fds[i]);
+    }
+}
+
+int fork_exec_pipe_with(struct shell_pipeline *pipeline, bool async, builtin_t firstStage){ // Creating a function to run a pipeline, the first stage optionally being replaced by a function run in a child
+
+    if(pipeline->stage_count==0){ // Nothing to execute
+        return 0;
+    }
+
+    struct launch_options options = {async, true, -1, -1, -1, firstStage}; // Using the shell's own descriptors
+    int outPipe[2] = {-1, -1};
+    int errPipe[2] = {-1, -1};
+    bool capture = current_shell->output!=NULL && !async; // Background jobs outlive the call, so they keep the shell's descriptors
+    if(capture){
+        if(pipe2(outPipe, O_CLOEXEC)==-1 || pipe2(errPipe, O_CLOEXEC)==-1){
+            perror("Cannot create pipe!"); // Outputting error message
+            if(outPipe[0]>=0){
+                close(outPipe[0]);
+                close(outPipe[1]);
+            }
+            return -3;
+        }
+        options.out_fd = outPipe[1];
+        options.err_fd = errPipe[1];
+    }
+
+    int error;
+    struct job *job = launch_pipeline(pipeline, &options, &error);
+    if(capture){ // Only the stages write to the pipes
+        close(outPipe[1]);
+        close(errPipe[1]);
+        if(job!=NULL && current_shell->detach && !pipeline->timed){ // The caller reads the output and collects the job from its own event loop
+            current_shell->detached = job;
+            current_shell->detached_fds[0] = outPipe[0];
+            current_shell->detached_fds[1] = errPipe[0];
+            return 0;
+        }else if(job==NULL){
+            deliver_output(outPipe[0], STDOUT_FILENO);
+            deliver_output(errPipe[0], STDERR_FILENO);
+            close(outPipe[0]);
+            close(errPipe[0]);
+        }else{
+            capture_job_output(job, outPipe[0], errPipe[0]);
+        }
+    }
+    if(job==NULL){
+        return error;
+    }
+
+    if(async){ // The job is reaped from the event loop later
+        if(job_control){
+            fprintf(stderr,"[%d] %d\n", job->id, (int)job->pids[pipeline->stage_count-1]);
+        }
+        return 0;
+    }
+
+    return wait_for_job(job); // Waiting for every stage, returning the pipefail-style exit status
+}
+
+int fork_exec_pipe_ex(struct shell_pipeline *pipeline, bool async){
+    return fork_exec_pipe_with(pipeline, async, NULL);
+}
+
+int execute_pipeline_async(char **pipeline[], bool async){ // Running a pipeline given as argument vectors, optionally without waiting for it
+
+    int stageCount = 0;
+    while(pipeline[stageCount]!=NULL){ // Counting the stages
+        stageCount++;
+    }
+
+    struct shell_command stages[stageCount>0 ? stageCount : 1];
+    for(int i=0; i<stageCount; i++){ // Wrapping every argument vector in a command without redirections
+        stages[i].argv = pipeline[i];
+        stages[i].argc = 0;
+        while(pipeline[i][stages[i].argc]!=NULL){
+            stages[i].argc++;
+        }
+        stages[i].redirections = NULL;
+        stages[i].word_flags = NULL;
+        stages[i].sched = NULL;
+    }
+
+    struct shell_pipeline wrapped = {stages, stageCount, async, NULL, 0, false, false, false, false, NULL, NULL, LIST_SEQUENCE, NULL};
+    return fork_exec_pipe_ex(&wrapped, async);
+}
+
+int execute_pipeline(char **pipeline[]){ // Running a pipeline given as argument vectors and waiting for all of its stages
+    return execute_pipeline_async(pipeline, false);
+}
+
+char *shell_cwd = NULL; // The working directory of the shell, tracked by 'cd' so that 'pwd' needs no system call
+
+const char *current_directory(void){ // Creating a function to obtain the tracked working directory
+
+    if(shell_cwd==NULL){ // Obtaining it once, it is only updated by 'cd' afterwards
+        shell_cwd = getcwd(NULL, 0);
+    }
+    return shell_cwd;
+}
+
+int builtin_exit(char **args, struct builtin_io *io){ // Implementing a builtin command 'exit'.
+
+    long status = current_shell->last_status;
+    if(args[1]!=NULL){
+        char *end;
+        errno = 0;
+        status = strtol(args[1], &end, 10);
+        if(errno!=0 || end==args[1] || *end!='\0'){
+            fprintf(io->err,"Error: exit: '%s' is not a valid status\n", args[1]); // Output error message
+            return 2;
+        }
+        if(args[2]!=NULL){
+            fprintf(io->err,"Error: exit: Too many arguments\n"); // Output error message
+            return 2;
+        }
+    }
+    fflush(io->out);
+    current_shell->exit_requested = true; // The lines being run stop here, an embedding program is never terminated
+    return (int)(status & 255);
+}
+
+int builtin_cd(char **args, struct builtin_io *io){ // Implementing a builtin command 'cd'
+
+    if(args[1]==NULL){ // If there is no argument following 'cd'
+        fprintf(io->err,"Error: Missing operand\n"); // Output error message
+        return -7;
+    }else{
+        if(chdir(args[1])!=0){ // If changing directory has failed
+            fprintf(io->err,"Error: Failed to change directory\n"); // Output error message
+            return -8;
+        }
+    }
+
+    free(shell_cwd); // Updating the tracked working directory
+    shell_cwd = getcwd(NULL, 0);
+    if(shell_cwd!=NULL){
+        variable_set("PWD", shell_cwd); // Keeping $PWD in step for programs which read it
+    }
+    return 0;
+}
+
+int builtin_cwd(char **args, struct builtin_io *io){ // Implementing a builtin command 'cwd' (also available as 'pwd')
+
+    const char *CurrentWorkingDirectory = current_directory(); // Obtaining current working directory and printing it to stdout
+    if(CurrentWorkingDirectory!=NULL){ // If the directory is obtained
+        fprintf(io->out,"%s\n",CurrentWorkingDirectory); // The directory is outputted
+    }else{ // Otherwise
+        fprintf(io->err,"Error: Failed to obtain the working directory\n"); // Output error message
+        return -9;
+    }
+    return 0;
+}
+
+int builtin_ver(char **args, struct builtin_io *io){ // Implementing a builtin command 'ver'
+    fprintf(io->out,"Tiny Shell v1.0\nAuthor: Matthew Mifsud\nAvailable Functions: [, bg, cd, cwd, echo, exit, export, false, fg, hash, history, jobs, kill, memo, parallel, pipesize, printf, pwd, tee, test, true, unset, ver, wait\n");
+    return 0;
+}
+
+int builtin_true(char **args, struct builtin_io *io){ // Implementing a builtin command 'true'
+    return 0;
+}
+
+int builtin_false(char **args, struct builtin_io *io){ // Implementing a builtin command 'false'
+    return 1;
+}
+
+int print_one_escape(const char **cursor, FILE *out){ // Creating a function to print the escape following a backslash, returning 1 at '\c'
+
+    const char *c = *cursor; // The character after the backslash
+
+    switch(*c){
+        case 'a': fputc('\a', out); break;
+        case 'b': fputc('\b', out); break;
+        case 'c': return 1; // No further output is produced
+        case 'e': fputc('\033', out); break;
+        case 'f': fputc('\f', out); break;
+        case 'n': fputc('\n', out); break;
+        case 'r': fputc('\r', out); break;
+        case 't': fputc('\t', out); break;
+        case 'v': fputc('\v', out); break;
+        case '\\': fputc('\\', out); break;
+        case '0': { // An octal value of up to three digits
+            int value = 0;
+            for(int i=0; i<3 && c[1]>='0' && c[1]<='7'; i++){
+                value = value*8 + (*++c - '0');
+            }
+            fputc(value, out);
+            break;
+        }
+        default: // Unknown escapes are printed as they are
+            fputc('\\', out);
+            fputc(*c, out);
+    }
+    *cursor = c;
+    return 0;
+}
+
+int print_escape(const char *string, FILE *out){ // Creating a function to print a string interpreting backslash escapes, returning 1 at '\c'
+
+    for(const char *c=string; *c!='\0'; c++){
+        if(*c!='\\' || c[1]=='\0'){ // An ordinary character
+            fputc(*c, out);
+            continue;
+        }
+        c++;
+        if(print_one_escape(&c, out)==1){
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int builtin_echo(char **args, struct builtin_io *io){ // Implementing a builtin command 'echo'
+
+    bool newline = true; // '-n' suppresses the trailing newline
+    bool escapes = false; // '-e' interprets backslash escapes
+    int i = 1;
+
+    for(; args[i]!=NULL && args[i][0]=='-' && args[i][1]!='\0' && strspn(args[i]+1,"neE")==strlen(args[i]+1); i++){ // Reading the options
+        for(const char *c=args[i]+1; *c!='\0'; c++){
+            if(*c=='n'){
+                newline = false;
+            }else{
+                escapes = *c=='e';
+            }
+        }
+    }
+
+    for(bool first=true; args[i]!=NULL; i++, first=false){ // Printing the arguments separated by spaces
+        if(!first){
+            fputc(' ', io->out);
+        }
+        if(escapes){
+            if(print_escape(args[i], io->out)==1){
+                return 0;
+            }
+        }else{
+            fputs(args[i], io->out);
+        }
+    }
+    if(newline){
+        fputc('\n', io->out);
+    }
+    return 0;
+}
+
+int builtin_printf(char **args, struct builtin_io *io){ // Implementing a builtin command 'printf'
+
+    if(args[1]==NULL){ // If there is no format
+        fprintf(io->err,"Error: printf: Missing format\n"); // Output error message
+        return 2;
+    }
+
+    const char *format = args[1];
+    char **arg = &args[2]; // The next argument to be converted
+    int result = 0;
+
+    do{ // The format is reused as long as arguments remain
+        char **first = arg;
+        for(const char *c=format; *c!='\0'; c++){
+
+            if(*c=='\\' && c[1]!='\0'){ // An escape sequence
+                c++;
+                if(print_one_escape(&c, io->out)==1){
+                    return result;
+                }
+                continue;
+            }
+            if(*c!='%'){ // An ordinary character
+                fputc(*c, io->out);
+                continue;
+            }
+            if(c[1]=='%'){ // '%%' prints a single '%'
+                fputc('%', io->out);
+                c++;
+                continue;
+            }
+
+            char spec[32] = "%"; // Copying the flags, width and precision of the conversion
+            size_t specLength = 1 + strspn(c+1, "-+ #0123456789.");
+            if(specLength>=sizeof(spec)-3){
+                fprintf(io->err,"Error: printf: Invalid format\n"); // Output error message
+                return 1;
+            }
+            memcpy(spec, c, specLength);
+            c += specLength;
+            char conversion = *c;
+            const char *value = *arg!=NULL ? *arg++ : NULL; // Missing arguments count as empty or zero
+
+            if(conversion=='d' || conversion=='i'){ // Signed integers
+                strcpy(spec+specLength, "lld");
+                long long number = value!=NULL ? strtoll(value, NULL, 0) : 0;
+                fprintf(io->out, spec, number);
+            }else if(conversion=='u' || conversion=='o' || conversion=='x' || conversion=='X'){ // Unsigned integers
+                spec[specLength] = 'l';
+                spec[specLength+1] = 'l';
+                spec[specLength+2] = conversion;
+                spec[specLength+3] = '\0';
+                unsigned long long number = value!=NULL ? strtoull(value, NULL, 0) : 0;
+                fprintf(io->out, spec, number);
+            }else if(conversion!='\0' && strchr("fFeEgGaA", conversion)!=NULL){ // Floating point numbers, in 'long double' as the printf program does
+                spec[specLength] = 'L';
+                spec[specLength+1] = conversion;
+                spec[specLength+2] = '\0';
+                long double number = value!=NULL ? strtold(value, NULL) : 0;
+                fprintf(io->out, spec, number);
+            }else if(conversion=='c'){ // The first character of the argument
+                char character[2] = {value!=NULL ? value[0] : '\0', '\0'};
+                strcpy(spec+specLength, "s");
+                fprintf(io->out, spec, character);
+            }else if(conversion=='s'){ // A string
+                strcpy(spec+specLength, "s");
+                fprintf(io->out, spec, value!=NULL ? value : "");
+            }else if(conversion=='b'){ // A string with backslash escapes
+                if(value!=NULL && print_escape(value, io->out)==1){
+                    return result;
+                }
+            }else{
+                fprintf(io->err,"Error: printf: Unknown conversion '%%%c'\n", conversion); // Output error message
+                return 1;
+            }
+            if(conversion=='\0'){
+                break;
+            }
+        }
+        if(arg==first){ // The format converted no argument, so repeating it would never end
+            break;
+        }
+    }while(*arg!=NULL);
+
+    return result;
+}
+
+bool test_integer(const char *string, long long *value){ // Creating a function to read an integer operand of 'test'
+
+    char *end;
+    errno = 0;
+    *value = strtoll(string, &end, 10);
+    return errno==0 && end!=string && *end=='\0';
+}
+
+int test_unary(const char *op, const char *operand){ // Creating a function to evaluate a unary 'test' operator, returning -1 if unknown
+
+    struct stat info;
+
+    if(strcmp(op,"-n")==0){
+        return operand[0]!='\0';
+    }else if(strcmp(op,"-z")==0){
+        return operand[0]=='\0';
+    }else if(strcmp(op,"-L")==0 || strcmp(op,"-h")==0){
+        return lstat(operand, &info)==0 && S_ISLNK(info.st_mode);
+    }else if(strcmp(op,"-r")==0){
+        return access(operand, R_OK)==0;
+    }else if(strcmp(op,"-w")==0){
+        return access(operand, W_OK)==0;
+    }else if(strcmp(op,"-x")==0){
+        return access(operand, X_OK)==0;
+    }else if(strlen(op)!=2 || op[0]!='-' || strchr("efdsbcp", op[1])==NULL){
+        return -1;
+    }
+
+    if(stat(operand, &info)!=0){ // The remaining operators need the file to exist
+        return 0;
+    }
+    switch(op[1]){
+        case 'e': return 1;
+        case 'f': return S_ISREG(info.st_mode);
+        case 'd': return S_ISDIR(info.st_mode);
+        case 's': return info.st_size>0;
+        case 'b': return S_ISBLK(info.st_mode);
+        case 'c': return S_ISCHR(info.st_mode);
+        default: return S_ISFIFO(info.st_mode);
+    }
+}
+
+int test_binary(const char *left, const char *op, const char *right){ // Creating a function to evaluate a binary 'test' operator, returning -1 if unknown
+
+    if(strcmp(op,"=")==0 || strcmp(op,"==")==0){
+        return strcmp(left, right)==0;
+    }else if(strcmp(op,"!=")==0){
+        return strcmp(left, right)!=0;
+    }
+
+    const char *integerOps[] = {"-eq", "-ne", "-lt", "-le", "-gt", "-ge"};
+    for(int i=0; i<6; i++){
+        if(strcmp(op, integerOps[i])==0){
+            long long a, b;
+            if(!test_integer(left, &a) || !test_integer(right, &b)){
+                return -2; // Not an integer
+            }
+            int results[] = {a==b, a!=b, a<b, a<=b, a>b, a>=b};
+            return results[i];
+        }
+    }
+    return -1;
+}
+
+int test_expression(char **args, int argc, struct builtin_io *io){ // Creating a function to evaluate a 'test' expression of up to four arguments (POSIX rules)
+
+    int result = -1;
+
+    if(argc==0){ // No expression is false
+        return 1;
+    }else if(argc==1){ // A single string is true if not empty
+        return args[0][0]=='\0';
+    }else if(strcmp(args[0],"!")==0 && argc<=4 && !(argc==3 && test_binary(args[0],args[1],args[2])>=0)){ // Negating the rest of the expression
+        int inner = test_expression(args+1, argc-1, io);
+        return inner>1 ? inner : !inner;
+    }else if(argc==2){
+        result = test_unary(args[0], args[1]);
+    }else if(argc==3){
+        result = test_binary(args[0], args[1], args[2]);
+    }else{
+        fprintf(io->err,"Error: test: Too many arguments\n"); // Output error message
+        return 2;
+    }
+
+    if(result==-2){
+        fprintf(io->err,"Error: test: Integer expression expected\n"); // Output error message
+        return 2;
+    }else if(result<0){
+        fprintf(io->err,"Error: test: Unknown operator '%s'\n", args[argc==2 ? 0 : 1]); // Output error message
+        return 2;
+    }
+    return !result; // A true expression gives the exit status 0
+}
+
+int builtin_test(char **args, struct builtin_io *io){ // Implementing a builtin command 'test' (also available as '[')
+
+    int argc = 0;
+    while(args[argc]!=NULL){ // Counting the arguments
+        argc++;
+    }
+
+    if(strcmp(args[0],"[")==0){ // '[' needs a closing ']'
+        if(strcmp(args[argc-1],"]")!=0){
+            fprintf(io->err,"Error: [: Missing ']'\n"); // Output error message
+            return 2;
+        }
+        argc--;
+    }
+    return test_expression(args+1, argc-1, io);
+}
+
+int builtin_export(char **args, struct builtin_io *io){ // Implementing a builtin command 'export'
+
+    if(args[1]==NULL){ // Listing the environment, sorted by name
+        char **envp = environment_envp();
+        size_t count = environment.count;
+        char **sorted = malloc((count>0 ? count : 1) * sizeof(char*));
+        if(sorted==NULL){
+            fprintf(io->err,"Error: Unable to allocate memory\n"); // Output error message
+            return 1;
+        }
+        memcpy(sorted, envp, count * sizeof(char*));
+        qsort(sorted, count, sizeof(char*), compare_strings);
+        for(size_t i=0; i<count; i++){
+            fprintf(io->out,"export %s\n", sorted[i]);
+        }
+        free(sorted);
+        return 0;
+    }
+
+    int result = 0;
+    for(int i=1; args[i]!=NULL; i++){ // Setting every NAME=VALUE argument
+        char *equals = strchr(args[i], '=');
+        size_t nameLength = equals!=NULL ? (size_t)(equals - args[i]) : strlen(args[i]);
+        if(!valid_identifier(args[i], nameLength)){
+            fprintf(io->err,"Error: export: '%s' is not a valid identifier\n", args[i]); // Output error message
+            result = 1;
+            continue;
+        }
+        if(equals!=NULL){
+            *equals = '\0'; // The argument lives in the parser arena, so it can be split in place
+            variable_set(args[i], equals+1);
+            *equals = '=';
+        }
+    }
+    return result;
+}
+
+int builtin_unset(char **args, struct builtin_io *io){ // Implementing a builtin command 'unset'
+
+    int result = 0;
+    for(int i=1; args[i]!=NULL; i++){ // Removing every named variable, names which are not set being ignored
+        if(!valid_identifier(args[i], strlen(args[i]))){
+            fprintf(io->err,"Error: unset: '%s' is not a valid identifier\n", args[i]); // Output error message
+            result = 1;
+            continue;
+        }
+        variable_unset(args[i]);
+    }
+    return result;
+}
+
+int builtin_hash(char **args, struct builtin_io *io){ // Implementing a builtin command 'hash'
+
+    if(args[1]==NULL){ // Listing the cached commands
+        if(command_hash.count==0){
+            fprintf(io->out,"hash: hash table empty\n");
+            return 0;
+        }
+        fprintf(io->out,"hits\tcommand\n");
+        for(size_t i=0; i<command_hash.capacity; i++){
+            if(command_hash.entries[i].name!=NULL){
+                fprintf(io->out,"%4u\t%s\n", command_hash.entries[i].hits, command_hash.entries[i].path);
+            }
+        }
+        return 0;
+    }
+
+    if(strcmp(args[1],"-r")==0 || strcmp(args[1],"clear")==0){ // Forgetting every cached command
+        command_hash_clear();
+        return 0;
+    }
+
+    int result = 0;
+    for(int i=1; args[i]!=NULL; i++){ // Adding the given commands to the cache
+        if(command_hash_lookup(args[i])==NULL){
+            fprintf(io->err,"Error: hash: %s: not found\n", args[i]); // Output error message
+            result = -11;
+        }
+    }
+    return result;
+}
+
+struct job *find_job(const char *spec, struct builtin_io *io){ // Creating a function to find a job from '%n', '%%', '%+', '%-' or a PID
+
+    struct job *last = NULL; // The current job, '%%' or '%+'
+    struct job *previous = NULL; // The job before it, '%-'
+    for(struct job *job=owned_job(job_list); job!=NULL; job=owned_job(job->next)){
+        previous = last;
+        last = job;
+    }
+
+    if(spec==NULL || strcmp(spec,"%%")==0 || strcmp(spec,"%+")==0 || strcmp(spec,"%")==0){
+        if(last==NULL){
+            fprintf(io->err,"Error: No current job\n"); // Output error message
+        }
+        return last;
+    }else if(strcmp(spec,"%-")==0){
+        if(previous==NULL){
+            fprintf(io->err,"Error: No previous job\n"); // Output error message
+        }
+        return previous;
+    }
+
+    char *end;
+    long number = strtol(spec[0]=='%' ? spec+1 : spec, &end, 10);
+    if(*end=='\0' && end!=spec){
+        for(struct job *job=owned_job(job_list); job!=NULL; job=owned_job(job->next)){
+            if(spec[0]=='%' ? job->id==number : job->pgid==number || job->pids[0]==number){
+                return job;
+            }
+        }
+    }
+    fprintf(io->err,"Error: %s: No such job\n", spec); // Output error message
+    return NULL;
+}
+
+const char *job_state_name(struct job *job){ // Creating a function to describe the state of a job
+
+    static char exitText[16];
+    if(job->state==JOB_RUNNING){
+        return "Running";
+    }else if(job->state==JOB_STOPPED){
+        return "Stopped";
+    }
+    int status = job_status(job);
+    if(status==0){
+        return "Done";
+    }
+    snprintf(exitText, sizeof(exitText), "Exit %d", status);
+    return exitText;
+}
+
+int builtin_jobs(char **args, struct builtin_io *io){ // Implementing a builtin command 'jobs'
+
+    bool pidsOnly = args[1]!=NULL && strcmp(args[1],"-p")==0; // '-p' only lists process groups
+    bool withPids = args[1]!=NULL && strcmp(args[1],"-l")==0; // '-l' adds the process groups
+
+    reap_children();
+    struct job *job = owned_job(job_list);
+    while(job!=NULL){
+        struct job *next = owned_job(job->next);
+        char marker = next==NULL ? '+' : (owned_job(next->next)==NULL ? '-' : ' ');
+        if(pidsOnly){
+            fprintf(io->out,"%d\n", (int)job->pgid);
+        }else if(withPids){
+            fprintf(io->out,"[%d]%c %d %-22s %s\n", job->id, marker, (int)job->pgid, job_state_name(job), job->command);
+        }else{
+            fprintf(io->out,"[%d]%c  %-22s %s\n", job->id, marker, job_state_name(job), job->command);
+        }
+        if(job->state==JOB_DONE){ // A finished job is reported once
+            job_free(job);
+        }
+        job = next;
+    }
+    return 0;
+}
+
+int builtin_wait(char **args, struct builtin_io *io){ // Implementing a builtin command 'wait'
+
+    if(args[1]==NULL){ // Waiting for every job
+        reap_children();
+        while(true){
+            bool running = false;
+            for(struct job *job=owned_job(job_list); job!=NULL; job=owned_job(job->next)){
+                running = running || job->state==JOB_RUNNING;
+            }
+            if(!running){
+                break;
+            }
+            wait_event();
+            reap_children();
+        }
+        struct job *job = owned_job(job_list);
+        while(job!=NULL){ // Finished jobs have been collected
+            struct job *next = owned_job(job->next);
+            if(job->state==JOB_DONE){
+                job_free(job);
+            }
+            job = next;
+        }
+        return 0;
+    }
+
+    int result = 0;
+    for(int i=1; args[i]!=NULL; i++){ // Waiting for the given jobs, the status being that of the last one
+        struct job *job = find_job(args[i], io);
+        if(job==NULL){
+            result = 127;
+            continue;
+        }
+        reap_children();
+        while(job->state==JOB_RUNNING){
+            wait_event();
+            reap_children();
+        }
+        result = job->state==JOB_STOPPED ? 128 + SIGTSTP : job_status(job);
+        if(job->state==JOB_DONE){
+            job_free(job);
+        }
+    }
+    return result;
+}
+
+int builtin_fg(char **args, struct builtin_io *io){ // Implementing a builtin command 'fg'
+
+    struct job *job = find_job(args[1], io);
+    if(job==NULL){
+        return 1;
+    }
+
+    fprintf(io->out,"%s\n", job->command);
+    fflush(io->out);
+    job->background = false;
+    if(job->state==JOB_STOPPED){ // Continuing every stage of the job
+        if(job_control){
+            tcsetpgrp(shell_terminal, job->pgid); // The terminal is handed over before the job can read from it
+        }
+        for(int i=0; i<job->stage_count; i++){
+            if(job->pids[i]>0 && !job->finished[i]){
+                kill(job->pids[i], SIGCONT);
+            }
+        }
+        job->running = 0; // Counted again as every stage reports that it continued
+        for(int i=0; i<job->stage_count; i++){
+            job->running += !job->finished[i];
+        }
+        job->state = JOB_RUNNING;
+    }
+    return wait_for_job(job);
+}
+
+int builtin_bg(char **args, struct builtin_io *io){ // Implementing a builtin command 'bg'
+
+    struct job *job = find_job(args[1], io);
+    if(job==NULL){
+        return 1;
+    }
+    if(job->state!=JOB_STOPPED){
+        fprintf(io->err,"Error: bg: Job %d is not stopped\n", job->id); // Output error message
+        return 1;
+    }
+
+    job->background = true;
+    for(int i=0; i<job->stage_count; i++){ // Continuing every stage of the job
+        if(job->pids[i]>0 && !job->finished[i]){
+            kill(job->pids[i], SIGCONT);
+            job->running++;
+        }
+    }
+    job->state = JOB_RUNNING;
+    fprintf(io->out,"[%d]+ %s &\n", job->id, job->command);
+    return 0;
+}
+
+int parse_signal(const char *name){ // Creating a function to convert a signal name or number, returning -1 if unknown
+
+    char *end;
+    long number = strtol(name, &end, 10);
+    if(*end=='\0' && end!=name){
+        return number>=0 && number<NSIG ? (int)number : -1;
+    }
+    if(strncmp(name,"SIG",3)==0){
+        name += 3;
+    }
+    for(int i=1; i<NSIG; i++){
+        const char *abbreviation = sigabbrev_np(i);
+        if(abbreviation!=NULL && strcasecmp(abbreviation, name)==0){
+            return i;
+        }
+    }
+    return -1;
+}
+
+int builtin_kill(char **args, struct builtin_io *io){ // Implementing a builtin command 'kill'
+
+    int signalNumber = SIGTERM;
+    int i = 1;
+
+    if(args[i]!=NULL && strcmp(args[i],"-l")==0){ // Listing the signal names
+        for(int s=1; s<NSIG; s++){
+            if(sigabbrev_np(s)!=NULL){
+                fprintf(io->out,"%2d) SIG%s\n", s, sigabbrev_np(s));
+            }
+        }
+        return 0;
+    }
+    if(args[i]!=NULL && strcmp(args[i],"-s")==0 && args[i+1]!=NULL){ // '-s NAME'
+        signalNumber = parse_signal(args[i+1]);
+        i += 2;
+    }else if(args[i]!=NULL && args[i][0]=='-' && args[i][1]!='\0'){ // '-NAME' or '-N'
+        signalNumber = parse_signal(args[i]+1);
+        i++;
+    }
+    if(signalNumber<0){
+        fprintf(io->err,"Error: kill: Unknown signal\n"); // Output error message
+        return 1;
+    }
+    if(args[i]==NULL){
+        fprintf(io->err,"Error: kill: Missing operand\n"); // Output error message
+        return 1;
+    }
+
+    int result = 0;
+    for(; args[i]!=NULL; i++){
+        if(args[i][0]=='%'){ // A job receives the signal in every stage
+            struct job *job = find_job(args[i], io);
+            if(job==NULL){
+                result = 1;
+                continue;
+            }
+            if(job_control && job->pgid>0){
+                kill(-job->pgid, signalNumber);
+            }else{
+                for(int s=0; s<job->stage_count; s++){
+                    if(job->pids[s]>0 && !job->finished[s]){
+                        kill(job->pids[s], signalNumber);
+                    }
+                }
+            }
+            if(job->state==JOB_STOPPED && signalNumber!=SIGCONT && signalNumber!=SIGSTOP && signalNumber!=SIGTSTP){ // A stopped job only acts on the signal once continued
+                kill(job_control ? -job->pgid : job->pids[0], SIGCONT);
+            }
+        }else{ // A plain PID
+            char *end;
+            long pid = strtol(args[i], &end, 10);
+            if(*end!='\0' || end==args[i] || kill((pid_t)pid, signalNumber)==-1){
+                fprintf(io->err,"Error: kill: %s: %s\n", args[i], *end!='\0' || end==args[i] ? "Invalid process id" : strerror(errno)); // Output error message
+                result = 1;
+            }
+        }
+    }
+    return result;
+}
+
+struct parallel_slot{ // Defining the structure for a job started by 'parallel'
+    bool used; // Whether the slot holds an input
+    struct job *job; // The running job, or NULL once it is done
+    char **argv; // The argument vector of the job
+    int output_fd; // The memfd collecting the output of the job when grouping, or -1
+    size_t sequence; // The position of the input, to keep the output in order with '-k'
+};
+
+char **parallel_argv(char **command, int argc, const char *input){ // Creating a function to build the argument vector of a job from the first 'argc' words of the command, replacing '{}' with the input
+
+    bool replaced = false;
+    for(int i=0; i<argc; i++){
+        replaced = replaced || strstr(command[i], "{}")!=NULL;
+    }
+
+    char **argv = calloc(argc + 2, sizeof(char*));
+    if(argv==NULL){
+        return NULL;
+    }
+    for(int i=0; i<argc; i++){
+        const char *found = strstr(command[i], "{}");
+        if(found==NULL){
+            argv[i] = strdup(command[i]);
+        }else{ // Every '{}' of the argument is replaced
+            size_t count = 0;
+            for(const char *f=found; f!=NULL; f=strstr(f+2, "{}")){
+                count++;
+            }
+            argv[i] = malloc(strlen(command[i]) + count*strlen(input) + 1);
+            if(argv[i]!=NULL){
+                char *out = argv[i];
+                const char *in = command[i];
+                for(const char *f=found; f!=NULL; f=strstr(in, "{}")){
+                    memcpy(out, in, f - in);
+                    out += f - in;
+                    out = stpcpy(out, input);
+                    in = f + 2;
+                }
+                strcpy(out, in);
+            }
+        }
+        if(argv[i]==NULL){
+            for(int j=0; j<i; j++){
+                free(argv[j]);
+            }
+            free(argv);
+            return NULL;
+        }
+    }
+    if(!replaced){ // Without '{}' the input is added as the last argument
+        argv[argc] = strdup(input);
+        if(argv[argc]==NULL){
+            for(int j=0; j<argc; j++){
+                free(argv[j]);
+            }
+            free(argv);
+            return NULL;
+        }
+    }
+    return argv;
+}
+
+void free_argv(char **argv){ // Creating a function to free an argument vector built with malloc
+
+    for(int i=0; argv!=NULL && argv[i]!=NULL; i++){
+        free(argv[i]);
+    }
+    free(argv);
+}
+
+int builtin_parallel(char **args, struct builtin_io *io){ // Implementing a builtin command 'parallel'
+
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN); // Keeping one job per online CPU by default
+    bool group = false; // '-g' keeps the output of every job together
+    bool keepOrder = false; // '-k' prints the output in the order of the inputs (implies '-g')
+    int i = 1;
+
+    for(; args[i]!=NULL && args[i][0]=='-'; i++){ // Reading the options
+        if(strcmp(args[i],"-j")==0 && args[i+1]!=NULL){
+            jobs = atol(args[++i]);
+        }else if(strncmp(args[i],"-j",2)==0 && isdigit((unsigned char)args[i][2])){
+            jobs = atol(args[i]+2);
+        }else if(strcmp(args[i],"-g")==0 || strcmp(args[i],"--group")==0){
+            group = true;
+        }else if(strcmp(args[i],"-k")==0 || strcmp(args[i],"--keep-order")==0){
+            group = keepOrder = true;
+        }else if(strcmp(args[i],"--")==0){
+            i++;
+            break;
+        }else{
+            fprintf(io->err,"Error: parallel: Unknown option '%s'\n", args[i]); // Output error message
+            return 2;
+        }
+    }
+
+    char **command = &args[i]; // The command, up to ':::'
+    int commandLength = 0;
+    while(command[commandLength]!=NULL && strcmp(command[commandLength],":::")!=0){
+        commandLength++;
+    }
+    if(commandLength==0){
+        fprintf(io->err,"Usage: parallel [-j N] [-g] [-k] command [{}] [::: arguments...]\n"); // Output error message
+        return 2;
+    }
+    char **inputs = command[commandLength]!=NULL ? &command[commandLength+1] : NULL; // Without ':::' the inputs are the lines of stdin
+
+    if(jobs<1){
+        jobs = 1;
+    }
+    struct parallel_slot *slots = calloc(jobs, sizeof(struct parallel_slot));
+    if(slots==NULL){
+        perror("Unable to allocate memory!"); // Outputting error message
+        return 1;
+    }
+
+    int nullFd = open("/dev/null", O_RDONLY | O_CLOEXEC); // Jobs do not share the shell's stdin
+    fflush(io->out);
+    int outFd = fileno(io->out);
+
+    char *line = NULL;
+    size_t lineCapacity = 0;
+    size_t nextInput = 0; // The sequence number of the next input
+    size_t nextOutput = 0; // The sequence number of the next output to print with '-k'
+    long used = 0; // The slots holding a job which is running or whose output is not printed yet
+    int failed = 0;
+    bool inputsLeft = true;
+
+    while(true){
+
+        while(inputsLeft && used<jobs){ // Starting jobs while there are free slots
+            const char *input;
+            if(inputs!=NULL){
+                input = inputs[nextInput];
+            }else{
+                ssize_t length = getline(&line, &lineCapacity, io->in);
+                if(length>0 && line[length-1]=='\n'){
+                    line[length-1] = '\0';
+                }
+                input = length>=0 ? line : NULL;
+            }
+            if(input==NULL){
+                inputsLeft = false;
+                break;
+            }
+
+            struct parallel_slot *slot = slots;
+            while(slot->used){ // Finding a free slot
+                slot++;
+            }
+            slot->used = true;
+            slot->sequence = nextInput++;
+            used++;
+
+            slot->argv = parallel_argv(command, commandLength, input);
+            slot->output_fd = group ? memfd_create("parallel", MFD_CLOEXEC) : -1;
+            if(slot->argv==NULL || (group && slot->output_fd==-1)){
+                perror("Unable to start job!"); // Outputting error message
+                failed++;
+                continue; // The slot is released with no output
+            }
+
+            struct shell_command stage = {slot->argv, commandLength + 1, NULL, NULL, NULL};
+            struct shell_pipeline pipeline = {&stage, 1, false, slot->argv[0], 0, false, false, false, false, NULL, NULL, LIST_SEQUENCE, NULL};
+            struct launch_options options = {true, false, nullFd, group ? slot->output_fd : outFd, -1, NULL}; // Jobs stay in the shell's process group, so Ctrl-C reaches them
+            int error;
+            slot->job = launch_pipeline(&pipeline, &options, &error);
+            if(slot->job==NULL){
+                failed++;
+            }
+        }
+
+        reap_children();
+        bool running = false;
+        for(long s=0; s<jobs; s++){ // Collecting the finished jobs
+            struct parallel_slot *slot = &slots[s];
+            if(slot->job!=NULL && slot->job->state==JOB_DONE){
+                if(job_status(slot->job)!=0){
+                    failed++;
+                }
+                job_free(slot->job);
+                slot->job = NULL;
+            }
+            running = running || slot->job!=NULL;
+        }
+
+        bool released = true;
+        while(released){ // Printing the outputs of the finished jobs, in the order of the inputs with '-k'
+            released = false;
+            for(long s=0; s<jobs; s++){
+                struct parallel_slot *slot = &slots[s];
+                if(!slot->used || slot->job!=NULL || (keepOrder && slot->sequence!=nextOutput)){
+                    continue;
+                }
+                if(slot->output_fd>=0){
+                    copy_fd(slot->output_fd, outFd);
+                    close(slot->output_fd);
+                    slot->output_fd = -1;
+                }
+                free_argv(slot->argv);
+                slot->argv = NULL;
+                slot->used = false;
+                used--;
+                nextOutput++;
+                released = true;
+            }
+        }
+
+        if(!running){
+            if(!inputsLeft && used==0){
+                break;
+            }
+            continue; // Slots were released, so more jobs can be started
+        }
+        wait_event(); // Sleeping until any job exits
+    }
+
+    free(line);
+    free(slots);
+    if(nullFd>=0){
+        close(nullFd);
+    }
+    return failed>101 ? 101 : failed; // As GNU parallel, the number of failed jobs
+}
+
+bool parse_size(const char *text, int *size){ // Creating a function to read a size in bytes, with an optional 'K' or 'M' suffix
+
+    char *end;
+    errno = 0;
+    unsigned long value = strtoul(text, &end, 10);
+    if(end==text || errno!=0){
+        return false;
+    }
+    if(*end=='K' || *end=='k'){
+        value <<= 10;
+        end++;
+    }else if(*end=='M' || *end=='m'){
+        value <<= 20;
+        end++;
+    }
+    if(*end!='\0' || value>INT_MAX){
+        return false;
+    }
+    *size = (int)value;
+    return true;
+}
+
+int builtin_pipesize(char **args, struct builtin_io *io){ // Implementing a builtin command 'pipesize', setting the buffer size of new pipes
+
+    if(args[1]==NULL){ // Showing the current setting
+        if(current_shell->pipe_buffer_size>0){
+            fprintf(io->out,"%d\n", current_shell->pipe_buffer_size);
+        }else{
+            fprintf(io->out,"default\n");
+        }
+        return 0;
+    }
+    if(args[2]!=NULL){ // 'pipesize N command...' is handled before the pipeline is run
+        fprintf(io->err,"Error: pipesize: Too many arguments\n"); // Output error message
+        return 2;
+    }
+
+    int size;
+    if(strcmp(args[1],"default")==0){
+        size = 0;
+    }else if(!parse_size(args[1], &size)){
+        fprintf(io->err,"Error: pipesize: '%s' is not a valid size\n", args[1]); // Output error message
+        return 2;
+    }
+    current_shell->pipe_buffer_size = size;
+    return 0;
+}
+
+bool splice_all(int from, int to, size_t length){ // Creating a function to move an exact number of bytes out of a pipe, without a copy through user space when possible
+
+    char buffer[65536];
+    while(length>0){
+        ssize_t moved = splice(from, NULL, to, NULL, length, SPLICE_F_MOVE);
+        if(moved==-1 && errno==EINTR){
+            continue;
+        }
+        if(moved==-1 && errno==EINVAL){ // Files opened for appending and terminals cannot be spliced to
+            moved = read(from, buffer, length<sizeof(buffer) ? length : sizeof(buffer));
+            if(moved>0 && !write_all(to, buffer, moved)){
+                return false;
+            }
+        }
+        if(moved<=0){
+            return false;
+        }
+        length -= moved;
+    }
+    return true;
+}
+
+int builtin_tee(char **args, struct builtin_io *io){ // Implementing a builtin command 'tee', copying its input to its output and to files
+
+    bool append = false;
+    int i = 1;
+    for(; args[i]!=NULL && args[i][0]=='-' && args[i][1]!='\0'; i++){
+        if(strcmp(args[i],"-a")==0){
+            append = true;
+        }else if(strcmp(args[i],"--")==0){
+            i++;
+            break;
+        }else{
+            fprintf(io->err,"Usage: tee [-a] [file...]\n"); // Output error message
+            return 2;
+        }
+    }
+
+    int fileCount = 0;
+    while(args[i+fileCount]!=NULL){
+        fileCount++;
+    }
+    int *outputs = malloc((fileCount + 1) * sizeof(int)); // The stdout first, then every file
+    int (*copies)[2] = malloc((fileCount + 1) * sizeof(*copies)); // A pipe per output but the last, holding its copy of the data
+    if(outputs==NULL || copies==NULL){
+        perror("Unable to allocate memory!"); // Outputting error message
+        free(outputs);
+        free(copies);
+        return 1;
+    }
+
+    int status = 0;
+    int outputCount = 1;
+    fflush(io->out);
+    outputs[0] = fileno(io->out);
+    for(; args[i]!=NULL; i++){
+        int fd = open(args[i], O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : O_TRUNC), 0666);
+        if(fd==-1){
+            fprintf(io->err,"Error: tee: '%s': %s\n", args[i], strerror(errno)); // Output error message
+            status = 1;
+            continue;
+        }
+        outputs[outputCount++] = fd;
+    }
+
+    int in = fileno(io->in);
+    int copyCount = 0;
+    int staging[2] = {-1, -1};
+
+    if(outputCount==1){ // A single output is a plain copy
+        if(!copy_data(in, outputs[0])){
+            if(errno!=EPIPE){
+                perror("Unable to copy input!"); // Outputting error message
+            }
+            status = 1;
+        }
+        goto done;
+    }
+
+    struct stat info;
+    int source = in; // The pipe which the data is duplicated from
+    if(fstat(in, &info)==-1 || !S_ISFIFO(info.st_mode)){ // 'tee(2)' needs a pipe, so other inputs are spliced into one first
+        if(pipe2(staging, O_CLOEXEC)==-1){
+            perror("Cannot create pipe!"); // Outputting error message
+            status = 1;
+            goto done;
+        }
+        source = staging[0];
+    }
+
+    int capacity = fcntl(source, F_GETPIPE_SZ);
+    for(; copyCount<outputCount-1; copyCount++){ // An empty pipe as large as the source always takes a whole copy of it
+        if(pipe2(copies[copyCount], O_CLOEXEC)==-1){
+            perror("Cannot create pipe!"); // Outputting error message
+            status = 1;
+            goto done;
+        }
+        fcntl(copies[copyCount][1], F_SETPIPE_SZ, capacity);
+    }
+
+    char buffer[65536];
+    while(true){
+        ssize_t available;
+        if(staging[0]>=0){ // Filling the staging pipe from the input
+            available = splice(in, NULL, staging[1], NULL, capacity, SPLICE_F_MOVE);
+            if(available==-1 && errno==EINVAL){ // Terminals cannot be spliced from
+                available = read(in, buffer, sizeof(buffer)<(size_t)capacity ? sizeof(buffer) : (size_t)capacity);
+                if(available>0 && !write_all(staging[1], buffer, available)){
+                    available = -1;
+                }
+            }
+        }else{ // The first copy also tells how much data is waiting in the input pipe
+            available = tee(in, copies[0][1], capacity, 0);
+        }
+        if(available==-1 && errno==EINTR){
+            continue;
+        }
+        if(available<=0){
+            if(available==-1){
+                perror("Unable to read input!"); // Outputting error message
+                status = 1;
+            }
+            break;
+        }
+
+        bool ok = true;
+        for(int o=0; o<outputCount-1 && ok; o++){ // Duplicating the data for every output but the last, without consuming it
+            ssize_t copied = o==0 && staging[0]<0 ? available : tee(source, copies[o][1], available, 0);
+            ok = copied==available && splice_all(copies[o][0], outputs[o], available);
+        }
+        ok = ok && splice_all(source, outputs[outputCount-1], available); // The last output consumes the data
+        if(!ok){
+            if(errno!=EPIPE){ // A reader which went away is not an error, a forked 'tee' would have been ended by SIGPIPE
+                perror("Unable to write output!"); // Outputting error message
+            }
+            status = 1;
+            break;
+        }
+    }
+
+done:
+    for(int o=1; o<outputCount; o++){
+        close(outputs[o]);
+    }
+    for(int c=0; c<copyCount; c++){
+        close(copies[c][0]);
+        close(copies[c][1]);
+    }
+    if(staging[0]>=0){
+        close(staging[0]);
+        close(staging[1]);
+    }
+    free(outputs);
+    free(copies);
+    return status;
+}
+
+#define HISTORY_BLOCK_ENTRIES 64 // The number of entries described by every record of the history index
+#define HISTORY_BLOOM_BITS 4096 // The size of the trigram filter of a record
+#define HISTORY_INDEX_MAGIC "TSHIDX1" // Identifying an index file, and the version of its layout
+
+struct history_block{ // Defining the structure of an index record, describing a run of entries of the history file
+    uint64_t start; // The offset of the first entry
+    uint64_t end; // The offset after the last entry
+    uint64_t first_entry; // The number of the first entry, counting from 1
+    unsigned char bloom[HISTORY_BLOOM_BITS / 8]; // A bloom filter of the trigrams found in the entries, so searches skip records which cannot match
+};
+
+struct history_index_header{ // Defining the structure at the start of the index file, the records following it
+    char magic[8];
+    uint64_t inode; // The history file described, an index of a replaced file is rebuilt
+    uint64_t indexed; // The offset up to which the history file is described by records
+    uint64_t entries; // The number of entries before 'indexed'
+    uint64_t blocks; // The number of records
+};
+
+struct history{ // Defining the structure of the history, an append-only file mapped into memory with an index of it
+    int fd; // The history file, opened for appending, or -1 without history
+    int index_fd; // The index file, or -1 if it cannot be used (every search is then a scan)
+    char *index_path; // The name of the index file, which a rebuilt index replaces
+    const char *data; // The mapping of the history file
+    size_t mapped; // The size of 'data'
+    size_t size; // The offset after the last complete entry
+    const char *index; // The mapping of the index file
+    size_t index_mapped; // The size of 'index'
+    const struct history_block *blocks; // The records, oldest first
+    size_t block_count;
+    uint64_t indexed; // The offset up to which entries are described by 'blocks', later ones are scanned
+    uint64_t indexed_entries; // The number of entries before 'indexed'
+};
+
+struct history shell_history = {-1, -1, NULL, NULL, 0, 0, NULL, 0, NULL, 0, 0, 0}; // The history of interactive sessions, shared by every context
+
+uint32_t trigram_hash(const char *text){ // Creating a function to hash three bytes, for the filters of the index
+    uint32_t hash = (unsigned char)text[0] | (unsigned char)text[1] << 8 | (uint32_t)(unsigned char)text[2] << 16;
+    return hash * 0x9E3779B1u;
+}
+
+void bloom_add(unsigned char *bloom, uint32_t hash){ // Creating a function to add a trigram to a filter, as two bits
+    bloom[(hash % HISTORY_BLOOM_BITS) / 8] |= 1 << (hash % 8);
+    bloom[((hash >> 16) % HISTORY_BLOOM_BITS) / 8] |= 1 << ((hash >> 16) % 8);
+}
+
+bool bloom_test(const unsigned char *bloom, uint32_t hash){ // Creating a function to check whether a filter may contain a trigram
+    return (bloom[(hash % HISTORY_BLOOM_BITS) / 8] & 1 << (hash % 8)) && (bloom[((hash >> 16) % HISTORY_BLOOM_BITS) / 8] & 1 << ((hash >> 16) % 8));
+}
+
+void history_index_reopen(struct history *history){ // Creating a function to switch to the index file which another session put in place of the opened one
+
+    struct stat opened, named;
+    if(fstat(history->index_fd, &opened)==-1 || stat(history->index_path, &named)==-1 || (opened.st_dev==named.st_dev && opened.st_ino==named.st_ino)){
+        return;
+    }
+    int fd = open(history->index_path, O_RDWR | O_CLOEXEC);
+    if(fd==-1){
+        return;
+    }
+    close(history->index_fd);
+    history->index_fd = fd;
+    if(history->index!=NULL){ // The mapping of the replaced file stays valid, but no longer grows
+        munmap((void*)history->index, history->index_mapped);
+        history->index = NULL;
+        history->index_mapped = 0;
+    }
+}
+
+void history_index(struct history *history, ino_t inode){ // Creating a function to describe the entries not in the index yet, and to map the index
+
+    struct history_index_header header;
+    bool locked = false; // Records are only added under an exclusive lock, as several sessions share the files
+    while(true){
+        history_index_reopen(history);
+        bool valid = pread(history->index_fd, &header, sizeof(header), 0)==sizeof(header) && memcmp(header.magic, HISTORY_INDEX_MAGIC, 8)==0;
+        if(!valid || header.inode!=(uint64_t)inode || header.indexed>history->size){ // Missing, or describing another file
+            memset(&header, 0, sizeof(header));
+            memcpy(header.magic, HISTORY_INDEX_MAGIC, 8);
+            header.inode = inode;
+            valid = false;
+        }
+
+        size_t complete = 0; // The number of complete records which can be added
+        size_t count = 0;
+        for(size_t offset=header.indexed; offset<history->size; ){ // Counting the entries after the last record
+            offset = (const char*)memchr(history->data + offset, '\n', history->size - offset) - history->data + 1;
+            if(++count==HISTORY_BLOCK_ENTRIES){
+                complete++;
+                count = 0;
+            }
+        }
+        if(valid && complete==0){ // Nothing to add, the tail is scanned
+            break;
+        }
+        if(!locked){ // Reading the header again once no other session can change it
+            if(flock(history->fd, LOCK_EX)==-1){ // The history file is locked, as the index file may be replaced
+                return;
+            }
+            locked = true;
+            continue;
+        }
+
+        int fd = history->index_fd;
+        char temporary[PATH_MAX];
+        if(!valid){ // A new index is written aside and renamed into place, as other sessions may still map the records of the old one
+            if(snprintf(temporary, sizeof(temporary), "%s.XXXXXX", history->index_path)>=(int)sizeof(temporary) || (fd = mkostemp(temporary, O_CLOEXEC))==-1){
+                break;
+            }
+        }
+        for(size_t b=0; b<complete; b++){ // Describing the next entries, in runs of HISTORY_BLOCK_ENTRIES
+            struct history_block block;
+            memset(&block, 0, sizeof(block));
+            block.start = header.indexed;
+            block.first_entry = header.entries + 1;
+            size_t offset = block.start;
+            for(int e=0; e<HISTORY_BLOCK_ENTRIES; e++){
+                size_t end = (const char*)memchr(history->data + offset, '\n', history->size - offset) - history->data;
+                for(size_t c=offset; c+2<end; c++){
+                    bloom_add(block.bloom, trigram_hash(history->data + c));
+                }
+                offset = end + 1;
+            }
+            block.end = offset;
+            if(pwrite(fd, &block, sizeof(block), sizeof(header) + header.blocks * sizeof(block))!=sizeof(block)){
+                break;
+            }
+            header.blocks++;
+            header.entries += HISTORY_BLOCK_ENTRIES;
+            header.indexed = block.end;
+        }
+        if(pwrite(fd, &header, sizeof(header), 0)!=sizeof(header)){ // The header is written last, so readers never see missing records
+            perror("Unable to write history index!"); // Outputting error message
+            if(!valid){
+                close(fd);
+                unlink(temporary);
+            }
+            memset(&header, 0, sizeof(header)); // Nothing is mapped, every search scans
+            break;
+        }
+        if(!valid){
+            if(rename(temporary, history->index_path)==-1){
+                perror("Unable to write history index!"); // Outputting error message
+                close(fd);
+                unlink(temporary);
+                memset(&header, 0, sizeof(header));
+                break;
+            }
+            history_index_reopen(history); // Picking up the new file, as other sessions do
+            close(fd);
+        }
+        break;
+    }
+    if(locked){
+        flock(history->fd, LOCK_UN);
+    }
+
+    size_t length = sizeof(header) + header.blocks * sizeof(struct history_block);
+    if(length!=history->index_mapped){ // Mapping the records, including the ones added by other sessions
+        if(history->index!=NULL){
+            munmap((void*)history->index, history->index_mapped);
+        }
+        history->index = mmap(NULL, length, PROT_READ, MAP_SHARED, history->index_fd, 0);
+        if(history->index==MAP_FAILED){
+            history->index = NULL;
+            history->index_mapped = 0;
+            history->block_count = 0;
+            history->indexed = history->indexed_entries = 0;
+            return;
+        }
+        history->index_mapped = length;
+    }
+    history->blocks = (const struct history_block*)(history->index + sizeof(header));
+    history->block_count = header.blocks;
+    history->indexed = header.indexed;
+    history->indexed_entries = header.entries;
+}
+
+void history_refresh(struct history *history){ // Creating a function to map the entries appended since the last call, by any session
+
+    struct stat info;
+    if(history->fd<0 || fstat(history->fd, &info)==-1){
+        return;
+    }
+    if((size_t)info.st_size!=history->mapped){
+        if(history->data!=NULL){
+            munmap((void*)history->data, history->mapped);
+        }
+        history->data = info.st_size>0 ? mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, history->fd, 0) : NULL;
+        if(history->data==MAP_FAILED){
+            history->data = NULL;
+        }
+        history->mapped = history->data!=NULL ? (size_t)info.st_size : 0;
+        const char *last = history->mapped>0 ? memrchr(history->data, '\n', history->mapped) : NULL;
+        history->size = last!=NULL ? (size_t)(last - history->data + 1) : 0; // An entry being appended by another session is left out
+    }
+    if(history->index_fd>=0){
+        history_index(history, info.st_ino);
+    }
+}
+
+bool history_open(struct history *history){ // Creating a function to open the history file named by TINYSHELL_HISTORY, or ~/.tinyshell_history
+
+    if(history->fd>=0){
+        history_refresh(history);
+        return true;
+    }
+    const char *path = getenv("TINYSHELL_HISTORY");
+    const char *home = getenv("HOME");
+    char defaultPath[PATH_MAX];
+    if(path==NULL && home!=NULL){
+        snprintf(defaultPath, sizeof(defaultPath), "%s/.tinyshell_history", home);
+        path = defaultPath;
+    }
+    if(path==NULL || path[0]=='\0'){ // An empty TINYSHELL_HISTORY turns history off
+        return false;
+    }
+
+    history->fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600); // Appending keeps the entries of concurrent sessions whole
+    if(history->fd==-1){
+        return false;
+    }
+    char indexPath[PATH_MAX];
+    if(snprintf(indexPath, sizeof(indexPath), "%s.idx", path)<(int)sizeof(indexPath) && (history->index_path = strdup(indexPath))!=NULL){
+        history->index_fd = open(indexPath, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    }
+    history_refresh(history);
+    return true;
+}
+
+size_t history_entry_end(const struct history *history, size_t offset){ // Creating a function to find the newline ending the entry at 'offset'
+    return (const char*)memchr(history->data + offset, '\n', history->size - offset) - history->data;
+}
+
+ssize_t history_previous(const struct history *history, size_t offset){ // Creating a function to find the entry before the one at 'offset', or -1
+
+    if(offset==0 || offset>history->size){
+        return -1;
+    }
+    const char *newline = offset>1 ? memrchr(history->data, '\n', offset - 1) : NULL;
+    return newline!=NULL ? newline - history->data + 1 : 0;
+}
+
+void history_add(struct history *history, const char *line){ // Creating a function to append an entry, unless it repeats the last one
+
+    if(history->fd<0){
+        return;
+    }
+    history_refresh(history);
+    size_t length = strlen(line);
+    ssize_t last = history_previous(history, history->size);
+    if(last>=0 && history->size - last - 1==length && memcmp(history->data + last, line, length)==0){
+        return;
+    }
+    struct iovec parts[2] = {{(void*)line, length}, {"\n", 1}};
+    if(writev(history->fd, parts, 2)==-1){ // One write, so entries of concurrent sessions never interleave
+        perror("Unable to write history!"); // Outputting error message
+    }
+}
+
+ssize_t history_last_match(const struct history *history, size_t from, size_t to, const char *query, size_t queryLength){ // Creating a function to find the last entry between two offsets containing a text
+
+    ssize_t found = -1;
+    const char *match;
+    while(from<to && (match = memmem(history->data + from, to - from, query, queryLength))!=NULL){
+        const char *newline = memrchr(history->data + from, '\n', match - history->data - from);
+        found = newline!=NULL ? newline - history->data + 1 : (ssize_t)from;
+        from = history_entry_end(history, match - history->data) + 1;
+    }
+    return found;
+}
+
+int history_trigrams(const char *query, size_t queryLength, uint32_t *hashes){ // Creating a function to hash the trigrams of a query, returning how many were used
+
+    int count = 0;
+    for(size_t c=0; c+2<queryLength && count<32; c++){
+        hashes[count++] = trigram_hash(query + c);
+    }
+    return count;
+}
+
+bool history_block_may_match(const struct history_block *block, const uint32_t *hashes, int count){ // Creating a function to check the filter of a record
+    for(int i=0; i<count; i++){
+        if(!bloom_test(block->bloom, hashes[i])){
+            return false;
+        }
+    }
+    return true;
+}
+
+ssize_t history_search(const struct history *history, const char *query, size_t before){ // Creating a function to find the newest entry starting before 'before' which contains a text, or -1
+
+    size_t queryLength = strlen(query);
+    if(queryLength==0 || history->data==NULL){
+        return -1;
+    }
+    before = before < history->size ? before : history->size;
+    uint32_t hashes[32];
+    int count = history_trigrams(query, queryLength, hashes);
+
+    if(before>history->indexed){ // The entries not described by the index are scanned
+        ssize_t found = history_last_match(history, history->indexed, before, query, queryLength);
+        if(found>=0){
+            return found;
+        }
+    }
+    for(size_t b=history->block_count; b-->0;){ // Only the records whose filter has every trigram are read
+        const struct history_block *block = &history->blocks[b];
+        if(block->start>=before || !history_block_may_match(block, hashes, count)){
+            continue;
+        }
+        ssize_t found = history_last_match(history, block->start, block->end < before ? block->end : before, query, queryLength);
+        if(found>=0){
+            return found;
+        }
+    }
+    return -1;
+}
+
+void history_print(const struct history *history, FILE *out, size_t from, size_t to, uint64_t number, const char *query){ // Creating a function to list the entries between two offsets, numbered from 'number', only those containing 'query' if it is not NULL
+
+    size_t queryLength = query!=NULL ? strlen(query) : 0;
+    while(from<to){
+        size_t end = history_entry_end(history, from);
+        if(query!=NULL){ // Skipping straight to the next entry containing the text
+            const char *match = memmem(history->data + from, to - from, query, queryLength);
+            if(match==NULL){
+                return;
+            }
+            for(const char *newline=history->data + from; (newline = memchr(newline, '\n', match - newline))!=NULL; newline++){
+                number++;
+                from = newline - history->data + 1;
+            }
+            end = history_entry_end(history, from);
+        }
+        fprintf(out,"%5llu  %.*s\n", (unsigned long long)number, (int)(end - from), history->data + from);
+        number++;
+        from = end + 1;
+    }
+}
+
+int builtin_history(char **args, struct builtin_io *io){ // Implementing a builtin command 'history', listing every entry, the last N ones or, with '-g', those containing a text
+
+    struct history *history = &shell_history;
+    if(!history_open(history)){
+        return 0; // Without a history file there is nothing to list
+    }
+
+    if(args[1]!=NULL && strcmp(args[1],"-g")==0){ // Searching with the index, so only records which may match are read
+        if(args[2]==NULL){
+            fprintf(io->err,"Usage: history [-g text | count]\n"); // Output error message
+            return 1;
+        }
+        uint32_t hashes[32];
+        int count = history_trigrams(args[2], strlen(args[2]), hashes);
+        for(size_t b=0; b<history->block_count; b++){
+            const struct history_block *block = &history->blocks[b];
+            if(history_block_may_match(block, hashes, count)){
+                history_print(history, io->out, block->start, block->end, block->first_entry, args[2]);
+            }
+        }
+        history_print(history, io->out, history->indexed, history->size, history->indexed_entries + 1, args[2]);
+        return 0;
+    }
+
+    if(args[1]!=NULL){ // Listing the last entries, found from the end of the file
+        char *end;
+        long wanted = strtol(args[1], &end, 10);
+        if(*end!='\0' || wanted<0){
+            fprintf(io->err,"Error: history: '%s' is not a count\n", args[1]); // Output error message
+            return 1;
+        }
+        uint64_t total = history->indexed_entries;
+        for(const char *c=history->data + history->indexed; c<history->data + history->size; c=(const char*)memchr(c, '\n', history->data + history->size - c) + 1){
+            total++;
+        }
+        size_t from = history->size;
+        long listed = 0;
+        ssize_t previous;
+        while(listed<wanted && (previous = history_previous(history, from))>=0){
+            from = previous;
+            listed++;
+        }
+        history_print(history, io->out, from, history->size, total - listed + 1, NULL);
+        return 0;
+    }
+
+    history_print(history, io->out, 0, history->size, 1, NULL);
+    return 0;
+}
+
+const struct builtin_command builtin_list[] = { // Defining a list of builtin commands, kept sorted by name for 'bsearch'
+    {"[",&builtin_test,BUILTIN_THREADED},
+    {"bg",&builtin_bg,BUILTIN_FORKED},
+    {"cd",&builtin_cd,BUILTIN_FORKED},
+    {"cwd",&builtin_cwd,BUILTIN_FORKED},
+    {"echo",&builtin_echo,BUILTIN_THREADED},
+    {"exit",&builtin_exit,BUILTIN_FORKED},
+    {"export",&builtin_export,BUILTIN_FORKED},
+    {"false",&builtin_false,BUILTIN_THREADED},
+    {"fg",&builtin_fg,BUILTIN_FORKED},
+    {"hash",&builtin_hash,BUILTIN_FORKED},
+    {"history",&builtin_history,BUILTIN_FORKED},
+    {"jobs",&builtin_jobs,BUILTIN_FORKED},
+    {"kill",&builtin_kill,BUILTIN_FORKED},
+    {"memo",&builtin_memo,BUILTIN_FORKED},
+    {"parallel",&builtin_parallel,BUILTIN_FORKED},
+    {"pipesize",&builtin_pipesize,BUILTIN_FORKED},
+    {"printf",&builtin_printf,BUILTIN_THREADED},
+    {"pwd",&builtin_cwd,BUILTIN_FORKED},
+    {"tee",&builtin_tee,BUILTIN_THREADED_INPUT},
+    {"test",&builtin_test,BUILTIN_THREADED},
+    {"true",&builtin_true,BUILTIN_THREADED},
+    {"unset",&builtin_unset,BUILTIN_FORKED},
+    {"ver",&builtin_ver,BUILTIN_THREADED},
+    {"wait",&builtin_wait,BUILTIN_FORKED}
+};
+
+int compare_builtin(const void *name, const void *builtin){ // Creating a function to compare a name with a builtin command, for 'bsearch'
+    return strcmp(name, ((const struct builtin_command*)builtin)->name);
+}
+
+const struct builtin_command *find_builtin(const char *name){ // Creating a function to look up a builtin command by its exact name
+
+    int builtinNum = sizeof(builtin_list) / sizeof(struct builtin_command); // Calculating the number of builtin commands available
+    return bsearch(name, builtin_list, builtinNum, sizeof(struct builtin_command), compare_builtin);
+}
+
+int execute_builtin_command(struct shell_command *command){ // Creating a function to run a builtin command in the shell process
+
+    long long started = TRACE_START();
+    const struct builtin_command *builtin = find_builtin(command->argv[0]); // Obtaining the builtin matching the opcode
+    TRACE(TRACE_BUILTIN_LOOKUP, started, getpid(), command->argv[0], builtin!=NULL);
+    if(builtin==NULL){
+        return -6; // Builtin command not found
+    }
+
+    FILE *streams[3] = {stdin, stdout, stderr}; // Builtins use the shell's streams unless redirected, the shell's own descriptors stay untouched
+    bool opened[3] = {false, false, false}; // Whether the stream of fds 0-2 was opened for a redirection
+    FILE *captured[3] = {NULL, NULL, NULL}; // The buffers holding the output for the callback of the context
+    int result = 1;
+
+    for(int i=STDOUT_FILENO; i<=STDERR_FILENO && current_shell->output!=NULL; i++){ // Builtins write into memory, which is delivered when they finish
+        int fd = memfd_create("tinyshell-output", MFD_CLOEXEC);
+        captured[i] = fd>=0 ? fdopen(fd, "w+") : NULL;
+        if(captured[i]==NULL){
+            perror("Unable to capture output!"); // Outputting error message
+            if(fd>=0){
+                close(fd);
+            }
+            goto done;
+        }
+        streams[i] = captured[i];
+    }
+
+    for(struct redirection *r=command->redirections; r!=NULL; r=r->next){ // Applying the redirections of fds 0-2 to the streams, in order
+        if(r->fd>STDERR_FILENO){
+            continue;
+        }
+
+        FILE *stream;
+        bool shared = r->type==REDIRECT_DUP && r->source_fd<=STDERR_FILENO; // '2>&1' shares the stream of the source
+        if(shared){
+            stream = streams[r->source_fd];
+        }else{
+            int fd = r->type==REDIRECT_DUP ? fcntl(r->source_fd, F_DUPFD_CLOEXEC, 3) : open(r->target, redirection_flags(r->type) | O_CLOEXEC, 0666);
+            stream = fd>=0 ? fdopen(fd, r->fd==STDIN_FILENO ? "r" : "a") : NULL;
+            if(stream==NULL){
+                perror(redirection_error(r)); // Outputting error message
+                if(fd>=0){
+                    close(fd);
+                }
+                goto done;
+            }
+        }
+
+        if(opened[r->fd]){ // The stream being replaced is closed, unless another descriptor still shares it
+            bool inUse = false;
+            for(int i=0; i<3; i++){
+                if(i!=r->fd && streams[i]==streams[r->fd]){
+                    inUse = true;
+                    opened[i] = true;
+                }
+            }
+            if(!inUse && streams[r->fd]!=stream){
+                fclose(streams[r->fd]);
+            }
+        }
+        streams[r->fd] = stream;
+        opened[r->fd] = shared ? opened[r->source_fd] : true;
+    }
+
+    struct builtin_io io = {streams[STDIN_FILENO], streams[STDOUT_FILENO], streams[STDERR_FILENO]};
+    result = builtin->method(command->argv, &io); // Executing the associated method
+
+done:
+    for(int i=0; i<3; i++){ // Closing the redirected files, once each
+        bool first = true;
+        for(int j=0; j<i; j++){
+            first = first && !(opened[j] && streams[j]==streams[i]);
+        }
+        if(opened[i] && first){
+            fclose(streams[i]);
+        }
+    }
+    for(int i=STDOUT_FILENO; i<=STDERR_FILENO; i++){ // Passing the captured output to the callback
+        if(captured[i]!=NULL){
+            fflush(captured[i]);
+            if(lseek(fileno(captured[i]), 0, SEEK_SET)==0){
+                deliver_output(fileno(captured[i]), i);
+            }
+            fclose(captured[i]);
+        }
+    }
+    fflush(stdout); // Keeping the shell's own output ordered with anything written through a shared descriptor
+    fflush(stderr);
+    return result;
+}
+
+#define ARENA_BLOCK_SIZE 65536 // The minimum size of an arena block
+
+void *arena_alloc(struct arena *arena, size_t size){ // Creating a function to allocate memory from an arena
+
+    size = (size + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1); // Keeping every allocation aligned
+
+    while(arena->current!=NULL && arena->current->size - arena->current->used < size){ // Moving on to a later block with enough room
+        arena->current = arena->current->next;
+    }
+
+    if(arena->current==NULL){ // Every block is full, so a new one is added at the front
+        size_t blockSize = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        struct arena_block *block = malloc(sizeof(struct arena_block) + blockSize);
+        if(block==NULL){
+            perror("Unable to allocate memory!"); // Outputting error message
+            exit(EXIT_FAILURE);
+        }
+        block->size = blockSize;
+        block->used = 0;
+        block->next = arena->head;
+        arena->head = block;
+        arena->current = block;
+    }
+
+    void *memory = arena->current->data + arena->current->used;
+    arena->current->used += size;
+    return memory;
+}
+
+char *arena_strndup(struct arena *arena, const char *string, size_t length){ // Creating a function to copy a string into an arena
+
+    char *copy = arena_alloc(arena, length + 1);
+    memcpy(copy, string, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+void arena_reset(struct arena *arena){ // Creating a function to release everything allocated from an arena, keeping its blocks
+
+    for(struct arena_block *block=arena->head; block!=NULL; block=block->next){
+        block->used = 0;
+    }
+    arena->current = arena->head;
+}
+
+enum char_class{ // Defining the classes of characters seen by the lexer
+    CHAR_WORD, // Part of a word
+    CHAR_BLANK, // Separates words
+    CHAR_END, // End of the line
+    CHAR_PIPE, // '|'
+    CHAR_LESS, // '<'
+    CHAR_GREAT, // '>'
+    CHAR_AMP, // '&'
+    CHAR_SEMICOLON, // ';'
+    CHAR_SQUOTE, // '\'', starting a single quoted string
+    CHAR_DQUOTE, // '"', starting a double quoted string
+    CHAR_ESCAPE, // '\\', quoting the next character
+    CHAR_COMMENT, // '#', starting a comment at the beginning of a word
+    CHAR_GLOB, // '*', '?' and '[', making a word a pattern unless they are quoted
+    CHAR_DOLLAR, // '$', starting a variable reference unless it is quoted
+    CHAR_RESERVED // Metacharacters which are not supported (yet)
+};
+
+const unsigned char char_classes[256] = { // Mapping every byte to its class, anything not listed is part of a word
+    ['\0'] = CHAR_END, ['\n'] = CHAR_END,
+    [' '] = CHAR_BLANK, ['\t'] = CHAR_BLANK, ['\r'] = CHAR_BLANK,
+    ['|'] = CHAR_PIPE, ['<'] = CHAR_LESS, ['>'] = CHAR_GREAT,
+    ['\''] = CHAR_SQUOTE, ['"'] = CHAR_DQUOTE, ['\\'] = CHAR_ESCAPE, ['#'] = CHAR_COMMENT,
+    ['&'] = CHAR_AMP, [';'] = CHAR_SEMICOLON, ['('] = CHAR_RESERVED, [')'] = CHAR_RESERVED,
+    ['$'] = CHAR_DOLLAR, ['`'] = CHAR_RESERVED, ['*'] = CHAR_GLOB, ['?'] = CHAR_GLOB, ['['] = CHAR_GLOB
+};
+
+enum token_type{ // Defining the tokens produced by the lexer
+    TOKEN_WORD, // A word, stored in 'parser.text'
+    TOKEN_PIPE, // '|'
+    TOKEN_IN, // '<'
+    TOKEN_OUT, // '>'
+    TOKEN_APPEND, // '>>'
+    TOKEN_DUP_IN, // '<&'
+    TOKEN_DUP_OUT, // '>&'
+    TOKEN_OUT_ALL, // '&>', redirecting both stdout and stderr
+    TOKEN_APPEND_ALL, // '&>>'
+    TOKEN_HEREDOC, // '<<', reading the following lines up to a delimiter
+    TOKEN_HEREDOC_STRIP, // '<<-', which also removes leading tabs from those lines
+    TOKEN_HERESTRING, // '<<<', reading a word followed by a newline
+    TOKEN_BACKGROUND, // '&', which also ends a pipeline of a command list
+    TOKEN_SEMICOLON, // ';'
+    TOKEN_AND, // '&&'
+    TOKEN_OR, // '||'
+    TOKEN_END, // End of the line
+    TOKEN_ERROR // A lexical error, which has already been reported
+};
+
+
+void parse_error(const struct parser *p, const char *format, ...){ // Creating a function to report a syntax error, unless the parser is compiling a script whose errors are reported when they are reached
+
+    if(p->quiet){
+        return;
+    }
+    va_list arguments;
+    va_start(arguments, format);
+    fputs("Error: ", stderr);
+    vfprintf(stderr, format, arguments);
+    va_end(arguments);
+}
+
+void *grow_scratch(void *buffer, size_t *capacity, size_t needed, size_t element){ // Creating a function to grow a scratch buffer of the parser
+
+    if(needed<=*capacity){
+        return buffer;
+    }
+    size_t newCapacity = *capacity>0 ? *capacity : 16;
+    while(newCapacity<needed){
+        newCapacity *= 2;
+    }
+    void *grown = realloc(buffer, newCapacity * element);
+    if(grown==NULL){
+        perror("Unable to allocate memory!"); // Outputting error message
+        exit(EXIT_FAILURE);
+    }
+    *capacity = newCapacity;
+    return grown;
+}
+
+void glob_unescape(char *pattern){ // Creating a function to turn a pattern back into the word it was lexed from, removing the escapes in place
+
+    char *out = pattern;
+    for(const char *c=pattern; *c!='\0'; c++){
+        if(*c=='\\' && c[1]!='\0'){
+            c++;
+        }
+        *out++ = *c;
+    }
+    *out = '\0';
+}
+
+void lex_literal(struct parser *p, size_t *length, size_t *patternLength, char c){ // Creating a function to add a quoted or escaped character to a word, escaping it in the pattern form of the word
+
+    p->word[(*length)++] = c;
+    if(char_classes[(unsigned char)c]==CHAR_GLOB || c=='\\' || c==']' || c=='$'){
+        p->pattern[(*patternLength)++] = '\\';
+    }
+    p->pattern[(*patternLength)++] = c;
+}
+
+int lex_substitution(struct parser *p, const char **c, size_t *patternLength){ // Creating a function to lex '$(command)' into the pattern form of a word, as '$(<length>:command)', returning 1 or -1 on an error
+
+    const char *command = *c + 2;
+    const char *end = command;
+    int depth = 1;
+    while(*end!='\0'){ // Finding the closing parenthesis, skipping quoted text and nested parentheses
+        if(*end=='\\' && end[1]!='\0'){
+            end++;
+        }else if(*end=='\'' || *end=='"'){
+            const char *quote = strchr(end + 1, *end);
+            if(quote==NULL){
+                break;
+            }
+            end = quote;
+        }else if(*end=='('){
+            depth++;
+        }else if(*end==')' && --depth==0){
+            break;
+        }
+        end++;
+    }
+    if(*end!=')'){
+        parse_error(p, "Missing closing ')' of '$('\n"); // Output error message
+        return -1;
+    }
+    size_t length = end - command;
+    p->pattern = grow_scratch(p->pattern, &p->pattern_capacity, *patternLength + length + 32, 1); // The length takes more room than '$()'
+    *patternLength += sprintf(p->pattern + *patternLength, "$(%zu:", length);
+    memcpy(p->pattern + *patternLength, command, length);
+    *patternLength += length;
+    p->pattern[(*patternLength)++] = ')';
+    *c = end + 1;
+    return 1;
+}
+
+int lex_variable(struct parser *p, const char **c, size_t *patternLength){ // Creating a function to lex '$NAME', '${NAME}', '$?', '$$' or '$(command)' into the pattern form of a word, returning 1, 0 when '$' is literal, or -1 on an error
+
+    if((*c)[1]=='('){
+        return lex_substitution(p, c, patternLength);
+    }
+    const char *name = *c + 1;
+    bool braces = *name=='{';
+    name += braces;
+    size_t length = 0;
+    if(*name=='?' || *name=='$'){ // The status of the last command line and the process ID of the shell
+        length = 1;
+    }else if(!isdigit((unsigned char)*name)){ // '$1' would be a positional parameter, which the shell does not have
+        while(isalnum((unsigned char)name[length]) || name[length]=='_'){
+            length++;
+        }
+    }
+    if(braces && (length==0 || name[length]!='}')){
+        parse_error(p, "Bad substitution\n"); // Output error message
+        return -1;
+    }
+    if(length==0){ // Anything else after '$' is taken literally
+        return 0;
+    }
+    p->pattern[(*patternLength)++] = '$';
+    p->pattern[(*patternLength)++] = '{';
+    memcpy(p->pattern + *patternLength, name, length);
+    *patternLength += length;
+    p->pattern[(*patternLength)++] = '}';
+    *c = name + length + braces;
+    return 1;
+}
+
+enum token_type lex_word(struct parser *p){ // Creating a function to lex a word, removing quotes and escapes in the same pass
+
+    size_t length = 0; // The number of bytes written to 'p->word'
+    size_t patternLength = 0; // The number of bytes written to 'p->pattern', the word with its quoted metacharacters escaped
+    bool glob = false; // Whether an unquoted '*', '?' or '[...]' was seen
+    bool bracket = false; // Whether an unquoted '[' is waiting for its ']'
+    unsigned char flags = 0; // WORD_VARIABLE and WORD_QUOTED, as they are seen
+    const char *c = p->input + p->pos;
+    size_t remaining = strlen(c);
+
+    p->word = grow_scratch(p->word, &p->word_capacity, remaining + 1, 1); // A word is never longer than the rest of the line
+    p->pattern = grow_scratch(p->pattern, &p->pattern_capacity, 2 * remaining + 1, 1); // Nor its pattern longer than twice that
+
+    while(true){
+        switch(char_classes[(unsigned char)*c]){
+
+            case CHAR_WORD:
+            case CHAR_COMMENT: // '#' inside a word is an ordinary character
+                glob = glob || (bracket && *c==']');
+                p->pattern[patternLength++] = *c;
+                p->word[length++] = *c++;
+                break;
+
+            case CHAR_GLOB: // Unquoted, these make the word a pattern
+                glob = glob || *c!='[';
+                bracket = bracket || *c=='[';
+                p->pattern[patternLength++] = *c;
+                p->word[length++] = *c++;
+                break;
+
+            case CHAR_DOLLAR: // Variables are expanded when the command line is executed
+                switch(lex_variable(p, &c, &patternLength)){
+                    case 1:
+                        flags |= WORD_VARIABLE;
+                        break;
+                    case 0:
+                        lex_literal(p, &length, &patternLength, *c++);
+                        break;
+                    default:
+                        return TOKEN_ERROR;
+                }
+                break;
+
+            case CHAR_ESCAPE: // The next character is taken literally
+                flags |= WORD_QUOTED;
+                c++;
+                if(*c=='\0'){ // A trailing backslash stands for itself
+                    lex_literal(p, &length, &patternLength, '\\');
+                }else{
+                    lex_literal(p, &length, &patternLength, *c++);
+                }
+                break;
+
+            case CHAR_SQUOTE: // Everything up to the closing quote is taken literally
+                flags |= WORD_QUOTED;
+                c++;
+                while(*c!='\'' && *c!='\0'){
+                    lex_literal(p, &length, &patternLength, *c++);
+                }
+                if(*c=='\0'){
+                    parse_error(p, "Missing closing single quote\n"); // Output error message
+                    return TOKEN_ERROR;
+                }
+                c++;
+                break;
+
+            case CHAR_DQUOTE: // Backslash only escapes '"', '\\', '$' and '`' inside double quotes, where variables are still expanded
+                flags |= WORD_QUOTED;
+                c++;
+                while(*c!='"' && *c!='\0'){
+                    if(*c=='$'){
+                        int variable = lex_variable(p, &c, &patternLength);
+                        if(variable<0){
+                            return TOKEN_ERROR;
+                        }else if(variable>0){
+                            flags |= WORD_VARIABLE;
+                            continue;
+                        }
+                    }else if(*c=='\\' && (c[1]=='"' || c[1]=='\\' || c[1]=='$' || c[1]=='`')){
+                        c++;
+                    }
+                    lex_literal(p, &length, &patternLength, *c++);
+                }
+                if(*c=='\0'){
+                    parse_error(p, "Missing closing double quote\n"); // Output error message
+                    return TOKEN_ERROR;
+                }
+                c++;
+                break;
+
+            case CHAR_RESERVED:
+                parse_error(p, "'%c' is not supported, quote it to use it literally.\n", *c); // Output error message
+                return TOKEN_ERROR;
+
+            default: // A blank, an operator or the end of the line finishes the word
+                p->word_flags = (glob ? WORD_GLOB : 0) | ((flags & WORD_VARIABLE) ? flags : 0);
+                p->word_quoted = flags & WORD_QUOTED;
+                p->text = p->word_flags!=0 ? arena_strndup(&p->arena, p->pattern, patternLength) : arena_strndup(&p->arena, p->word, length); // Patterns and variables are kept escaped until they are expanded
+                p->pos = c - p->input;
+                return TOKEN_WORD;
+        }
+    }
+}
+
+enum token_type next_token(struct parser *p){ // Creating a function to obtain the next token of the line
+
+    const char *c = p->input + p->pos;
+
+    while(char_classes[(unsigned char)*c]==CHAR_BLANK){ // Skipping blanks between tokens
+        c++;
+    }
+    p->pos = c - p->input;
+    p->token_start = p->pos;
+    p->io_number = -1;
+
+    if(isdigit((unsigned char)*c)){ // Digits right before '<' or '>' name the descriptor being redirected
+        const char *digits = c;
+        int fd = 0;
+        while(isdigit((unsigned char)*digits) && fd<=9999){
+            fd = fd*10 + (*digits++ - '0');
+        }
+        if((*digits=='<' || *digits=='>') && fd<=9999){
+            p->io_number = fd;
+            c = digits;
+            p->pos = c - p->input;
+        }
+    }
+
+    switch(char_classes[(unsigned char)*c]){
+        case CHAR_END:
+            return TOKEN_END;
+        case CHAR_COMMENT: // A comment runs until the end of the line
+            p->pos += strcspn(c, "\n");
+            return TOKEN_END;
+        case CHAR_PIPE:
+            if(c[1]=='|'){
+                p->pos += 2;
+                return TOKEN_OR;
+            }
+            p->pos++;
+            return TOKEN_PIPE;
+        case CHAR_SEMICOLON:
+            p->pos++;
+            return TOKEN_SEMICOLON;
+        case CHAR_LESS:
+            if(c[1]=='<'){
+                if(c[2]=='<' || c[2]=='-'){
+                    p->pos += 3;
+                    return c[2]=='<' ? TOKEN_HERESTRING : TOKEN_HEREDOC_STRIP;
+                }
+                p->pos += 2;
+                return TOKEN_HEREDOC;
+            }
+            if(c[1]=='&'){
+                p->pos += 2;
+                return TOKEN_DUP_IN;
+            }
+            p->pos++;
+            return TOKEN_IN;
+        case CHAR_AMP:
+            if(c[1]=='>'){
+                if(c[2]=='>'){
+                    p->pos += 3;
+                    return TOKEN_APPEND_ALL;
+                }
+                p->pos += 2;
+                return TOKEN_OUT_ALL;
+            }
+            if(c[1]=='&'){
+                p->pos += 2;
+                return TOKEN_AND;
+            }
+            p->pos++;
+            return TOKEN_BACKGROUND;
+        case CHAR_GREAT:
+            if(c[1]=='>'){
+                p->pos += 2;
+                return TOKEN_APPEND;
+            }
+            if(c[1]=='&'){
+                p->pos += 2;
+                return TOKEN_DUP_OUT;
+            }
+            p->pos++;
+            return TOKEN_OUT;
+        default:
+            return lex_word(p);
+    }
+}
+
+struct heredoc{ // Defining the structure for a here-document whose lines are still to be read
+    struct redirection *redirection; // The redirection receiving the text
+    const char *delimiter; // The line ending the text
+    bool strip; // Whether leading tabs are removed, for '<<-'
+    bool expand; // Whether variables and commands are expanded, when the delimiter was not quoted
+    struct heredoc *next;
+};
+
+char *heredoc_next_line(struct parser *p){ // Creating a function to read a line of a here-document, from the rest of the text being parsed and then from 'next_line'
+
+    const char *rest = p->input + p->pos;
+    if(*rest=='\n'){ // The text holds more lines, as with 'tinyshell_run'
+        rest++;
+        size_t length = strcspn(rest, "\n");
+        p->pos = rest + length - p->input;
+        return arena_strndup(&p->arena, rest, length);
+    }
+    return p->next_line!=NULL ? p->next_line(p->next_line_data) : NULL;
+}
+
+bool read_heredoc(struct parser *p, struct heredoc *h){ // Creating a function to read the lines of a here-document up to its delimiter, keeping variables to be expanded on every execution
+
+    size_t length = 0;
+    while(true){
+        char *line = heredoc_next_line(p);
+        if(line==NULL){
+            parse_error(p, "Here-document ended by the end of input instead of '%s'\n", h->delimiter); // Output error message
+            return false;
+        }
+        if(h->strip){
+            line += strspn(line, "\t");
+        }
+        if(strcmp(line, h->delimiter)==0){
+            break;
+        }
+        size_t lineLength = strlen(line);
+        p->pattern = grow_scratch(p->pattern, &p->pattern_capacity, length + 2 * lineLength + 2, 1);
+        if(!h->expand){ // Taken literally
+            memcpy(p->pattern + length, line, lineLength);
+            length += lineLength;
+        }else{ // As inside double quotes, but '"' is an ordinary character
+            for(const char *c=line; *c!='\0'; ){
+                if(*c=='$'){
+                    int variable = lex_variable(p, &c, &length);
+                    if(variable<0){
+                        return false;
+                    }else if(variable>0){
+                        continue;
+                    }
+                }else if(*c=='\\' && (c[1]=='\\' || c[1]=='$' || c[1]=='`')){
+                    c++;
+                }
+                if(*c=='\\' || *c=='$'){
+                    p->pattern[length++] = '\\';
+                }
+                p->pattern[length++] = *c++;
+            }
+        }
+        p->pattern[length++] = '\n';
+    }
+    h->redirection->target = arena_strndup(&p->arena, p->pattern, length);
+    h->redirection->target_flags = h->expand ? WORD_VARIABLE : 0;
+    return true;
+}
+
+struct shell_pipeline *new_pipeline(struct parser *p){ // Creating a function to allocate an empty pipeline from the arena of a parser
+
+    struct shell_pipeline *pipeline = arena_alloc(&p->arena, sizeof(struct shell_pipeline));
+    pipeline->stages = NULL;
+    pipeline->stage_count = 0;
+    pipeline->background = false;
+    pipeline->text = NULL;
+    pipeline->pipe_size = 0;
+    pipeline->timed = false;
+    pipeline->time_json = false;
+    pipeline->batch = false;
+    pipeline->spread = false;
+    pipeline->memo = NULL;
+    pipeline->watch = NULL;
+    pipeline->then = LIST_SEQUENCE;
+    pipeline->next = NULL;
+    return pipeline;
+}
+
+struct shell_pipeline *parse_command_line(struct parser *p, const char *line){ // Creating a function to parse a line into a command list, returning its first pipeline, or NULL on a syntax error
+
+    arena_reset(&p->arena); // Releasing the previous command line
+    p->input = line;
+    p->pos = 0;
+
+    struct shell_pipeline *first = new_pipeline(p);
+    struct shell_pipeline *pipeline = first; // The pipeline being parsed
+    struct shell_pipeline *previous = NULL; // The pipeline before it in the list
+    size_t pipelineStart = 0; // The offset of the text of the pipeline being parsed
+    size_t stageCount = 0;
+    size_t wordCount = 0;
+    bool expand = false; // Whether a word of the current stage is a pattern
+    struct heredoc *heredocs = NULL; // The here-documents whose lines follow the line, in order
+    struct heredoc **lastHeredoc = &heredocs;
+    struct redirection *redirections = NULL; // The redirections of the current stage
+    struct redirection **lastRedirection = &redirections; // Where the next redirection is linked, keeping them in order
+
+    while(true){
+        enum token_type token = next_token(p);
+
+        if(token==TOKEN_ERROR){
+            return NULL;
+
+        }else if(token==TOKEN_WORD){ // Adding the word to the current stage
+            p->words = grow_scratch(p->words, &p->words_capacity, wordCount + 1, sizeof(char*));
+            p->flags = grow_scratch(p->flags, &p->flags_capacity, wordCount + 1, 1);
+            p->flags[wordCount] = p->word_flags;
+            p->words[wordCount++] = p->text;
+            expand = expand || p->word_flags!=0;
+
+        }else if(token>=TOKEN_IN && token<=TOKEN_HERESTRING){ // A redirection has to be followed by a file name
+
+            int fd = p->io_number>=0 ? p->io_number : (token==TOKEN_IN || token==TOKEN_DUP_IN || token>=TOKEN_HEREDOC ? STDIN_FILENO : STDOUT_FILENO);
+
+            if(next_token(p)!=TOKEN_WORD){
+                if(token==TOKEN_IN){
+                    parse_error(p, "Input redirection operator should always be followed by a valid filename.\n"); // Output error message
+                }else if(token==TOKEN_OUT || token==TOKEN_OUT_ALL){
+                    parse_error(p, "Output redirection operator should always be followed by a valid filename.\n"); // Output error message
+                }else if(token==TOKEN_APPEND || token==TOKEN_APPEND_ALL){
+                    parse_error(p, "Append output redirection operator should always be followed by a valid filename.\n"); // Output error message
+                }else if(token==TOKEN_HERESTRING){
+                    parse_error(p, "Here-string operator should always be followed by a word.\n"); // Output error message
+                }else if(token>=TOKEN_HEREDOC){
+                    parse_error(p, "Here-document operator should always be followed by a delimiter.\n"); // Output error message
+                }else{
+                    parse_error(p, "Duplication operator should always be followed by a file descriptor.\n"); // Output error message
+                }
+                return NULL;
+            }
+
+            unsigned char targetFlags = p->word_flags & WORD_VARIABLE; // File names are not matched against files, but their variables are expanded
+            if(p->word_flags!=0 && targetFlags==0){
+                glob_unescape(p->text);
+            }
+            expand = expand || targetFlags!=0;
+            char *end;
+            long source = strtol(p->text, &end, 10);
+            if(token==TOKEN_DUP_OUT && p->io_number<0 && (*end!='\0' || !isdigit((unsigned char)p->text[0]))){ // '>&file' is another spelling of '&>file'
+                token = TOKEN_OUT_ALL;
+            }else if((token==TOKEN_DUP_IN || token==TOKEN_DUP_OUT) && (*end!='\0' || !isdigit((unsigned char)p->text[0]) || source>9999)){
+                parse_error(p, "Duplication operator should always be followed by a file descriptor.\n"); // Output error message
+                return NULL;
+            }
+
+            struct redirection *r = arena_alloc(&p->arena, sizeof(struct redirection));
+            r->type = token==TOKEN_IN ? REDIRECT_IN : (token==TOKEN_OUT || token==TOKEN_OUT_ALL ? REDIRECT_OUT : (token==TOKEN_APPEND || token==TOKEN_APPEND_ALL ? REDIRECT_APPEND : (token>=TOKEN_HEREDOC ? REDIRECT_HEREDOC : REDIRECT_DUP)));
+            r->fd = fd;
+            r->target = p->text;
+            r->source_fd = (int)source;
+            r->next = NULL;
+            r->target_flags = targetFlags;
+            if(token==TOKEN_HERESTRING){ // The word is read as a line
+                size_t length = strlen(p->text);
+                r->target = arena_alloc(&p->arena, length + 2);
+                memcpy(r->target, p->text, length);
+                memcpy(r->target + length, "\n", 2);
+                expand = true;
+            }else if(token>=TOKEN_HEREDOC){ // The text is read once the line is parsed
+                struct heredoc *h = arena_alloc(&p->arena, sizeof(struct heredoc));
+                h->redirection = r;
+                h->delimiter = r->target;
+                h->strip = token==TOKEN_HEREDOC_STRIP;
+                h->expand = !p->word_quoted;
+                h->next = NULL;
+                *lastHeredoc = h;
+                lastHeredoc = &h->next;
+                expand = true;
+            }
+            *lastRedirection = r;
+            lastRedirection = &r->next;
+
+            if(token==TOKEN_OUT_ALL || token==TOKEN_APPEND_ALL){ // '&>file' is '>file 2>&1'
+                struct redirection *error = arena_alloc(&p->arena, sizeof(struct redirection));
+                error->type = REDIRECT_DUP;
+                error->fd = STDERR_FILENO;
+                error->target = NULL;
+                error->source_fd = STDOUT_FILENO;
+                error->next = NULL;
+                error->target_flags = 0;
+                *lastRedirection = error;
+                lastRedirection = &error->next;
+            }
+
+        }else{ // A '|', a list operator or the end of the line finishes the current stage
+
+            if(wordCount==0 && !(token!=TOKEN_PIPE && stageCount==0 && redirections!=NULL)){ // A pipeline of redirections alone, such as '< a > b', is still a command
+                if(token==TOKEN_END && stageCount==0 && (previous==NULL || previous->then==LIST_SEQUENCE)){ // An empty line, or a list ending with ';' or '&'
+                    break;
+                }else if(redirections!=NULL){
+                    parse_error(p, "Redirection operators should always be applied to a command.\n"); // Output error message
+                }else if(token==TOKEN_PIPE || stageCount>0){
+                    parse_error(p, "Pipeline operator cannot appear as the first or last token in a sequence.\n"); // Output error message
+                }else{
+                    parse_error(p, "List operators should always be placed between two pipelines.\n"); // Output error message
+                }
+                return NULL;
+            }
+
+            p->stages = grow_scratch(p->stages, &p->stages_capacity, stageCount + 1, sizeof(struct shell_command));
+            struct shell_command *command = &p->stages[stageCount++];
+            command->argv = arena_alloc(&p->arena, (wordCount + 1) * sizeof(char*)); // Copying the words, with no fixed limit
+            memcpy(command->argv, p->words, wordCount * sizeof(char*));
+            command->argv[wordCount] = NULL;
+            command->argc = wordCount;
+            command->redirections = redirections;
+            command->word_flags = NULL;
+            command->sched = NULL;
+            if(expand){ // Stages without patterns need no copy when they are executed
+                command->word_flags = arena_alloc(&p->arena, wordCount);
+                memcpy(command->word_flags, p->flags, wordCount);
+            }
+
+            wordCount = 0;
+            expand = false;
+            redirections = NULL;
+            lastRedirection = &redirections;
+
+            if(token!=TOKEN_PIPE){ // The pipeline is complete
+                size_t textEnd = p->token_start; // Keeping the text of the pipeline, without the operator, for 'jobs'
+                while(textEnd>pipelineStart && (line[textEnd-1]==' ' || line[textEnd-1]=='\t')){
+                    textEnd--;
+                }
+                pipeline->text = arena_strndup(&p->arena, line + pipelineStart, textEnd - pipelineStart);
+                pipeline->stage_count = stageCount;
+                pipeline->stages = arena_alloc(&p->arena, stageCount * sizeof(struct shell_command));
+                memcpy(pipeline->stages, p->stages, stageCount * sizeof(struct shell_command));
+                pipeline->background = token==TOKEN_BACKGROUND;
+                pipeline->then = token==TOKEN_AND ? LIST_AND : (token==TOKEN_OR ? LIST_OR : LIST_SEQUENCE);
+                if(token==TOKEN_END){
+                    break;
+                }
+                previous = pipeline;
+                pipeline = new_pipeline(p);
+                previous->next = pipeline;
+                pipelineStart = p->pos + strspn(line + p->pos, " \t");
+                stageCount = 0;
+            }
+        }
+    }
+
+    if(previous!=NULL && pipeline->stage_count==0){ // Dropping the empty pipeline after a trailing ';' or '&'
+        previous->next = NULL;
+    }
+
+    for(struct heredoc *h=heredocs; h!=NULL; h=h->next){ // Reading the here-documents, which may replace the buffer holding the line
+        if(!read_heredoc(p, h)){
+            return NULL;
+        }
+    }
+    return first;
+}
+
+#define LISTING_BUCKETS 256 // The number of buckets of the directory listing cache
+#define LISTING_BUFFER (1 << 20) // The size of the getdents64 buffer, so that a directory of 100k files takes a few calls
+
+struct dir_listing{ // Defining the structure for the entries of a directory, read once per command line
+    char *path; // The directory as written in the pattern, "" for the working directory
+    char *names; // The names of the entries, each ending with '\0'
+    size_t names_capacity;
+    size_t names_length;
+    size_t *offsets; // The offset of every name in 'names'
+    unsigned char *types; // The d_type of every entry, DT_UNKNOWN when the file system does not report it
+    size_t capacity;
+    size_t count;
+    struct dir_listing *next; // The next listing in the same bucket
+};
+
+struct listing_cache{ // Defining the structure of the directory listings read by the patterns of a command line
+    struct dir_listing *buckets[LISTING_BUCKETS];
+    unsigned long generation; // The command line the listings were read for, as in 'command_hash'
+    char *buffer; // The buffer of getdents64, kept across lines
+};
+
+struct listing_cache listing_cache = {{NULL}, 0, NULL}; // Shared by every context, like the command hash
+
+void listing_cache_clear(void){ // Creating a function to forget every directory listing
+
+    for(int i=0; i<LISTING_BUCKETS; i++){
+        struct dir_listing *listing = listing_cache.buckets[i];
+        while(listing!=NULL){
+            struct dir_listing *next = listing->next;
+            free(listing->path);
+            free(listing->names);
+            free(listing->offsets);
+            free(listing->types);
+            free(listing);
+            listing = next;
+        }
+        listing_cache.buckets[i] = NULL;
+    }
+}
+
+struct dir_listing *listing_read(const char *path){ // Creating a function to list a directory with getdents64, once per command line, or NULL if it cannot be read
+
+    if(listing_cache.generation!=command_hash.generation){ // Listings are only reused within a command line, so new files are always seen
+        listing_cache_clear();
+        listing_cache.generation = command_hash.generation;
+    }
+    struct dir_listing **bucket = &listing_cache.buckets[hash_string(path) % LISTING_BUCKETS];
+    for(struct dir_listing *listing=*bucket; listing!=NULL; listing=listing->next){
+        if(strcmp(listing->path, path)==0){
+            return listing->count!=(size_t)-1 ? listing : NULL;
+        }
+    }
+
+    struct dir_listing *listing = calloc(1, sizeof(struct dir_listing));
+    if(listing==NULL || (listing->path = strdup(path))==NULL){
+        free(listing);
+        return NULL;
+    }
+    listing->next = *bucket;
+    *bucket = listing;
+
+    int fd = open(path[0]!='\0' ? path : ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(listing_cache.buffer==NULL){
+        listing_cache.buffer = malloc(LISTING_BUFFER);
+    }
+    if(fd==-1 || listing_cache.buffer==NULL){ // Remembering that the directory cannot be read
+        if(fd!=-1){
+            close(fd);
+        }
+        listing->count = (size_t)-1;
+        return NULL;
+    }
+
+    ssize_t read;
+    while((read = getdents64(fd, listing_cache.buffer, LISTING_BUFFER))>0){ // Reading many entries per system call, with their types
+        for(ssize_t offset=0; offset<read; ){
+            struct dirent64 *entry = (struct dirent64*)(listing_cache.buffer + offset);
+            offset += entry->d_reclen;
+            if(entry->d_name[0]=='.' && (entry->d_name[1]=='\0' || (entry->d_name[1]=='.' && entry->d_name[2]=='\0'))){
+                continue;
+            }
+            size_t length = strlen(entry->d_name) + 1;
+            listing->names = grow_scratch(listing->names, &listing->names_capacity, listing->names_length + length, 1);
+            size_t capacity = listing->capacity;
+            listing->offsets = grow_scratch(listing->offsets, &listing->capacity, listing->count + 1, sizeof(size_t));
+            listing->types = grow_scratch(listing->types, &capacity, listing->count + 1, 1);
+            memcpy(listing->names + listing->names_length, entry->d_name, length);
+            listing->offsets[listing->count] = listing->names_length;
+            listing->types[listing->count++] = entry->d_type;
+            listing->names_length += length;
+        }
+    }
+    close(fd);
+    return listing;
+}
+
+bool listing_is_dir(const char *path, unsigned char type, bool follow){ // Creating a function to check whether an entry is a directory, calling stat only when its type is not known
+
+    if(type==DT_DIR){
+        return true;
+    }else if(type!=DT_UNKNOWN && (type!=DT_LNK || !follow)){
+        return false;
+    }
+    struct stat info;
+    return (follow ? stat(path, &info) : lstat(path, &info))==0 && S_ISDIR(info.st_mode);
+}
+
+struct glob_state{ // Defining the state of the expansion of the patterns of a stage
+    char **matches; // The arguments of the stage so far
+    size_t count;
+    size_t capacity;
+    char path[PATH_MAX]; // The path being built by the walk
+};
+
+void glob_add(struct glob_state *g, char *argument){ // Creating a function to add an argument to the expanded stage
+    g->matches = grow_scratch(g->matches, &g->capacity, g->count + 1, sizeof(char*));
+    g->matches[g->count++] = argument;
+}
+
+bool glob_has_meta(const char *component){ // Creating a function to check whether a path component of a pattern has unescaped metacharacters
+    for(const char *c=component; *c!='\0'; c++){
+        if(*c=='\\' && c[1]!='\0'){
+            c++;
+        }else if(*c=='*' || *c=='?' || *c=='['){
+            return true;
+        }
+    }
+    return false;
+}
+
+void glob_walk(struct glob_state *g, size_t pathLength, const char *pattern){ // Creating a function to match the rest of a pattern below the directory in 'g->path'
+
+    if(*pattern=='\0'){ // A pattern ending with '/' only matches directories, which the caller checked
+        glob_add(g, arena_strndup(&current_shell->expansion, g->path, pathLength));
+        return;
+    }
+    const char *slash = strchr(pattern, '/');
+    size_t componentLength = slash!=NULL ? (size_t)(slash - pattern) : strlen(pattern);
+    const char *rest = slash; // What follows the component, NULL for the last one
+    if(rest!=NULL){
+        while(rest[1]=='/'){
+            rest++;
+        }
+        rest++;
+    }
+    char component[NAME_MAX * 2 + 2]; // Escapes can double the length of a name
+    if(componentLength>=sizeof(component)){
+        return;
+    }
+    memcpy(component, pattern, componentLength);
+    component[componentLength] = '\0';
+
+    if(!glob_has_meta(component)){ // A plain component is looked up instead of matched against the whole directory
+        glob_unescape(component);
+        size_t length = pathLength + strlen(component);
+        if(length + 2>=sizeof(g->path)){
+            return;
+        }
+        memcpy(g->path + pathLength, component, length - pathLength + 1);
+        struct stat info;
+        if(rest==NULL){
+            if(lstat(g->path, &info)==0){
+                glob_add(g, arena_strndup(&current_shell->expansion, g->path, length));
+            }
+        }else if(*rest!='\0' || (stat(g->path, &info)==0 && S_ISDIR(info.st_mode))){
+            g->path[length] = '/';
+            glob_walk(g, length + 1, rest);
+        }
+        return;
+    }
+
+    g->path[pathLength] = '\0';
+    struct dir_listing *listing = listing_read(g->path);
+    if(listing==NULL){
+        return;
+    }
+    bool recursive = strcmp(component, "**")==0; // '**' matches any number of directories, itself included
+    if(recursive && rest!=NULL){ // Matching no directory at all
+        glob_walk(g, pathLength, rest);
+    }
+    for(size_t i=0; i<listing->count; i++){
+        const char *name = listing->names + listing->offsets[i];
+        if(recursive ? name[0]=='.' : fnmatch(component, name, FNM_PERIOD)!=0){ // Hidden files are only matched by patterns starting with '.'
+            continue;
+        }
+        size_t length = pathLength + strlen(name);
+        if(length + 2>=sizeof(g->path)){
+            continue;
+        }
+        memcpy(g->path + pathLength, name, length - pathLength + 1);
+        if(rest==NULL){
+            glob_add(g, arena_strndup(&current_shell->expansion, g->path, length));
+        }
+        if(recursive ? listing_is_dir(g->path, listing->types[i], false) : rest!=NULL && listing_is_dir(g->path, listing->types[i], true)){ // '**' does not follow symbolic links, so it cannot loop
+            g->path[length] = '/';
+            glob_walk(g, length + 1, recursive ? pattern : rest);
+        }
+    }
+}
+
+void glob_expand(struct glob_state *g, const char *pattern){ // Creating a function to replace a pattern with the sorted paths matching it, or with itself when nothing matches
+
+    size_t first = g->count;
+    size_t pathLength = 0;
+    if(pattern[0]=='/'){ // Absolute patterns are walked from the root
+        g->path[pathLength++] = '/';
+        while(*pattern=='/'){
+            pattern++;
+        }
+    }
+    glob_walk(g, pathLength, pattern);
+    if(g->count==first){
+        char *word = arena_strndup(&current_shell->expansion, pattern - pathLength, strlen(pattern) + pathLength);
+        glob_unescape(word);
+        glob_add(g, word);
+    }else{
+        qsort(g->matches + first, g->count - first, sizeof(char*), compare_strings);
+    }
+}
+
+char *command_output(const char *command, size_t length, size_t *outputLength){ // Creating a function to run a command line in a forked copy of the shell and read its output into memory, without trailing newlines
+
+    int fds[2];
+    if(pipe2(fds, O_CLOEXEC)==-1){
+        perror("Cannot create pipe!"); // Outputting error message
+        return NULL;
+    }
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if(pid==-1){
+        perror("Unable to create new process!"); // Outputting error message
+        close(fds[0]);
+        close(fds[1]);
+        return NULL;
+    }
+
+    if(pid==0){ // The copy runs the command line as the shell would, builtins included, but cannot change the shell
+        close(fds[0]);
+        if(dup2(fds[1], STDOUT_FILENO)==-1){
+            _exit(1);
+        }
+        close(fds[1]);
+        jobs_forget(); // Jobs started by the command line belong to this process
+        job_control = false;
+        current_shell->output = NULL;
+        current_shell->status = NULL;
+        current_shell->detach = false;
+        char *line = strndup(command, length);
+        struct parser parser = {0}; // The parser of the shell still holds the command line being expanded
+        struct shell_pipeline *pipeline = line!=NULL ? prepare_pipeline(&parser, line) : NULL;
+        int status = pipeline==NULL ? 2 : pipeline->stage_count>0 ? execute_list(pipeline) : 0;
+        fflush(stdout);
+        _exit(status);
+    }
+
+    close(fds[1]);
+    char *output = NULL;
+    size_t capacity = 0;
+    size_t used = 0;
+    while(true){ // Reading everything the command line wrote, in growing blocks
+        output = grow_scratch(output, &capacity, used + 65536, 1);
+        ssize_t bytes = read(fds[0], output + used, capacity - used);
+        if(bytes==-1 && errno==EINTR){
+            continue;
+        }
+        if(bytes<=0){
+            break;
+        }
+        used += bytes;
+    }
+    close(fds[0]);
+    int status;
+    while(waitpid(pid, &status, 0)==-1 && errno==EINTR){
+    }
+    while(used>0 && output[used-1]=='\n'){
+        used--;
+    }
+    *outputLength = used;
+    return output;
+}
+
+void expansion_append(char **buffer, size_t *capacity, size_t *length, const char *value, size_t valueLength, bool pattern){ // Creating a function to add the value of a variable or command to an expanded word, escaping it in patterns so that it is only matched literally
+
+    *buffer = grow_scratch(*buffer, capacity, *length + 2 * valueLength + 1, 1);
+    for(size_t i=0; i<valueLength; i++){
+        if(pattern && (char_classes[(unsigned char)value[i]]==CHAR_GLOB || value[i]=='\\' || value[i]==']')){
+            (*buffer)[(*length)++] = '\\';
+        }
+        (*buffer)[(*length)++] = value[i];
+    }
+}
+
+char *expand_variables(const char *word, unsigned char flags){ // Creating a function to replace the variables and commands of a word with their values, keeping it a pattern when it is one
+
+    if(!(flags & WORD_VARIABLE)){
+        return (char*)word;
+    }
+    bool pattern = flags & WORD_GLOB;
+    char *buffer = NULL;
+    size_t capacity = 0;
+    size_t length = 0;
+    for(const char *c=word; *c!='\0'; c++){
+        buffer = grow_scratch(buffer, &capacity, length + 3, 1);
+        if(*c=='\\' && c[1]!='\0'){
+            if(pattern){
+                buffer[length++] = '\\';
+            }
+            buffer[length++] = *++c;
+        }else if(*c=='$' && c[1]=='('){ // '$(<length>:command)'
+            char *command;
+            size_t commandLength = strtoul(c + 2, &command, 10);
+            command++;
+            size_t outputLength = 0;
+            char *output = command_output(command, commandLength, &outputLength);
+            expansion_append(&buffer, &capacity, &length, output, outputLength, pattern);
+            free(output);
+            c = command + commandLength;
+        }else if(*c=='$'){ // '${NAME}'
+            const char *end = strchr(c, '}');
+            char number[3 * sizeof(int) + 2];
+            const char *value = number;
+            if(end - c==3 && c[2]=='?'){
+                snprintf(number, sizeof(number), "%d", current_shell->last_status);
+            }else if(end - c==3 && c[2]=='$'){
+                snprintf(number, sizeof(number), "%d", (int)getpid());
+            }else{
+                value = variable_get(c + 2, end - c - 2);
+            }
+            if(value!=NULL){
+                expansion_append(&buffer, &capacity, &length, value, strlen(value), pattern);
+            }
+            c = end;
+        }else{
+            buffer[length++] = *c;
+        }
+    }
+    char *expanded = arena_strndup(&current_shell->expansion, buffer!=NULL ? buffer : "", length);
+    free(buffer);
+    return expanded;
+}
+
+int heredoc_open(const char *text){ // Creating a function to put the text of a here-document into a memfd, which the command reads as a file, returning the memfd or -1
+
+    int fd = memfd_create("tinyshell-heredoc", MFD_CLOEXEC);
+    if(fd==-1 || !write_all(fd, text, strlen(text)) || lseek(fd, 0, SEEK_SET)!=0){
+        perror("Unable to create here-document!"); // Outputting error message
+        if(fd!=-1){
+            close(fd);
+        }
+        return -1;
+    }
+    current_shell->expansion_fds = grow_scratch(current_shell->expansion_fds, &current_shell->expansion_fd_capacity, current_shell->expansion_fd_count + 1, sizeof(int));
+    current_shell->expansion_fds[current_shell->expansion_fd_count++] = fd;
+    return fd;
+}
+
+void expansion_close(void){ // Creating a function to close the here-documents of the pipeline which was executed, its stages holding their own copies
+    for(size_t i=0; i<current_shell->expansion_fd_count; i++){
+        close(current_shell->expansion_fds[i]);
+    }
+    current_shell->expansion_fd_count = 0;
+}
+
+bool expand_redirections(struct redirection **redirections){ // Creating a function to copy the redirections of a stage, expanding the variables of their file names and opening their here-documents
+
+    struct redirection *expanded = NULL;
+    struct redirection **last = &expanded;
+    for(struct redirection *r=*redirections; r!=NULL; r=r->next){
+        struct redirection *copy = arena_alloc(&current_shell->expansion, sizeof(struct redirection));
+        *copy = *r;
+        copy->target = r->target_flags!=0 ? expand_variables(r->target, r->target_flags) : r->target;
+        copy->target_flags = 0;
+        copy->next = NULL;
+        if(r->type==REDIRECT_HEREDOC){ // Every execution reads a fresh copy of the text, from memory
+            copy->type = REDIRECT_DUP;
+            copy->source_fd = heredoc_open(copy->target);
+            if(copy->source_fd<0){
+                return false;
+            }
+        }
+        *last = copy;
+        last = &copy->next;
+    }
+    *redirections = expanded;
+    return true;
+}
+
+struct shell_pipeline *expand_pipeline(struct shell_pipeline *pipeline){ // Creating a function to expand the patterns of a pipeline into a copy of it, leaving the parsed pipeline unchanged
+
+    bool expand = false;
+    for(int i=0; i<pipeline->stage_count; i++){
+        expand = expand || pipeline->stages[i].word_flags!=NULL;
+    }
+    if(!expand){ // Most command lines have no pattern and are executed as they are
+        return pipeline;
+    }
+
+    long long started = TRACE_START();
+    arena_reset(&current_shell->expansion); // Releasing the previous expansion
+    struct shell_pipeline *expanded = arena_alloc(&current_shell->expansion, sizeof(struct shell_pipeline));
+    *expanded = *pipeline;
+    expanded->stages = arena_alloc(&current_shell->expansion, pipeline->stage_count * sizeof(struct shell_command));
+    struct glob_state *g = malloc(sizeof(struct glob_state));
+    if(g==NULL){
+        perror("Unable to allocate memory!"); // Outputting error message
+        return NULL;
+    }
+    g->matches = NULL;
+    g->capacity = 0;
+    current_shell->batch_prefix = -1;
+    current_shell->batch_suffix = 0;
+
+    for(int i=0; i<pipeline->stage_count; i++){
+        const struct shell_command *stage = &pipeline->stages[i];
+        expanded->stages[i] = *stage;
+        if(stage->word_flags==NULL){
+            continue;
+        }
+        g->count = 0;
+        size_t prefix = 0; // The number of arguments before the current word
+        size_t lastPattern = 0; // The number of arguments up to the end of the last pattern
+        for(int w=0; w<stage->argc; w++){
+            char *word = expand_variables(stage->argv[w], stage->word_flags[w]);
+            if(stage->word_flags[w] & WORD_GLOB){
+                glob_expand(g, word);
+            }else if(word[0]!='\0' || (stage->word_flags[w] & (WORD_VARIABLE | WORD_QUOTED))!=WORD_VARIABLE){ // An unquoted reference to an empty variable leaves no argument
+                glob_add(g, word);
+            }
+            if(i==0 && (stage->word_flags[w] & WORD_GLOB)){ // Remembering which arguments came from patterns, for 'execute_batches'
+                current_shell->batch_prefix = current_shell->batch_prefix<0 ? (int)prefix : current_shell->batch_prefix;
+                lastPattern = g->count;
+            }
+            prefix = g->count;
+        }
+        if(i==0){
+            current_shell->batch_suffix = (int)(g->count - lastPattern);
+        }
+        bool failed = !expand_redirections(&expanded->stages[i].redirections);
+        if(!failed && g->count==0 && pipeline->stage_count>1){ // Only a single command may be left with redirections alone
+            fprintf(stderr,"Error: Pipeline stage %d expanded to an empty command\n", i+1); // Output error message
+            failed = true;
+        }
+        if(failed){
+            free(g->matches);
+            free(g);
+            expansion_close();
+            return NULL;
+        }
+        expanded->stages[i].argv = arena_alloc(&current_shell->expansion, (g->count + 1) * sizeof(char*));
+        memcpy(expanded->stages[i].argv, g->matches, g->count * sizeof(char*));
+        expanded->stages[i].argv[g->count] = NULL;
+        expanded->stages[i].argc = g->count;
+        expanded->stages[i].word_flags = NULL;
+    }
+    free(g->matches);
+    free(g);
+    TRACE(TRACE_GLOB, started, getpid(), NULL, expanded->stages[0].argc);
+    return expanded;
+}
+
+size_t arguments_size(char *const *argv, int count){ // Creating a function to compute the space taken by arguments in a new process, as counted against ARG_MAX
+    size_t size = sizeof(char*); // The terminating NULL
+    for(int i=0; i<count; i++){
+        size += strlen(argv[i]) + 1 + sizeof(char*);
+    }
+    return size;
+}
+
+size_t arguments_limit(void){ // Creating a function to compute how much of ARG_MAX the arguments of a program can use
+
+    long max = sysconf(_SC_ARG_MAX);
+    environment_envp(); // Making sure 'envp_size' is up to date
+    size_t available = max>0 ? (size_t)max : 131072;
+    size_t limit = available > environment.envp_size ? available - environment.envp_size : 0;
+    return limit > 4096 ? limit - 4096 : 0; // Leaving room for the auxiliary vector and the program name
+}
+
+bool arguments_exceed_limit(struct shell_pipeline *expanded){ // Creating a function to check whether a stage would fail with E2BIG, builtins having no limit
+
+    size_t limit = arguments_limit();
+    for(int i=0; i<expanded->stage_count; i++){
+        const struct shell_command *stage = &expanded->stages[i];
+        if(stage->argc>0 && find_builtin(stage->argv[0])==NULL && arguments_size(stage->argv, stage->argc)>limit){ // Builtin stages run on a thread or in a fork, never calling exec
+            return true;
+        }
+    }
+    return false;
+}
+
+bool confirm_batches(const struct shell_command *stage, size_t limit){ // Creating a function to ask the user whether a command may run in batches, interactive shells only
+
+    size_t size = arguments_size(stage->argv, stage->argc);
+    if(!job_control || !isatty(STDIN_FILENO)){
+        fprintf(stderr,"Error: %s: Argument list too long (%zu bytes, ARG_MAX allows %zu), prefix the command with 'batch' to run it in batches\n", stage->argv[0], size, limit); // Output error message
+        return false;
+    }
+    fprintf(stderr,"TinyShell: %d arguments take %zu bytes but ARG_MAX allows %zu. Run '%s' in batches? [y/N] ", stage->argc, size, limit, stage->argv[0]);
+    char answer[64];
+    ssize_t length = read(STDIN_FILENO, answer, sizeof(answer));
+    return length>0 && (answer[0]=='y' || answer[0]=='Y');
+}
+
+int run_batches(const struct shell_pipeline *expanded, const struct shell_command *stage, struct redirection *appending){ // Creating a function to run a command once per batch of its arguments, one batch after another
+
+    size_t limit = arguments_limit();
+    int prefix = current_shell->batch_prefix; // The arguments before the first pattern and after the last one are repeated in every batch
+    int suffix = current_shell->batch_suffix;
+    int end = stage->argc - suffix;
+    size_t fixed = arguments_size(stage->argv, prefix) + arguments_size(stage->argv + end, suffix);
+
+    char **argv = arena_alloc(&current_shell->expansion, (stage->argc + 1) * sizeof(char*));
+    memcpy(argv, stage->argv, prefix * sizeof(char*));
+    bool detach = current_shell->detach; // Every batch is waited for before the next one starts
+    current_shell->detach = false;
+    int status = 0;
+    int batches = 0;
+    for(int item=prefix; item<end; batches++){
+        int count = prefix;
+        size_t size = fixed;
+        while(item<end && (count==prefix || size + strlen(stage->argv[item]) + 1 + sizeof(char*)<=limit)){ // Filling the batch, with at least one argument
+            size += strlen(stage->argv[item]) + 1 + sizeof(char*);
+            argv[count++] = stage->argv[item++];
+        }
+        memcpy(argv + count, stage->argv + end, suffix * sizeof(char*));
+        count += suffix;
+        argv[count] = NULL;
+
+        struct shell_command command = {argv, count, batches==0 ? stage->redirections : appending, NULL, stage->sched};
+        struct shell_pipeline batch = *expanded;
+        batch.stages = &command;
+        batch.stage_count = 1;
+        int result = fork_exec_pipe_ex(&batch, false);
+        status = result!=0 ? result : status;
+        if(result<0 || result>128){ // An error of the shell or a signal stops the remaining batches
+            break;
+        }
+    }
+    current_shell->detach = detach;
+    return status;
+}
+
+int batch_stage(char **args, struct builtin_io *io){ // Creating a function to run the batches of the first stage of a pipeline in its child, all of them writing into the pipe to the next stage, as 'xargs ... |' does
+
+    int argc = 0;
+    while(args[argc]!=NULL){
+        argc++;
+    }
+    fflush(io->out);
+    struct shell_command stage = {args, argc, NULL, NULL, NULL}; // The redirections and 'sched' options of the stage already apply to this child
+    struct shell_pipeline batches = {&stage, 1, false, args[0], 0, false, false, false, false, NULL, NULL, LIST_SEQUENCE, NULL};
+    int status = run_batches(&batches, &stage, NULL);
+    return status<0 ? 1 : status;
+}
+
+int execute_batches(struct shell_pipeline *pipeline, struct shell_pipeline *expanded){ // Creating a function to run a command whose arguments exceed ARG_MAX several times, splitting its expanded arguments as xargs does
+
+    struct shell_command *stage = &expanded->stages[0];
+    size_t limit = arguments_limit();
+    for(int i=1; i<expanded->stage_count; i++){ // Only the first stage is split, the batches feeding the others
+        struct shell_command *later = &expanded->stages[i];
+        if(later->argc>0 && find_builtin(later->argv[0])==NULL && arguments_size(later->argv, later->argc)>limit){
+            fprintf(stderr,"Error: %s: Argument list too long, only the first command of a pipeline can run in batches\n", later->argv[0]); // Output error message
+            return 126;
+        }
+    }
+    if(expanded->background){ // Batches run one after another, which the shell waits for
+        fprintf(stderr,"Error: %s: Argument list too long, background commands cannot run in batches\n", stage->argv[0]); // Output error message
+        return 126;
+    }
+    if(!pipeline->batch && !confirm_batches(stage, limit)){
+        return 126;
+    }
+
+    int prefix = current_shell->batch_prefix;
+    int suffix = current_shell->batch_suffix;
+    if(prefix<=0 || arguments_size(stage->argv, prefix) + arguments_size(stage->argv + stage->argc - suffix, suffix)>=limit){ // Nothing to split, or the repeated arguments alone are too long
+        fprintf(stderr,"Error: %s: Argument list too long\n", stage->argv[0]); // Output error message
+        return 126;
+    }
+
+    if(expanded->stage_count>1){ // The first stage becomes a child running the batches, the other stages reading all of their output
+        bool detach = current_shell->detach;
+        current_shell->detach = false;
+        int status = fork_exec_pipe_with(expanded, false, batch_stage);
+        current_shell->detach = detach;
+        return status;
+    }
+
+    struct redirection *appending = NULL; // Later batches append to the files the first one created
+    struct redirection **last = &appending;
+    for(struct redirection *r=stage->redirections; r!=NULL; r=r->next){
+        struct redirection *copy = arena_alloc(&current_shell->expansion, sizeof(struct redirection));
+        *copy = *r;
+        copy->type = r->type==REDIRECT_OUT ? REDIRECT_APPEND : r->type;
+        copy->next = NULL;
+        *last = copy;
+        last = &copy->next;
+    }
+    return run_batches(expanded, stage, appending);
+}
+
+int execute_copy_command(struct shell_command *command){ // Creating a function to run 'cat < a > b' and '< a > b' inside the shell, copying in the kernel without a fork
+
+    bool cat = command->argc==1 && strcmp(command->argv[0],"cat")==0;
+    if(command->argc!=0 && !cat){
+        return -6; // Not a copy, the command is executed normally
+    }
+
+    bool input = false;
+    bool output = false;
+    for(struct redirection *r=command->redirections; r!=NULL; r=r->next){
+        if(cat && (r->type==REDIRECT_DUP || r->fd>STDERR_FILENO)){ // Anything unusual is left to the real 'cat'
+            return -6;
+        }
+        input = input || (r->fd==STDIN_FILENO && r->type==REDIRECT_IN);
+        output = output || (r->fd==STDOUT_FILENO && r->type!=REDIRECT_IN);
+    }
+    if(cat && (!input || !output)){ // Reading the terminal or writing to it is left to the real 'cat'
+        return -6;
+    }
+
+    int fds[3] = {-1, -1, -1}; // The files opened for fds 0-2, without a command only the files themselves matter
+    int status = 0;
+    for(struct redirection *r=command->redirections; r!=NULL; r=r->next){ // Opening (and creating or truncating) every file in order
+        if(r->type==REDIRECT_DUP || r->fd>STDERR_FILENO){
+            continue;
+        }
+        int fd = open(r->target, redirection_flags(r->type) | O_CLOEXEC, 0666);
+        if(fd==-1){
+            perror(redirection_error(r)); // Outputting error message
+            status = 1;
+            break;
+        }
+        if(fds[r->fd]>=0){
+            close(fds[r->fd]);
+        }
+        fds[r->fd] = fd;
+    }
+
+    int captured = -1; // The buffer holding the output for the callback of the context
+    if(status==0 && fds[STDIN_FILENO]>=0 && fds[STDOUT_FILENO]<0 && current_shell->output!=NULL){
+        captured = memfd_create("tinyshell-output", MFD_CLOEXEC);
+        if(captured==-1){
+            perror("Unable to capture output!"); // Outputting error message
+            status = 1;
+        }
+    }
+
+    if(status==0 && fds[STDIN_FILENO]>=0){ // Copying the input to the output
+        int out = fds[STDOUT_FILENO]>=0 ? fds[STDOUT_FILENO] : captured>=0 ? captured : STDOUT_FILENO;
+        struct stat inInfo, outInfo;
+        fflush(stdout);
+        if(fstat(fds[STDIN_FILENO], &inInfo)==0 && fstat(out, &outInfo)==0 && S_ISREG(inInfo.st_mode) && inInfo.st_dev==outInfo.st_dev && inInfo.st_ino==outInfo.st_ino){
+            fprintf(stderr,"Error: The input file is the output file.\n"); // Output error message
+            status = 1;
+        }else if(!copy_data(fds[STDIN_FILENO], out)){
+            perror("Unable to copy file!"); // Outputting error message
+            status = 1;
+        }
+    }
+
+    if(captured>=0){ // Passing the copy to the callback
+        if(status==0 && lseek(captured, 0, SEEK_SET)==0){
+            deliver_output(captured, STDOUT_FILENO);
+        }
+        close(captured);
+    }
+    for(int i=0; i<3; i++){
+        if(fds[i]>=0){
+            close(fds[i]);
+        }
+    }
+    return status;
+}
+
+void print_json_string(FILE *out, const char *string){ // Creating a function to write a string as a JSON string literal
+
+    fputc('"', out);
+    for(const unsigned char *c=(const unsigned char*)string; *c!='\0'; c++){
+        if(*c=='"' || *c=='\\'){
+            fprintf(out,"\\%c", *c);
+        }else if(*c<0x20){
+            fprintf(out,"\\u%04x", *c);
+        }else{
+            fputc(*c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+double timeval_seconds(struct timeval tv){ // Creating a function to convert a 'timeval' into seconds
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+void print_timing(struct shell_pipeline *pipeline, int status, double real, const struct rusage *shell, bool json){ // Creating a function to report the resources used by a timed pipeline, per stage and in total
+
+    int stages = current_shell->pipeline_status_count; // Zero when the pipeline ran inside the shell
+    double user = timeval_seconds(shell->ru_utime); // The time spent by the shell itself counts towards the total
+    double sys = timeval_seconds(shell->ru_stime);
+    long maxrss = stages==0 ? shell->ru_maxrss : 0;
+    long nvcsw = shell->ru_nvcsw;
+    long nivcsw = shell->ru_nivcsw;
+    for(int i=0; i<stages; i++){
+        const struct rusage *usage = &current_shell->pipeline_usage[i].usage;
+        user += timeval_seconds(usage->ru_utime);
+        sys += timeval_seconds(usage->ru_stime);
+        maxrss = usage->ru_maxrss > maxrss ? usage->ru_maxrss : maxrss;
+        nvcsw += usage->ru_nvcsw;
+        nivcsw += usage->ru_nivcsw;
+    }
+
+    if(json){ // A single line, for scripts
+        fprintf(stderr,"{\"status\":%d,\"real\":%.6f,\"user\":%.6f,\"sys\":%.6f,\"maxrss_kb\":%ld,\"nvcsw\":%ld,\"nivcsw\":%ld,\"stages\":[", status, real, user, sys, maxrss, nvcsw, nivcsw);
+        for(int i=0; i<stages; i++){
+            const struct rusage *usage = &current_shell->pipeline_usage[i].usage;
+            fprintf(stderr,"%s{\"command\":", i>0 ? "," : "");
+            print_json_string(stderr, pipeline->stages[i].argv[0]);
+            fprintf(stderr,",\"status\":%d,\"real\":%.6f,\"user\":%.6f,\"sys\":%.6f,\"maxrss_kb\":%ld,\"nvcsw\":%ld,\"nivcsw\":%ld}", current_shell->pipeline_status[i], current_shell->pipeline_usage[i].elapsed, timeval_seconds(usage->ru_utime), timeval_seconds(usage->ru_stime), usage->ru_maxrss, usage->ru_nvcsw, usage->ru_nivcsw);
+        }
+        fprintf(stderr,"]}\n");
+        return;
+    }
+
+    fprintf(stderr,"\n%-6s %6s %10s %10s %10s %10s %7s %7s  %s\n", "stage", "status", "real", "user", "sys", "maxrss", "vcsw", "ivcsw", "command");
+    for(int i=0; i<stages; i++){
+        const struct rusage *usage = &current_shell->pipeline_usage[i].usage;
+        fprintf(stderr,"%-6d %6d %9.3fs %9.3fs %9.3fs %9ldK %7ld %7ld  %s\n", i+1, current_shell->pipeline_status[i], current_shell->pipeline_usage[i].elapsed, timeval_seconds(usage->ru_utime), timeval_seconds(usage->ru_stime), usage->ru_maxrss, usage->ru_nvcsw, usage->ru_nivcsw, pipeline->stages[i].argv[0]);
+    }
+    fprintf(stderr,"%-6s %6d %9.3fs %9.3fs %9.3fs %9ldK %7ld %7ld  %s\n", "total", status, real, user, sys, maxrss, nvcsw, nivcsw, pipeline->text);
+}
+
+void drop_words(struct shell_command *command, int count){ // Creating a function to remove the first words of a command, such as a prefix
+
+    command->argv += count;
+    command->argc -= count;
+    if(command->word_flags!=NULL){
+        command->word_flags += count;
+    }
+}
+
+struct resource_name{ // Defining the structure for a resource 'sched -l' can limit
+    const char *name;
+    int resource;
+};
+
+const struct resource_name resource_names[] = {{"as", RLIMIT_AS}, {"core", RLIMIT_CORE}, {"cpu", RLIMIT_CPU}, {"data", RLIMIT_DATA}, {"fsize", RLIMIT_FSIZE},
+    {"memlock", RLIMIT_MEMLOCK}, {"nofile", RLIMIT_NOFILE}, {"nproc", RLIMIT_NPROC}, {"stack", RLIMIT_STACK}};
+
+bool parse_cpu_list(const char *text, cpu_set_t *cpus){ // Creating a function to read a list of CPUs such as '0-3,8'
+
+    CPU_ZERO(cpus);
+    const char *c = text;
+    while(true){
+        char *end;
+        unsigned long first = isdigit((unsigned char)*c) ? strtoul(c, &end, 10) : ULONG_MAX;
+        unsigned long last = first;
+        if(first!=ULONG_MAX && *end=='-'){
+            c = end + 1;
+            last = isdigit((unsigned char)*c) ? strtoul(c, &end, 10) : ULONG_MAX;
+        }
+        if(first==ULONG_MAX || last==ULONG_MAX || first>last || last>=CPU_SETSIZE){
+            return false;
+        }
+        for(unsigned long cpu=first; cpu<=last; cpu++){
+            CPU_SET(cpu, cpus);
+        }
+        if(*end=='\0'){
+            return true;
+        }
+        if(*end!=','){
+            return false;
+        }
+        c = end + 1;
+    }
+}
+
+bool parse_limit_value(const char *text, const char **end, rlim_t *value){ // Creating a function to read a resource limit, a number with an optional 'K', 'M' or 'G' suffix or 'unlimited'
+
+    if(strncmp(text,"unlimited",9)==0){
+        *value = RLIM_INFINITY;
+        *end = text + 9;
+        return true;
+    }
+    if(!isdigit((unsigned char)*text)){
+        return false;
+    }
+    char *suffix;
+    errno = 0;
+    unsigned long long number = strtoull(text, &suffix, 10);
+    int shift = *suffix=='K' || *suffix=='k' ? 10 : *suffix=='M' || *suffix=='m' ? 20 : *suffix=='G' || *suffix=='g' ? 30 : 0;
+    if(errno!=0 || number>(ULLONG_MAX >> shift)){
+        return false;
+    }
+    *value = (rlim_t)(number << shift);
+    *end = suffix + (shift>0);
+    return true;
+}
+
+bool parse_limit(const char *text, struct stage_limit *limit){ // Creating a function to read 'RESOURCE=SOFT[:HARD]'
+
+    const char *equals = strchr(text, '=');
+    if(equals==NULL){
+        return false;
+    }
+    limit->resource = -1;
+    for(size_t i=0; i<sizeof(resource_names)/sizeof(resource_names[0]); i++){
+        if(strlen(resource_names[i].name)==(size_t)(equals - text) && strncmp(resource_names[i].name, text, equals - text)==0){
+            limit->resource = resource_names[i].resource;
+        }
+    }
+    const char *end;
+    if(limit->resource<0 || !parse_limit_value(equals + 1, &end, &limit->limit.rlim_cur)){
+        return false;
+    }
+    limit->limit.rlim_max = limit->limit.rlim_cur; // A single value sets both limits, as 'ulimit' does
+    if(*end==':' && !parse_limit_value(end + 1, &end, &limit->limit.rlim_max)){
+        return false;
+    }
+    return *end=='\0' && limit->limit.rlim_cur<=limit->limit.rlim_max;
+}
+
+bool parse_policy(const char *text, struct stage_sched *sched){ // Creating a function to read a scheduling policy: 'other', 'batch', 'idle', 'fifo:PRIORITY' or 'rr:PRIORITY'
+
+    const char *colon = strchr(text, ':');
+    size_t length = colon!=NULL ? (size_t)(colon - text) : strlen(text);
+    const char *names[] = {"other", "batch", "idle", "fifo", "rr"};
+    int policies[] = {SCHED_OTHER, SCHED_BATCH, SCHED_IDLE, SCHED_FIFO, SCHED_RR};
+    sched->policy = -1;
+    for(int i=0; i<5; i++){
+        if(strlen(names[i])==length && strncmp(names[i], text, length)==0){
+            sched->policy = policies[i];
+        }
+    }
+    bool realtime = sched->policy==SCHED_FIFO || sched->policy==SCHED_RR;
+    if(sched->policy<0 || realtime!=(colon!=NULL)){ // Only the real-time policies take a priority
+        return false;
+    }
+    sched->priority = 0;
+    if(realtime){
+        char *end;
+        long priority = strtol(colon + 1, &end, 10);
+        if(end==colon + 1 || *end!='\0' || priority<sched_get_priority_min(sched->policy) || priority>sched_get_priority_max(sched->policy)){
+            return false;
+        }
+        sched->priority = (int)priority;
+    }
+    return true;
+}
+
+int parse_sched(struct parser *p, struct shell_pipeline *pipeline, struct shell_command *command){ // Creating a function to read 'sched [-c CPUS] [-s] [-n NICE] [-p POLICY] [-l LIMIT]... command', returning the number of words read, or -1 on an error
+
+    struct stage_sched *sched = command->sched;
+    if(sched==NULL){
+        sched = arena_alloc(&p->arena, sizeof(struct stage_sched));
+        CPU_ZERO(&sched->cpus);
+        sched->pinned = false;
+        sched->niced = false;
+        sched->nice = 0;
+        sched->policy = -1;
+        sched->priority = 0;
+        sched->limit_count = 0;
+    }
+
+    int w = 1;
+    while(w<command->argc && command->argv[w][0]=='-'){
+        const char *option = command->argv[w];
+        const char *value = w+1<command->argc ? command->argv[w+1] : NULL;
+        if(strcmp(option,"-s")==0){ // The CPUs are chosen when the pipeline is launched
+            pipeline->spread = true;
+            w++;
+            continue;
+        }
+        if(value==NULL && (strcmp(option,"-c")==0 || strcmp(option,"-n")==0 || strcmp(option,"-p")==0 || strcmp(option,"-l")==0)){
+            parse_error(p, "sched: '%s' requires a value\n", option); // Output error message
+            return -1;
+        }
+        bool valid = true;
+        if(strcmp(option,"-c")==0){
+            valid = sched->pinned = parse_cpu_list(value, &sched->cpus);
+        }else if(strcmp(option,"-n")==0){
+            char *end;
+            long nice = strtol(value, &end, 10);
+            valid = sched->niced = end!=value && *end=='\0' && nice>=-20 && nice<=19;
+            sched->nice = (int)nice;
+        }else if(strcmp(option,"-p")==0){
+            valid = parse_policy(value, sched);
+        }else if(strcmp(option,"-l")==0){
+            valid = sched->limit_count<SCHED_MAX_LIMITS && parse_limit(value, &sched->limits[sched->limit_count++]);
+        }else{
+            parse_error(p, "sched: '%s' is not a valid option\n", option); // Output error message
+            return -1;
+        }
+        if(!valid){
+            parse_error(p, "sched: '%s' is not a valid value for '%s'\n", value, option); // Output error message
+            return -1;
+        }
+        w += 2;
+    }
+    if(w>=command->argc){
+        parse_error(p, "sched: A command should always follow the options.\n"); // Output error message
+        return -1;
+    }
+    command->sched = sched;
+    return w;
+}
+
+int parse_memo(struct parser *p, struct shell_pipeline *pipeline, struct shell_command *command){ // Creating a function to read 'memo [-i PATH]... [-e NAME]... command', returning the number of words read, or -1 on an error
+
+    int w = 1;
+    int inputs = 0;
+    int variables = 0;
+    while(w<command->argc && command->argv[w][0]=='-'){ // Counting the options first, so their lists are allocated once
+        const char *option = command->argv[w];
+        if(strcmp(option,"-i")!=0 && strcmp(option,"-e")!=0){
+            parse_error(p, "memo: '%s' is not a valid option\n", option); // Output error message
+            return -1;
+        }
+        if(w+1>=command->argc){
+            parse_error(p, "memo: '%s' requires a value\n", option); // Output error message
+            return -1;
+        }
+        if(command->word_flags!=NULL && (command->word_flags[w+1] & (WORD_GLOB | WORD_VARIABLE))!=0){ // The key is made of what the options name, they are not expanded
+            parse_error(p, "memo: '%s' takes a literal name\n", option); // Output error message
+            return -1;
+        }
+        inputs += option[1]=='i';
+        variables += option[1]=='e';
+        w += 2;
+    }
+    if(w>=command->argc){
+        parse_error(p, "memo: A command should always follow the options.\n"); // Output error message
+        return -1;
+    }
+    if(pipeline->background){
+        parse_error(p, "memo: A memoized pipeline cannot run in the background.\n"); // Output error message
+        return -1;
+    }
+    for(struct redirection *r=pipeline->stages[pipeline->stage_count-1].redirections; r!=NULL; r=r->next){ // The output is replayed into a file or stdout, never into another descriptor
+        if(r->type==REDIRECT_DUP && (r->fd==STDOUT_FILENO || r->source_fd==STDOUT_FILENO)){
+            parse_error(p, "memo: The output of the pipeline can only be redirected to a file.\n"); // Output error message
+            return -1;
+        }
+    }
+
+    struct memo_options *memo = arena_alloc(&p->arena, sizeof(struct memo_options));
+    memo->inputs = arena_alloc(&p->arena, (inputs + 1) * sizeof(char*));
+    memo->input_count = 0;
+    memo->variables = arena_alloc(&p->arena, (variables + 1) * sizeof(char*));
+    memo->variable_count = 0;
+    for(int i=1; i<w; i+=2){
+        if(command->argv[i][1]=='i'){
+            memo->inputs[memo->input_count++] = command->argv[i+1];
+        }else{
+            memo->variables[memo->variable_count++] = command->argv[i+1];
+        }
+    }
+    pipeline->memo = memo;
+    return w;
+}
+
+#define WATCH_DEFAULT_DELAY 50 // The quiet time of 'watch' in milliseconds, so that a file saved in several writes runs the pipeline once
+
+int parse_watch(struct parser *p, struct shell_pipeline *pipeline, struct shell_command *command){ // Creating a function to read 'watch [--paths PATH...] [--delay MS] -- command', returning the number of words read, or -1 on an error
+
+    struct watch_options *watch = arena_alloc(&p->arena, sizeof(struct watch_options));
+    watch->paths = arena_alloc(&p->arena, command->argc * sizeof(char*));
+    watch->path_count = 0;
+    watch->delay = WATCH_DEFAULT_DELAY;
+    int w = 1;
+    while(w<command->argc && strcmp(command->argv[w],"--")!=0){
+        const char *option = command->argv[w++];
+        if(strcmp(option,"--paths")==0){ // Every word up to the next option is a path
+            int first = w;
+            while(w<command->argc && strncmp(command->argv[w],"--",2)!=0){
+                if(command->word_flags!=NULL && (command->word_flags[w] & (WORD_GLOB | WORD_VARIABLE))!=0){ // The paths are watched as they were written, a directory covers its files
+                    parse_error(p, "watch: '--paths' takes literal names\n"); // Output error message
+                    return -1;
+                }
+                watch->paths[watch->path_count++] = command->argv[w++];
+            }
+            if(w==first){
+                parse_error(p, "watch: '--paths' requires a value\n"); // Output error message
+                return -1;
+            }
+        }else if(strcmp(option,"--delay")==0){
+            if(w>=command->argc){
+                parse_error(p, "watch: '--delay' requires a value\n"); // Output error message
+                return -1;
+            }
+            char *end;
+            long delay = strtol(command->argv[w], &end, 10);
+            if(end==command->argv[w] || *end!='\0' || delay<0 || delay>60000){
+                parse_error(p, "watch: '%s' is not a valid value for '--delay'\n", command->argv[w]); // Output error message
+                return -1;
+            }
+            watch->delay = (int)delay;
+            w++;
+        }else{
+            parse_error(p, "watch: '%s' is not a valid option\n", option); // Output error message
+            return -1;
+        }
+    }
+    if(w+1>=command->argc){
+        parse_error(p, "watch: A command should always follow '--'.\n"); // Output error message
+        return -1;
+    }
+    if(pipeline->background){
+        parse_error(p, "watch: A watched pipeline cannot run in the background.\n"); // Output error message
+        return -1;
+    }
+    pipeline->watch = watch;
+    return w + 1;
+}
+
+bool parse_prefixes(struct parser *p, struct shell_pipeline *pipeline){ // Creating a function to read the prefixes which change how a pipeline is run, removing them from its first stage
+
+    struct shell_command *first = &pipeline->stages[0];
+    while(true){
+        if(first->argc>2 && strcmp(first->argv[0],"pipesize")==0){ // 'pipesize N command...' sets the pipe size of this pipeline only
+            if(!parse_size(first->argv[1], &pipeline->pipe_size)){
+                parse_error(p, "pipesize: '%s' is not a valid size\n", first->argv[1]); // Output error message
+                return false;
+            }
+            drop_words(first, 2);
+        }else if(first->argc>0 && strcmp(first->argv[0],"time")==0){ // 'time [-j] pipeline' reports the resources used by every stage
+            pipeline->timed = true;
+            drop_words(first, 1);
+            if(first->argc>0 && strcmp(first->argv[0],"-j")==0){
+                pipeline->time_json = true;
+                drop_words(first, 1);
+            }
+        }else if(first->argc>1 && strcmp(first->argv[0],"batch")==0){ // 'batch command...' runs the command in batches when its expanded arguments exceed ARG_MAX
+            pipeline->batch = true;
+            drop_words(first, 1);
+        }else if(first->argc>0 && strcmp(first->argv[0],"sched")==0){ // 'sched options command...' sets the CPUs, priority and limits of this stage
+            int words = parse_sched(p, pipeline, first);
+            if(words<0){
+                return false;
+            }
+            drop_words(first, words);
+        }else if(first->argc>1 && pipeline->memo==NULL && strcmp(first->argv[0],"memo")==0){ // 'memo [-i PATH]... [-e NAME]... pipeline' replays the stored output of an earlier run with the same key
+            int words = parse_memo(p, pipeline, first);
+            if(words<0){
+                return false;
+            }
+            drop_words(first, words);
+        }else if(first->argc>1 && pipeline->watch==NULL && strcmp(first->argv[0],"watch")==0 && (strcmp(first->argv[1],"--")==0 || strcmp(first->argv[1],"--paths")==0 || strcmp(first->argv[1],"--delay")==0)){ // 'watch [--paths PATH...] [--delay MS] -- pipeline' runs the pipeline again whenever its files change, other uses of 'watch' are left to the program
+            int words = parse_watch(p, pipeline, first);
+            if(words<0){
+                return false;
+            }
+            drop_words(first, words);
+        }else{
+            break;
+        }
+    }
+    for(int i=1; i<pipeline->stage_count; i++){ // Every other stage can only be prefixed with 'sched'
+        struct shell_command *stage = &pipeline->stages[i];
+        while(stage->argc>0 && strcmp(stage->argv[0],"sched")==0){
+            int words = parse_sched(p, pipeline, stage);
+            if(words<0){
+                return false;
+            }
+            drop_words(stage, words);
+        }
+    }
+    if(first->argc==0 && pipeline->stage_count>1){
+        parse_error(p, "Pipeline operator cannot appear as the first or last token in a sequence.\n"); // Output error message
+        return false;
+    }
+    return true;
+}
+
+struct shell_pipeline *prepare_pipeline(struct parser *parser, const char *line){ // Creating a function to parse a line and its prefixes, or NULL on a syntax error
+
+    long long started = TRACE_START();
+    struct shell_pipeline *pipeline = parse_command_line(parser, line); // Lexing and parsing the line in a single pass
+    TRACE(TRACE_PARSE, started, getpid(), NULL, pipeline!=NULL ? pipeline->stage_count : -1);
+    for(struct shell_pipeline *next = pipeline; next!=NULL; next = next->next){ // Every pipeline of a list has prefixes of its own
+        if(next->stage_count>0 && !parse_prefixes(parser, next)){
+            return NULL;
+        }
+    }
+    return pipeline;
+}
+
+int execute_parsed(struct shell_pipeline *parsed){ // Creating a function to execute a parsed pipeline, which stays unchanged so it can be executed again
+
+    if(parsed->watch!=NULL){ // Every run of a watched pipeline comes back here, expanding its patterns again
+        return execute_watch(parsed);
+    }
+    command_hash.generation++; // Directories of $PATH, and those read by patterns, are checked again for every command line
+    current_shell->pipeline_status_count = 0; // Only the stages of this pipeline are reported
+    struct shell_pipeline *pipeline = expand_pipeline(parsed); // Patterns are expanded on every execution, as the files may have changed
+    if(pipeline==NULL){
+        current_shell->last_status = 1;
+        return current_shell->last_status;
+    }
+
+    struct rusage shellBefore;
+    double started = 0;
+    if(pipeline->timed){
+        getrusage(RUSAGE_SELF, &shellBefore);
+        started = monotonic_seconds();
+    }
+
+    int builtinResult = -6;
+    if(pipeline!=parsed && arguments_exceed_limit(pipeline)){ // Too many arguments for a single program, which would fail with E2BIG
+        builtinResult = execute_batches(parsed, pipeline);
+    }
+    if(pipeline->memo!=NULL && builtinResult==-6){ // Replaying the output of an earlier run, or running the pipeline and storing its output
+        builtinResult = execute_memo(pipeline);
+    }
+    bool scheduled = pipeline->stages[0].sched!=NULL || pipeline->spread; // Stages given CPUs or limits always run in a process of their own
+    if(pipeline->stage_count==1 && builtinResult==-6 && !scheduled && (!pipeline->background || pipeline->stages[0].argc==0)){ // Plain file copies are done by the shell itself
+        builtinResult = execute_copy_command(&pipeline->stages[0]);
+    }
+    if(pipeline->stage_count==1 && builtinResult==-6 && !scheduled && pipeline->stages[0].argc>0){ // We first try to execute a builtin command
+        builtinResult = execute_builtin_command(&pipeline->stages[0]);
+    }
+
+    if(builtinResult!=-6){ // A builtin command was executed, negative results being errors
+        current_shell->last_status = builtinResult;
+    }else{ // If the input does not match a builtin, the pipeline is executed
+        current_shell->last_status = fork_exec_pipe_ex(pipeline,pipeline->background); // Background pipelines are left to the job table
+    }
+    expansion_close(); // Every stage was started, so the here-documents are only held by the stages reading them
+    if(current_shell->detached!=NULL){ // Still running, the caller finishes it
+        return 0;
+    }
+
+    if(current_shell->last_status<0){ // Errors of the shell itself count as a general failure
+        current_shell->last_status = 1;
+    }
+
+    if(pipeline->timed && !pipeline->background){ // Background pipelines are still running, so there is nothing to report yet
+        double real = monotonic_seconds() - started;
+        struct rusage shell;
+        getrusage(RUSAGE_SELF, &shell);
+        shell.ru_utime.tv_sec -= shellBefore.ru_utime.tv_sec; // Keeping only what the shell used for this pipeline
+        shell.ru_utime.tv_usec -= shellBefore.ru_utime.tv_usec;
+        shell.ru_stime.tv_sec -= shellBefore.ru_stime.tv_sec;
+        shell.ru_stime.tv_usec -= shellBefore.ru_stime.tv_usec;
+        shell.ru_nvcsw -= shellBefore.ru_nvcsw;
+        shell.ru_nivcsw -= shellBefore.ru_nivcsw;
+        print_timing(pipeline, current_shell->last_status, real, &shell, pipeline->time_json);
+    }
+
+    if(current_shell->status!=NULL){ // Reporting the result to an embedding program
+        current_shell->status(current_shell->status_data, pipeline->text, current_shell->last_status, current_shell->pipeline_status, current_shell->pipeline_status_count);
+    }
+    return current_shell->last_status;
+}
+
+struct shell_pipeline *list_next(const struct shell_pipeline *pipeline, int status){ // Creating a function to find the pipeline of a command list which runs after one that ended with 'status', skipping those whose '&&' or '||' condition fails
+
+    enum list_operator then = pipeline->then;
+    struct shell_pipeline *next = pipeline->next;
+    while(next!=NULL && ((then==LIST_AND && status!=0) || (then==LIST_OR && status==0))){ // Skipping a pipeline keeps the status, so 'a && b || c' runs 'c' when either fails
+        then = next->then;
+        next = next->next;
+    }
+    return next;
+}
+
+int execute_list(struct shell_pipeline *list){ // Creating a function to execute the pipelines of a command list, skipping those whose '&&' or '||' condition fails
+
+    if(list->stage_count==0){ // Nothing was inputted
+        return current_shell->last_status;
+    }
+    bool detach = current_shell->detach;
+    int status = current_shell->last_status;
+    struct shell_pipeline *pipeline = list;
+    while(pipeline!=NULL && !current_shell->exit_requested){
+        current_shell->detach = detach && pipeline->next==NULL; // Only the last pipeline may be left running, the status of the others decides what runs next
+        status = execute_parsed(pipeline);
+        if(status==128+SIGINT){ // Ctrl-C stops the whole list, not only the pipeline running then
+            break;
+        }
+        pipeline = list_next(pipeline, status);
+    }
+    current_shell->detach = detach;
+    return status;
+}
+
+bool watch_add(struct watch_state *watch, const char *path){ // Creating a function to watch a directory, or a file through the directory holding it
+
+    struct stat info;
+    char directory[PATH_MAX];
+    const char *slash = strrchr(path, '/');
+    const char *name = NULL;
+    if(stat(path, &info)==0 && S_ISDIR(info.st_mode)){
+        snprintf(directory, sizeof(directory), "%s", path);
+    }else if(slash==NULL){
+        strcpy(directory, ".");
+        name = path;
+    }else{ // Editors often write a new file and rename it over the old one, which a watch on the file itself would miss
+        snprintf(directory, sizeof(directory), "%.*s", slash==path ? 1 : (int)(slash - path), path);
+        name = slash + 1;
+    }
+    int wd = inotify_add_watch(watch->fd, directory, WATCH_EVENTS);
+    if(wd==-1){
+        fprintf(stderr,"Error: watch: Unable to watch '%s': %s\n", path, strerror(errno)); // Output error message
+        return false;
+    }
+    watch->targets = grow_scratch(watch->targets, &watch->target_capacity, watch->target_count + 1, sizeof(struct watch_target));
+    watch->targets[watch->target_count].wd = wd;
+    watch->targets[watch->target_count++].name = name!=NULL ? strdup(name) : NULL;
+    return true;
+}
+
+bool watch_wait(struct watch_state *watch, int timer, int interruptFd, int delay){ // Creating a function to sleep until the watched files changed and then stayed unchanged for 'delay' milliseconds, returning false on Ctrl-C
+
+    struct itimerspec quiet = {{0, 0}, {delay / 1000, (delay % 1000) * 1000000L}};
+    struct pollfd fds[3] = {{watch->fd, POLLIN, 0}, {timer, POLLIN, 0}, {interruptFd, POLLIN, 0}};
+    bool pending = watch->changed; // A change during the last run counts, that run was cancelled
+    while(true){
+        if(pending && delay==0){
+            return true;
+        }
+        if(pending){ // Every change starts the quiet time again
+            timerfd_settime(timer, 0, &quiet, NULL);
+        }
+        pending = false;
+        if(poll(fds, 3, -1)==-1){ // Sleeping without using the CPU until something happens
+            if(errno==EINTR){
+                continue;
+            }
+            perror("Unable to watch files!"); // Outputting error message
+            return false;
+        }
+        if(fds[2].revents & POLLIN){
+            return false;
+        }
+        uint64_t expirations;
+        if((fds[1].revents & POLLIN) && read(timer, &expirations, sizeof(expirations))==sizeof(expirations)){
+            return true;
+        }
+        pending = (fds[0].revents & POLLIN) && watch_poll(watch);
+    }
+}
+
+int execute_watch(struct shell_pipeline *parsed){ // Creating a function to run a pipeline prefixed with 'watch', then again whenever its input files or the given paths change, until Ctrl-C
+
+    if(current_shell->detach || active_watch!=NULL){ // A server would stop answering its other clients
+        fprintf(stderr,"Error: watch: Cannot wait for changes here\n"); // Output error message
+        return 1;
+    }
+    if(!job_control_init(false)){
+        return 1;
+    }
+
+    struct watch_state watch = {inotify_init1(IN_NONBLOCK | IN_CLOEXEC), NULL, 0, 0, false};
+    int timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC); // Waiting for the files to stay unchanged, so a burst of writes runs the pipeline once
+    sigset_t interrupt, previous; // Ctrl-C ends the watch, children are started with 'child_sigmask', which does not block it
+    sigemptyset(&interrupt);
+    sigaddset(&interrupt, SIGINT);
+    sigprocmask(SIG_BLOCK, &interrupt, &previous);
+    int interruptFd = signalfd(-1, &interrupt, SFD_NONBLOCK | SFD_CLOEXEC);
+    struct epoll_event event = {.events = EPOLLIN, .data.fd = watch.fd};
+    bool ready = watch.fd!=-1 && timer!=-1 && interruptFd!=-1 && epoll_ctl(event_fd, EPOLL_CTL_ADD, watch.fd, &event)==0;
+    if(!ready){
+        perror("Unable to watch files!"); // Outputting error message
+    }
+    for(int i=0; i<parsed->stage_count && ready; i++){ // The files read with '<' by any stage
+        for(struct redirection *r=parsed->stages[i].redirections; r!=NULL && ready; r=r->next){
+            if(r->type==REDIRECT_IN){
+                ready = watch_add(&watch, r->target_flags!=0 ? expand_variables(r->target, r->target_flags) : r->target);
+            }
+        }
+    }
+    for(int i=0; i<parsed->watch->path_count && ready; i++){
+        ready = watch_add(&watch, parsed->watch->paths[i]);
+    }
+
+    struct shell_pipeline run = *parsed; // Running through the rest of 'execute_parsed', like any other pipeline
+    run.watch = NULL;
+    int status = 1;
+    active_watch = &watch;
+    while(ready){
+        watch.changed = false;
+        status = execute_parsed(&run);
+        fflush(stdout);
+        if(current_shell->exit_requested || (!watch.changed && (status==128+SIGINT || status==128+SIGTSTP))){ // Interrupting or stopping the pipeline ends the watch too
+            break;
+        }
+        if(!watch_wait(&watch, timer, interruptFd, parsed->watch->delay)){
+            status = 128 + SIGINT;
+            break;
+        }
+    }
+    active_watch = NULL;
+
+    struct signalfd_siginfo info;
+    while(interruptFd!=-1 && read(interruptFd, &info, sizeof(info))==sizeof(info)){ // Consuming the Ctrl-C which ended the watch
+    }
+    sigprocmask(SIG_SETMASK, &previous, NULL);
+    if(watch.fd!=-1){
+        epoll_ctl(event_fd, EPOLL_CTL_DEL, watch.fd, NULL);
+        close(watch.fd);
+    }
+    if(timer!=-1){
+        close(timer);
+    }
+    if(interruptFd!=-1){
+        close(interruptFd);
+    }
+    for(size_t i=0; i<watch.target_count; i++){
+        free(watch.targets[i].name);
+    }
+    free(watch.targets);
+    current_shell->last_status = status;
+    return status;
+}
+
+int execute_shell_command(const char* command){ // Creating a function to execute both builtin and external commands
+
+    struct shell_pipeline *pipeline = prepare_pipeline(&current_shell->parser, command);
+    if(pipeline==NULL){
+        current_shell->last_status = 2; // Syntax errors use the same status as other shells
+        return current_shell->last_status;
+    }
+    return execute_list(pipeline);
+}
+
+struct line_reader{ // Defining the structure of a buffered reader returning one line at a time
+    int fd; // The file descriptor being read
+    char *buffer; // The read buffer, which grows to hold the longest line
+    size_t start; // The offset of the first unread byte in 'buffer'
+    size_t end; // The offset after the last byte read into 'buffer'
+    size_t capacity; // The size of 'buffer'
+    bool eof; // Whether end-of-file was reached
+};
+
+#define LINE_READER_BLOCK 65536 // The number of bytes requested per 'read'
+
+bool line_reader_open(struct line_reader *reader, int fd){ // Creating a function to prepare a line reader for a file descriptor
+
+    reader->fd = fd;
+    reader->start = 0;
+    reader->end = 0;
+    reader->eof = false;
+    reader->capacity = LINE_READER_BLOCK;
+    reader->buffer = malloc(reader->capacity + 1); // One extra byte for the terminating '\0'
+    return reader->buffer!=NULL;
+}
+
+void line_reader_close(struct line_reader *reader){ // Creating a function to release a line reader
+    free(reader->buffer);
+    reader->buffer = NULL;
+}
+
+char *read_line(struct line_reader *reader){ // Creating a function to obtain the next line, without its newline, or NULL at end-of-file
+
+    size_t scanned = reader->start; // Bytes before this offset are known not to contain a newline
+
+    while(true){
+        char *newline = memchr(reader->buffer + scanned, '\n', reader->end - scanned); // Looking for the end of the line
+        if(newline!=NULL){ // A complete line is in the buffer, so it is returned in place
+            char *line = reader->buffer + reader->start;
+            *newline = '\0';
+            reader->start = newline - reader->buffer + 1;
+            return line;
+        }
+        scanned = reader->end;
+
+        if(reader->eof){ // The last line of the input may not end with a newline
+            if(reader->start==reader->end){
+                return NULL;
+            }
+            char *line = reader->buffer + reader->start;
+            reader->buffer[reader->end] = '\0';
+            reader->start = reader->end;
+            return line;
+        }
+
+        if(reader->start>0){ // Moving the partial line to the front of the buffer
+            memmove(reader->buffer, reader->buffer + reader->start, reader->end - reader->start);
+            reader->end -= reader->start;
+            scanned -= reader->start;
+            reader->start = 0;
+        }
+        if(reader->capacity - reader->end < LINE_READER_BLOCK){ // Growing the buffer for a long line
+            char *buffer = realloc(reader->buffer, reader->capacity*2 + 1);
+            if(buffer==NULL){
+                perror("Unable to read input!"); // Outputting error message
+                return NULL;
+            }
+            reader->buffer = buffer;
+            reader->capacity *= 2;
+        }
+
+        ssize_t bytes = read(reader->fd, reader->buffer + reader->end, reader->capacity - reader->end); // Reading the next block
+        if(bytes==-1 && errno==EINTR){
+            continue;
+        }else if(bytes<=0){
+            if(bytes==-1){
+                perror("Unable to read input!"); // Outputting error message
+            }
+            reader->eof = true;
+        }else{
+            reader->end += bytes;
+        }
+    }
+}
+
+#define TRIE_NONE UINT32_MAX // The index of no trie node
+
+struct trie_node{ // Defining the structure of a node of the command trie, one per byte of a name
+    uint32_t child; // The first child, children being sorted by byte
+    uint32_t sibling; // The next child of the parent
+    uint32_t parent;
+    uint32_t count; // The number of names ending at or below this node
+    uint32_t refs; // The number of sources (directories of $PATH, the builtins) providing the name ending here
+    unsigned char byte;
+};
+
+struct completion_dir{ // Defining the structure of a directory of $PATH, as seen by completion
+    char *path;
+    struct timespec mtime; // The modification time when the directory was last read
+    bool loaded;
+    uint32_t *names; // The trie nodes of the names found in it
+    size_t name_count;
+};
+
+struct completion_trie{ // Defining the structure of the command names known to completion, kept up to date one directory at a time
+    struct trie_node *nodes; // Node 0 is the root, the empty name
+    size_t node_count;
+    size_t capacity;
+    char *path_value; // A copy of $PATH, used to detect changes to it
+    struct completion_dir *dirs;
+    int dir_count;
+    bool builtins; // Whether the builtins were added
+};
+
+struct completion_trie completion_trie = {NULL, 0, 0, NULL, NULL, 0, false};
+
+uint32_t trie_insert(struct completion_trie *trie, const char *name){ // Creating a function to add a reference to a name, returning its node or TRIE_NONE
+
+    if(trie->nodes==NULL){
+        trie->nodes = calloc(1024, sizeof(struct trie_node));
+        if(trie->nodes==NULL){
+            return TRIE_NONE;
+        }
+        trie->capacity = 1024;
+        trie->node_count = 1;
+        trie->nodes[0] = (struct trie_node){TRIE_NONE, TRIE_NONE, TRIE_NONE, 0, 0, 0};
+    }
+
+    uint32_t node = 0;
+    for(const unsigned char *c=(const unsigned char*)name; *c!='\0'; c++){
+        uint32_t *link = &trie->nodes[node].child; // Finding the child for the byte, or where it belongs in order
+        while(*link!=TRIE_NONE && trie->nodes[*link].byte<*c){
+            link = &trie->nodes[*link].sibling;
+        }
+        if(*link==TRIE_NONE || trie->nodes[*link].byte!=*c){
+            if(trie->node_count==trie->capacity){
+                struct trie_node *nodes = realloc(trie->nodes, trie->capacity * 2 * sizeof(struct trie_node));
+                if(nodes==NULL){
+                    return TRIE_NONE;
+                }
+                link = (uint32_t*)((char*)nodes + ((char*)link - (char*)trie->nodes)); // The link lives inside the moved array
+                trie->nodes = nodes;
+                trie->capacity *= 2;
+            }
+            uint32_t added = trie->node_count++;
+            trie->nodes[added] = (struct trie_node){TRIE_NONE, *link, node, 0, 0, *c};
+            *link = added;
+        }
+        node = *link;
+    }
+
+    if(trie->nodes[node].refs++==0){ // A new name counts for every node above it
+        for(uint32_t n=node; n!=TRIE_NONE; n=trie->nodes[n].parent){
+            trie->nodes[n].count++;
+        }
+    }
+    return node;
+}
+
+void trie_release(struct completion_trie *trie, uint32_t node){ // Creating a function to drop a reference to a name, which disappears with the last one
+    if(--trie->nodes[node].refs==0){
+        for(uint32_t n=node; n!=TRIE_NONE; n=trie->nodes[n].parent){
+            trie->nodes[n].count--;
+        }
+    }
+}
+
+uint32_t trie_find(const struct completion_trie *trie, const char *prefix, size_t length){ // Creating a function to find the node of a prefix, or TRIE_NONE
+
+    if(trie->nodes==NULL){
+        return TRIE_NONE;
+    }
+    uint32_t node = 0;
+    for(size_t i=0; i<length && node!=TRIE_NONE; i++){
+        node = trie->nodes[node].child;
+        while(node!=TRIE_NONE && trie->nodes[node].byte<(unsigned char)prefix[i]){
+            node = trie->nodes[node].sibling;
+        }
+        if(node!=TRIE_NONE && trie->nodes[node].byte!=(unsigned char)prefix[i]){
+            node = TRIE_NONE;
+        }
+    }
+    return node!=TRIE_NONE && trie->nodes[node].count>0 ? node : TRIE_NONE;
+}
+
+void completion_dir_load(struct completion_trie *trie, struct completion_dir *dir){ // Creating a function to replace the names of a directory with the executables it holds now
+
+    for(size_t i=0; i<dir->name_count; i++){
+        trie_release(trie, dir->names[i]);
+    }
+    dir->name_count = 0;
+
+    DIR *stream = opendir(dir->path);
+    if(stream==NULL){
+        return;
+    }
+    size_t capacity = 0;
+    struct dirent *entry;
+    while((entry = readdir(stream))!=NULL){
+        if(entry->d_name[0]=='.' || (entry->d_type!=DT_REG && entry->d_type!=DT_LNK && entry->d_type!=DT_UNKNOWN)){
+            continue;
+        }
+        struct stat info;
+        if(fstatat(dirfd(stream), entry->d_name, &info, 0)==-1 || !S_ISREG(info.st_mode) || (info.st_mode & 0111)==0){ // Only executables are commands
+            continue;
+        }
+        if(dir->name_count==capacity){
+            capacity = capacity>0 ? capacity * 2 : 256;
+            uint32_t *names = realloc(dir->names, capacity * sizeof(uint32_t));
+            if(names==NULL){
+                break;
+            }
+            dir->names = names;
+        }
+        uint32_t node = trie_insert(trie, entry->d_name);
+        if(node!=TRIE_NONE){
+            dir->names[dir->name_count++] = node;
+        }
+    }
+    closedir(stream);
+}
+
+void completion_refresh(struct completion_trie *trie){ // Creating a function to bring the command trie up to date, reading only the directories which changed
+
+    if(!trie->builtins){ // The builtins never change
+        for(size_t i=0; i<sizeof(builtin_list) / sizeof(builtin_list[0]); i++){
+            trie_insert(trie, builtin_list[i].name);
+        }
+        trie->builtins = true;
+    }
+
+    const char *path = getenv("PATH");
+    if(path==NULL){ // Using the same default as the command hash
+        path = "/bin:/usr/bin";
+    }
+    if(trie->path_value==NULL || strcmp(trie->path_value, path)!=0){ // Starting again with the directories of the new $PATH
+        for(int i=0; i<trie->dir_count; i++){
+            for(size_t n=0; n<trie->dirs[i].name_count; n++){
+                trie_release(trie, trie->dirs[i].names[n]);
+            }
+            free(trie->dirs[i].names);
+            free(trie->dirs[i].path);
+        }
+        free(trie->dirs);
+        free(trie->path_value);
+        trie->dir_count = 0;
+        trie->path_value = strdup(path);
+        int dirCount = 1;
+        for(const char *c=path; *c!='\0'; c++){
+            dirCount += *c==':';
+        }
+        trie->dirs = trie->path_value!=NULL ? calloc(dirCount, sizeof(struct completion_dir)) : NULL;
+        if(trie->dirs==NULL){
+            return;
+        }
+        const char *start = path;
+        for(int i=0; i<dirCount; i++){
+            size_t length = strcspn(start, ":");
+            trie->dirs[i].path = length>0 ? strndup(start, length) : strdup(".");
+            start += length + 1;
+        }
+        trie->dir_count = dirCount;
+    }
+
+    for(int i=0; i<trie->dir_count; i++){ // A 'stat' per directory is all an unchanged $PATH costs
+        struct completion_dir *dir = &trie->dirs[i];
+        struct stat info;
+        if(dir->path==NULL || stat(dir->path, &info)==-1){
+            info.st_mtim.tv_sec = 0;
+            info.st_mtim.tv_nsec = 0;
+        }
+        if(!dir->loaded || dir->mtime.tv_sec!=info.st_mtim.tv_sec || dir->mtime.tv_nsec!=info.st_mtim.tv_nsec){
+            dir->mtime = info.st_mtim; // Recorded before reading, so a change made meanwhile is seen next time
+            dir->loaded = true;
+            completion_dir_load(trie, dir);
+        }
+    }
+}
+
+struct completion{ // Defining the structure of a completion, what it is asked and what it found
+    const char *line; // The line, completed at 'cursor'
+    size_t cursor;
+    size_t limit; // The number of candidates passed to 'callback' at most
+    void (*callback)(void *data, const char *candidate);
+    void *data;
+    size_t word_start; // Where the word being completed starts
+    char common[PATH_MAX]; // The longest text every candidate starts with
+    size_t count; // The number of candidates
+};
+
+void completion_add(struct completion *completion, const char *candidate){ // Creating a function to record a candidate, narrowing the common text
+
+    if(completion->count==0){
+        snprintf(completion->common, sizeof(completion->common), "%s", candidate);
+    }else{
+        size_t same = 0;
+        while(completion->common[same]!='\0' && completion->common[same]==candidate[same]){
+            same++;
+        }
+        completion->common[same] = '\0';
+    }
+    if(completion->count<completion->limit && completion->callback!=NULL){
+        completion->callback(completion->data, candidate);
+    }
+    completion->count++;
+}
+
+void complete_commands(struct completion *completion, uint32_t node, char *name, size_t length){ // Creating a function to pass every name below a trie node, in order
+
+    const struct trie_node *nodes = completion_trie.nodes;
+    if(nodes[node].refs>0){
+        name[length] = '\0';
+        completion_add(completion, name);
+    }
+    for(uint32_t child=nodes[node].child; child!=TRIE_NONE && completion->count<completion->limit; child=nodes[child].sibling){
+        if(nodes[child].count>0 && length+1<PATH_MAX){
+            name[length] = nodes[child].byte;
+            complete_commands(completion, child, name, length + 1);
+        }
+    }
+}
+
+void complete_files(struct completion *completion, const char *word, size_t length){ // Creating a function to pass every file whose path starts with a word, directories ending with '/'
+
+    const char *slash = memrchr(word, '/', length);
+    size_t dirLength = slash!=NULL ? (size_t)(slash - word + 1) : 0;
+    char dirPath[PATH_MAX];
+    snprintf(dirPath, sizeof(dirPath), "%.*s", dirLength>0 ? (int)dirLength : 1, dirLength>0 ? word : ".");
+    const char *base = word + dirLength;
+    size_t baseLength = length - dirLength;
+
+    DIR *stream = opendir(dirPath);
+    if(stream==NULL){
+        return;
+    }
+    char **candidates = NULL; // Sorted before they are passed on, like the commands of the trie
+    size_t count = 0;
+    size_t capacity = 0;
+    struct dirent *entry;
+    while((entry = readdir(stream))!=NULL){
+        if(strncmp(entry->d_name, base, baseLength)!=0 || (entry->d_name[0]=='.' && (baseLength==0 || base[0]!='.'))){ // Hidden files only when asked for
+            continue;
+        }
+        if(strcmp(entry->d_name,".")==0 || strcmp(entry->d_name,"..")==0){
+            continue;
+        }
+        bool directory = entry->d_type==DT_DIR;
+        if(entry->d_type==DT_LNK || entry->d_type==DT_UNKNOWN){ // Following links to directories
+            struct stat info;
+            directory = fstatat(dirfd(stream), entry->d_name, &info, 0)==0 && S_ISDIR(info.st_mode);
+        }
+        if(count==capacity){
+            capacity = capacity>0 ? capacity * 2 : 64;
+            char **grown = realloc(candidates, capacity * sizeof(char*));
+            if(grown==NULL){
+                break;
+            }
+            candidates = grown;
+        }
+        if(asprintf(&candidates[count], "%.*s%s%s", (int)dirLength, word, entry->d_name, directory ? "/" : "")!=-1){
+            count++;
+        }
+    }
+    closedir(stream);
+
+    qsort(candidates, count, sizeof(char*), compare_strings);
+    for(size_t i=0; i<count; i++){
+        completion_add(completion, candidates[i]);
+        free(candidates[i]);
+    }
+    free(candidates);
+}
+
+void complete(struct completion *completion){ // Creating a function to find the commands or files which can complete the word before the cursor
+
+    const char *line = completion->line;
+    size_t start = completion->cursor;
+    while(start>0 && line[start-1]!=' ' && line[start-1]!='\t' && line[start-1]!='|' && line[start-1]!='&' && line[start-1]!='<' && line[start-1]!='>'){
+        start--;
+    }
+    completion->word_start = start;
+    completion->count = 0;
+    completion->common[0] = '\0';
+
+    size_t before = start; // A command is expected at the start of the line and after an operator
+    while(before>0 && (line[before-1]==' ' || line[before-1]=='\t')){
+        before--;
+    }
+    bool command = before==0 || line[before-1]=='|' || line[before-1]=='&';
+    const char *word = line + start;
+    size_t length = completion->cursor - start;
+
+    if(command && memchr(word, '/', length)==NULL){ // Commands come from the trie
+        completion_refresh(&completion_trie);
+        uint32_t node = trie_find(&completion_trie, word, length);
+        if(node==TRIE_NONE){
+            return;
+        }
+        char name[PATH_MAX];
+        memcpy(name, word, length);
+        complete_commands(completion, node, name, length);
+
+        completion->count = completion_trie.nodes[node].count; // Also counting the names which were not listed
+        size_t commonLength = length; // Following the trie while there is a single way down
+        memcpy(completion->common, word, length);
+        for(uint32_t n=node; completion_trie.nodes[n].refs==0 && commonLength+1<sizeof(completion->common); ){
+            uint32_t next = TRIE_NONE;
+            for(uint32_t child=completion_trie.nodes[n].child; child!=TRIE_NONE; child=completion_trie.nodes[child].sibling){
+                if(completion_trie.nodes[child].count>0){
+                    if(next!=TRIE_NONE){
+                        next = TRIE_NONE;
+                        break;
+                    }
+                    next = child;
+                }
+            }
+            if(next==TRIE_NONE){
+                break;
+            }
+            completion->common[commonLength++] = completion_trie.nodes[next].byte;
+            n = next;
+        }
+        completion->common[commonLength] = '\0';
+        return;
+    }
+    complete_files(completion, word, length);
+}
+
+size_t tinyshell_complete(const char *line, size_t cursor, void (*callback)(void *data, const char *candidate), void *data){
+
+    struct completion completion = {line, cursor, SIZE_MAX, callback, data, 0, "", 0};
+    complete(&completion);
+    return completion.count;
+}
+
+enum editor_key{ // Defining the keys of escape sequences, after every byte value
+    KEY_UP = 256,
+    KEY_DOWN,
+    KEY_RIGHT,
+    KEY_LEFT,
+    KEY_HOME,
+    KEY_END,
+    KEY_DELETE
+};
+
+struct line_editor{ // Defining the structure of the line editor of interactive sessions
+    int fd; // The terminal
+    struct termios saved; // The settings of the terminal outside of editing
+    char *buffer; // The line being edited
+    size_t length;
+    size_t capacity;
+    size_t cursor; // The offset of the cursor in 'buffer'
+    char *typed; // The line typed before browsing the history with the arrows
+    ssize_t browsing; // The offset of the history entry shown, or -1 while editing a new line
+};
+
+struct line_editor shell_editor = {.fd = -1}; // Keys like Ctrl-R are matched with CTRL() from <termios.h>
+
+int editor_read_key(struct line_editor *editor){ // Creating a function to read a key, decoding the escape sequences of the arrows and editing keys
+
+    unsigned char c;
+    ssize_t bytes;
+    while((bytes = read(editor->fd, &c, 1))==-1 && errno==EINTR){
+    }
+    if(bytes<=0){
+        return -1;
+    }
+    if(c!='\x1b'){
+        return c;
+    }
+
+    unsigned char sequence[3];
+    if(read(editor->fd, &sequence[0], 1)!=1 || read(editor->fd, &sequence[1], 1)!=1){
+        return '\x1b';
+    }
+    if(sequence[0]=='[' && sequence[1]>='0' && sequence[1]<='9'){ // 'ESC [ n ~'
+        if(read(editor->fd, &sequence[2], 1)!=1 || sequence[2]!='~'){
+            return '\x1b';
+        }
+        switch(sequence[1]){
+            case '1': case '7': return KEY_HOME;
+            case '3': return KEY_DELETE;
+            case '4': case '8': return KEY_END;
+        }
+        return '\x1b';
+    }
+    if(sequence[0]=='[' || sequence[0]=='O'){
+        switch(sequence[1]){
+            case 'A': return KEY_UP;
+            case 'B': return KEY_DOWN;
+            case 'C': return KEY_RIGHT;
+            case 'D': return KEY_LEFT;
+            case 'H': return KEY_HOME;
+            case 'F': return KEY_END;
+        }
+    }
+    return '\x1b';
+}
+
+void editor_refresh(struct line_editor *editor, const char *prompt, const char *text, size_t length, size_t cursor){ // Creating a function to redraw the prompt and a line, with the cursor at 'cursor'
+
+    size_t promptLength = strlen(prompt);
+    char *screen = malloc(promptLength + length + 64);
+    if(screen==NULL){
+        return;
+    }
+    size_t used = 0;
+    screen[used++] = '\r';
+    memcpy(screen + used, prompt, promptLength);
+    used += promptLength;
+    memcpy(screen + used, text, length);
+    used += length;
+    used += sprintf(screen + used, "\x1b[K\r"); // Clearing what is left of the old line
+    if(promptLength + cursor>0){
+        used += sprintf(screen + used, "\x1b[%zuC", promptLength + cursor);
+    }
+    if(write(STDOUT_FILENO, screen, used)==-1){ // One write per redraw, so the line never flickers
+        perror("Unable to write to terminal!"); // Outputting error message
+    }
+    free(screen);
+}
+
+bool editor_reserve(struct line_editor *editor, size_t length){ // Creating a function to make room for a line of 'length' bytes
+
+    if(length + 1<=editor->capacity){
+        return true;
+    }
+    size_t capacity = editor->capacity * 2 > length + 1 ? editor->capacity * 2 : length + 1;
+    char *buffer = realloc(editor->buffer, capacity);
+    if(buffer==NULL){
+        return false;
+    }
+    editor->buffer = buffer;
+    editor->capacity = capacity;
+    return true;
+}
+
+void editor_set(struct line_editor *editor, const char *text, size_t length){ // Creating a function to replace the line, with the cursor at its end
+    if(editor_reserve(editor, length)){
+        memmove(editor->buffer, text, length);
+        editor->length = editor->cursor = length;
+    }
+}
+
+void editor_insert(struct line_editor *editor, const char *text, size_t length){ // Creating a function to insert text at the cursor
+    if(editor_reserve(editor, editor->length + length)){
+        memmove(editor->buffer + editor->cursor + length, editor->buffer + editor->cursor, editor->length - editor->cursor);
+        memcpy(editor->buffer + editor->cursor, text, length);
+        editor->length += length;
+        editor->cursor += length;
+    }
+}
+
+void editor_delete(struct line_editor *editor, size_t from, size_t to){ // Creating a function to remove the bytes between two offsets of the line
+    memmove(editor->buffer + from, editor->buffer + to, editor->length - to);
+    editor->length -= to - from;
+    editor->cursor = from;
+}
+
+void editor_browse(struct line_editor *editor, bool older){ // Creating a function to show the previous or next history entry, keeping the line being typed
+
+    struct history *history = &shell_history;
+    ssize_t entry;
+    if(older){
+        entry = history_previous(history, editor->browsing>=0 ? (size_t)editor->browsing : history->size);
+        if(entry<0){
+            return;
+        }
+        if(editor->browsing<0){ // Keeping the new line, to come back to it
+            free(editor->typed);
+            editor->typed = strndup(editor->buffer, editor->length);
+        }
+    }else{
+        if(editor->browsing<0){
+            return;
+        }
+        entry = history_entry_end(history, editor->browsing) + 1;
+        if((size_t)entry>=history->size){ // Past the newest entry is the line being typed
+            editor->browsing = -1;
+            editor_set(editor, editor->typed!=NULL ? editor->typed : "", editor->typed!=NULL ? strlen(editor->typed) : 0);
+            return;
+        }
+    }
+    editor->browsing = entry;
+    editor_set(editor, history->data + entry, history_entry_end(history, entry) - entry);
+}
+
+int editor_search(struct line_editor *editor){ // Creating a function to search the history incrementally (Ctrl-R), returning the key which ended the search or 0 if it was cancelled
+
+    struct history *history = &shell_history;
+    char query[256] = "";
+    size_t queryLength = 0;
+    ssize_t match = -1;
+    bool failing = false;
+
+    while(true){
+        char prompt[300];
+        snprintf(prompt, sizeof(prompt), "(%sreverse-i-search)`%s': ", failing ? "failing " : "", query);
+        if(match>=0){
+            size_t end = history_entry_end(history, match);
+            const char *found = memmem(history->data + match, end - match, query, queryLength);
+            editor_refresh(editor, prompt, history->data + match, end - match, found!=NULL ? (size_t)(found - history->data - match) : 0);
+        }else{
+            editor_refresh(editor, prompt, "", 0, 0);
+        }
+
+        int key = editor_read_key(editor);
+        if(key==CTRL('r')){ // The next older match
+            ssize_t older = match>=0 ? history_search(history, query, match) : -1;
+            failing = match>=0 && older<0;
+            match = older>=0 ? older : match;
+            continue;
+        }
+        if(key==CTRL('g') || key==CTRL('c') || key==-1){ // Cancelling, the line is left as it was
+            return key==-1 ? -1 : 0;
+        }
+        if(key==127 || key==CTRL('h')){ // Searching again for the shorter text, from the newest entry
+            if(queryLength>0){
+                query[--queryLength] = '\0';
+            }
+            match = history_search(history, query, history->size);
+            failing = queryLength>0 && match<0;
+            continue;
+        }
+        if(key>=32 && key<256 && queryLength+1<sizeof(query)){ // The current match stays if it still contains the longer text
+            query[queryLength++] = key;
+            query[queryLength] = '\0';
+            ssize_t found = history_search(history, query, match>=0 ? history_entry_end(history, match) + 1 : history->size);
+            failing = found<0;
+            match = found>=0 ? found : match;
+            continue;
+        }
+
+        if(match>=0){ // Any other key takes the match into the line, and is then handled as usual
+            editor->browsing = -1;
+            editor_set(editor, history->data + match, history_entry_end(history, match) - match);
+        }
+        return key;
+    }
+}
+
+void editor_list_candidate(void *data, const char *candidate){ // Creating a function to add a candidate to the listing shown by a second Tab
+    fprintf(data, "%s  ", candidate);
+}
+
+void editor_complete(struct line_editor *editor, bool list){ // Creating a function to complete the word before the cursor (Tab), listing the candidates when 'list' is set
+
+    editor->buffer[editor->length] = '\0';
+    char *listing = NULL;
+    size_t listingLength = 0;
+    FILE *stream = list ? open_memstream(&listing, &listingLength) : NULL;
+    struct completion completion = {editor->buffer, editor->cursor, stream!=NULL ? 200 : 0, editor_list_candidate, stream, 0, "", 0};
+    complete(&completion);
+
+    size_t wordLength = editor->cursor - completion.word_start;
+    size_t commonLength = strlen(completion.common);
+    if(completion.count==0){
+        if(write(STDOUT_FILENO, "\a", 1)==-1){ // Nothing matches
+            perror("Unable to write to terminal!"); // Outputting error message
+        }
+    }else if(commonLength>wordLength){ // Completing as far as every candidate agrees
+        editor_delete(editor, completion.word_start, editor->cursor);
+        editor_insert(editor, completion.common, commonLength);
+        if(completion.count==1 && completion.common[commonLength-1]!='/'){ // A whole name, ready for its arguments
+            editor_insert(editor, " ", 1);
+        }
+    }else if(stream!=NULL){ // Showing the candidates under the line
+        if(completion.count>completion.limit){
+            fprintf(stream, "... and %zu more", completion.count - completion.limit);
+        }
+        fclose(stream);
+        stream = NULL;
+        if(write(STDOUT_FILENO, "\r\n", 2)==-1 || write(STDOUT_FILENO, listing, listingLength)==-1 || write(STDOUT_FILENO, "\r\n", 2)==-1){
+            perror("Unable to write to terminal!"); // Outputting error message
+        }
+    }
+    if(stream!=NULL){
+        fclose(stream);
+    }
+    free(listing);
+}
+
+char *edit_line(struct line_editor *editor, const char *prompt){ // Creating a function to read a line from the terminal with editing, history and search, or NULL at end-of-file
+
+    struct termios raw = editor->saved;
+    raw.c_lflag &= ~(ICANON | ECHO | ISIG | IEXTEN); // Every key is read as it is typed, Ctrl-C included
+    raw.c_iflag &= ~(IXON | ICRNL);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    tcsetattr(editor->fd, TCSADRAIN, &raw);
+
+    history_refresh(&shell_history); // Entries of other sessions are included from the next line on
+    editor->length = editor->cursor = 0;
+    editor->browsing = -1;
+    char *line = editor_reserve(editor, 0) ? editor->buffer : NULL;
+
+    int key = 0;
+    int previous = 0; // The key pressed before, a second Tab lists the candidates
+    while(line!=NULL){
+        editor_refresh(editor, prompt, editor->buffer, editor->length, editor->cursor);
+        key = key!=0 ? key : editor_read_key(editor); // A key which ended a search is handled here
+        int pressed = key;
+        key = 0;
+        bool secondTab = pressed=='\t' && previous=='\t';
+        previous = pressed;
+
+        if(pressed=='\r' || pressed=='\n'){
+            break;
+        }else if(pressed==-1 || (pressed==CTRL('d') && editor->length==0)){ // End of input
+            line = NULL;
+        }else if(pressed==CTRL('c')){ // Abandoning the line
+            if(write(STDOUT_FILENO, "^C\r\n", 4)==-1){
+                break;
+            }
+            editor->length = editor->cursor = 0;
+            editor->browsing = -1;
+        }else if(pressed==CTRL('r')){
+            key = editor_search(editor);
+            if(key==-1){
+                line = NULL;
+            }
+        }else if(pressed==127 || pressed==CTRL('h')){
+            if(editor->cursor>0){
+                editor_delete(editor, editor->cursor - 1, editor->cursor);
+            }
+        }else if(pressed==KEY_DELETE || pressed==CTRL('d')){
+            if(editor->cursor<editor->length){
+                editor_delete(editor, editor->cursor, editor->cursor + 1);
+            }
+        }else if(pressed==KEY_LEFT || pressed==CTRL('b')){
+            editor->cursor -= editor->cursor>0;
+        }else if(pressed==KEY_RIGHT || pressed==CTRL('f')){
+            editor->cursor += editor->cursor<editor->length;
+        }else if(pressed==KEY_HOME || pressed==CTRL('a')){
+            editor->cursor = 0;
+        }else if(pressed==KEY_END || pressed==CTRL('e')){
+            editor->cursor = editor->length;
+        }else if(pressed==CTRL('u')){
+            editor_delete(editor, 0, editor->cursor);
+        }else if(pressed==CTRL('k')){
+            editor->length = editor->cursor;
+        }else if(pressed==CTRL('w')){ // Deleting the word before the cursor
+            size_t start = editor->cursor;
+            while(start>0 && editor->buffer[start-1]==' '){
+                start--;
+            }
+            while(start>0 && editor->buffer[start-1]!=' '){
+                start--;
+            }
+            editor_delete(editor, start, editor->cursor);
+        }else if(pressed==CTRL('l')){
+            if(write(STDOUT_FILENO, "\x1b[H\x1b[2J", 7)==-1){
+                break;
+            }
+        }else if(pressed=='\t'){
+            editor_complete(editor, secondTab);
+        }else if(pressed==KEY_UP || pressed==CTRL('p')){
+            editor_browse(editor, true);
+        }else if(pressed==KEY_DOWN || pressed==CTRL('n')){
+            editor_browse(editor, false);
+        }else if(pressed>=32 && pressed<256 && pressed!=127){ // Text, including the bytes of UTF-8 characters
+            char c = pressed;
+            editor_insert(editor, &c, 1);
+        }
+        line = line!=NULL ? editor->buffer : NULL; // Inserting may have moved the buffer
+    }
+
+    if(line!=NULL){
+        editor->buffer[editor->length] = '\0';
+        editor_refresh(editor, prompt, editor->buffer, editor->length, editor->length);
+    }
+    if(write(STDOUT_FILENO, "\r\n", 2)==-1){
+        line = NULL;
+    }
+    tcsetattr(editor->fd, TCSADRAIN, &editor->saved);
+    return line;
+}
+
+char *trim_line(char *line){ // Creating a function to remove the blanks around a line, in place, returning NULL for blank lines and comments
+
+    line += strspn(line, " \t"); // Skipping leading blanks
+    size_t length = strlen(line);
+    while(length>0 && (line[length-1]==' ' || line[length-1]=='\t' || line[length-1]=='\r')){ // Removing trailing blanks
+        line[--length] = '\0';
+    }
+    if(length==0 || line[0]=='#'){ // Blank lines and comments (including '#!') are skipped
+        return NULL;
+    }
+    return line;
+}
+
+int run_line(char *line){ // Creating a function to execute one line of input
+
+    line = trim_line(line);
+    if(line==NULL){
+        return current_shell->last_status;
+    }
+
+    int status = execute_shell_command(line); // Executing the command(s) inputted
+    fflush(stdout); // Output of builtins must appear before the output of the next command
+    return status;
+}
+
+struct stream_source{ // Defining where 'run_stream' reads lines from, for the here-documents of a line too
+    struct line_reader *reader;
+    struct line_editor *editor; // The line editor of a terminal, or NULL
+    bool interactive;
+};
+
+char *stream_next_line(void *data){ // Creating a function to read the next line of a stream, prompting with '> ' on a terminal
+    struct stream_source *source = data;
+    if(source->editor!=NULL){
+        return edit_line(source->editor, "> ");
+    }
+    if(source->interactive){
+        printf("> ");
+        fflush(stdout);
+    }
+    return read_line(source->reader);
+}
+
+int run_stream(int fd, bool interactive){ // Creating a function to execute every line read from a file descriptor
+
+    if(interactive){
+        job_control_init(true); // Reaping children from the event loop, with job control for terminals
+    }
+    struct line_reader reader;
+    if(!line_reader_open(&reader, fd)){
+        perror("Unable to read input!"); // Outputting error message
+        return EXIT_FAILURE;
+    }
+    struct line_editor *editor = &shell_editor; // Terminals get line editing and the history
+    bool editing = interactive && tcgetattr(fd, &editor->saved)==0;
+    if(editing){
+        editor->fd = fd;
+        history_open(&shell_history);
+    }
+    struct stream_source source = {&reader, editing ? editor : NULL, interactive};
+    struct parser *parser = &current_shell->parser;
+    char *(*previousNextLine)(void*) = parser->next_line; // Restored at the end, as streams can be nested by an embedding program
+    void *previousData = parser->next_line_data;
+    parser->next_line = stream_next_line;
+    parser->next_line_data = &source;
+
+    while(true){
+        notify_jobs(interactive); // Reaping finished background jobs before the next line
+
+        if(interactive && !editing){
+            printf("TinyShell>$ "); // Prompt to show user that shell is waiting for input
+            fflush(stdout);
+        }
+
+        long long started = TRACE_START();
+        char *line = editing ? edit_line(editor, "TinyShell>$ ") : read_line(&reader); // Reading input from user
+        TRACE(TRACE_READ_LINE, started, getpid(), NULL, line!=NULL ? (int)strlen(line) : -1);
+        if(line==NULL){ // End of input
+            if(interactive && !editing){
+                printf("\n");
+            }
+            break;
+        }
+        if(editing && line[strspn(line, " \t")]!='\0'){
+            history_add(&shell_history, line);
+        }
+        run_line(line);
+        if(current_shell->exit_requested){
+            break;
+        }
+    }
+
+    parser->next_line = previousNextLine;
+    parser->next_line_data = previousData;
+    line_reader_close(&reader);
+    return current_shell->last_status;
+}
+
+char *string_next_line(void *data){ // Creating a function to split the next line off a string, in place, or NULL at its end
+    char **next = data;
+    char *line = *next;
+    if(line!=NULL){
+        char *newline = strchr(line, '\n');
+        if(newline!=NULL){
+            *newline = '\0';
+        }
+        *next = newline!=NULL ? newline + 1 : NULL;
+    }
+    return line;
+}
+
+int run_string(const char *commands){ // Creating a function to execute every line of a string (used by '-c')
+
+    char *copy = strdup(commands);
+    if(copy==NULL){
+        perror("Unable to read input!"); // Outputting error message
+        return EXIT_FAILURE;
+    }
+
+    char *next = copy;
+    struct parser *parser = &current_shell->parser;
+    char *(*previousNextLine)(void*) = parser->next_line;
+    void *previousData = parser->next_line_data;
+    parser->next_line = string_next_line; // Here-documents take the lines after their command
+    parser->next_line_data = &next;
+    char *line;
+    while(!current_shell->exit_requested && (line = string_next_line(&next))!=NULL){ // Looping through the lines of the string
+        run_line(line);
+    }
+    parser->next_line = previousNextLine;
+    parser->next_line_data = previousData;
+
+    free(copy);
+    return current_shell->last_status;
+}
+
+void arena_free(struct arena *arena){ // Creating a function to release every block of an arena
+
+    struct arena_block *block = arena->head;
+    while(block!=NULL){
+        struct arena_block *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head = NULL;
+    arena->current = NULL;
+}
+
+void parser_free(struct parser *parser){ // Creating a function to release the memory of a parser
+
+    arena_free(&parser->arena);
+    free(parser->word);
+    free(parser->pattern);
+    free(parser->flags);
+    free(parser->words);
+    free(parser->stages);
+}
+
+#define SCRIPT_CACHE_MAGIC "TSHSCR2" // Identifying a compiled script, and the version of its layout
+#define SCRIPT_NULL UINT32_MAX // The string offset standing for NULL
+#define SCRIPT_MAX_SIZE (1UL << 30) // Larger scripts are run without being compiled, so every offset fits in 32 bits
+
+enum script_statement{ // Defining the kinds of statements of a compiled script
+    STATEMENT_LIST, // A command list, stored as its pipelines
+    STATEMENT_ERROR // A line which does not parse, stored as written and run when it is reached, so that its error is reported then
+};
+
+struct script_header{ // Defining the structure at the start of a compiled script, its code and then its strings following it
+    char magic[8];
+    uint64_t size; // The size of the script file which was compiled
+    int64_t mtime_sec; // Its modification time: while it and the size and inode match, the script file is not even read
+    int64_t mtime_nsec;
+    uint64_t inode;
+    uint64_t hash; // The FNV-1a hash of the script file, so a file touched without being changed is not compiled again
+    uint64_t code_size; // The number of bytes of code
+    uint64_t strings_size; // The number of bytes of strings, every one of them ending with '\0'
+    uint64_t checksum; // The FNV-1a hash of the code and the strings, so a damaged file is compiled again instead of being decoded
+};
+
+struct script_code{ // Defining the structure of a script being compiled, whose code and strings grow separately
+    unsigned char *code; // The statements, as a flat sequence of counts, values and string offsets, each a variable-length number
+    size_t code_size;
+    size_t code_capacity;
+    char *strings; // The words, file names and texts of the statements, each stored once
+    size_t strings_size;
+    size_t strings_capacity;
+    uint32_t *interned; // An open-addressing table of the offsets of 'strings' plus one, 0 marking a free slot
+    size_t interned_count;
+    size_t interned_capacity; // A power of two
+};
+
+struct script_reader{ // Defining the state of the decoding of a compiled script
+    const unsigned char *code;
+    size_t code_size;
+    size_t next; // The offset of the next number of 'code'
+    char *strings; // Writable, as builtins may change their arguments in place
+    size_t strings_size;
+    bool damaged; // Whether the code went past its end or referred to a string that does not exist
+};
+
+unsigned long hash_bytes(const char *bytes, size_t length){ // Creating a function to hash a buffer (FNV-1a)
+
+    unsigned long hash = 14695981039346656037UL;
+    for(size_t i=0; i<length; i++){
+        hash = (hash ^ (unsigned char)bytes[i]) * 1099511628211UL;
+    }
+    return hash;
+}
+
+void script_emit(struct script_code *script, uint32_t word){ // Creating a function to append a number to the code of a script, 7 bits per byte (LEB128) as most are small
+    script->code = grow_scratch(script->code, &script->code_capacity, script->code_size + 5, 1);
+    while(word>=0x80){
+        script->code[script->code_size++] = (unsigned char)(word | 0x80);
+        word >>= 7;
+    }
+    script->code[script->code_size++] = (unsigned char)word;
+}
+
+void script_emit_string(struct script_code *script, const char *string){ // Creating a function to append a string to a script, its offset going into the code
+    if(string==NULL){
+        script_emit(script, SCRIPT_NULL);
+        return;
+    }
+    size_t length = strlen(string) + 1;
+    if(script->interned_count * 2>=script->interned_capacity){ // Growing the table at half full, so probes stay short
+        size_t capacity = script->interned_capacity>0 ? script->interned_capacity * 2 : 1024;
+        uint32_t *interned = calloc(capacity, sizeof(uint32_t));
+        if(interned==NULL){
+            perror("Unable to allocate memory!"); // Outputting error message
+            exit(EXIT_FAILURE);
+        }
+        for(size_t i=0; i<script->interned_capacity; i++){
+            if(script->interned[i]!=0){
+                size_t slot = hash_string(script->strings + script->interned[i] - 1) & (capacity - 1);
+                while(interned[slot]!=0){
+                    slot = (slot + 1) & (capacity - 1);
+                }
+                interned[slot] = script->interned[i];
+            }
+        }
+        free(script->interned);
+        script->interned = interned;
+        script->interned_capacity = capacity;
+    }
+    size_t slot = hash_string(string) & (script->interned_capacity - 1);
+    while(script->interned[slot]!=0){ // Words like 'echo' or '/dev/null' come back on many lines
+        if(strcmp(script->strings + script->interned[slot] - 1, string)==0){
+            script_emit(script, script->interned[slot] - 1);
+            return;
+        }
+        slot = (slot + 1) & (script->interned_capacity - 1);
+    }
+    script->interned[slot] = (uint32_t)script->strings_size + 1;
+    script->interned_count++;
+    script->strings = grow_scratch(script->strings, &script->strings_capacity, script->strings_size + length, 1);
+    memcpy(script->strings + script->strings_size, string, length);
+    script_emit(script, (uint32_t)script->strings_size);
+    script->strings_size += length;
+}
+
+void script_emit_limit(struct script_code *script, rlim_t value){ // Creating a function to append a resource limit, as two numbers as it has 64 bits
+    script_emit(script, (uint32_t)value);
+    script_emit(script, (uint32_t)((uint64_t)value >> 32));
+}
+
+void script_emit_sched(struct script_code *script, const struct stage_sched *sched){ // Creating a function to append the 'sched' options of a stage to a script
+
+    script_emit(script, sched!=NULL);
+    if(sched==NULL){
+        return;
+    }
+    script_emit(script, sched->pinned ? CPU_COUNT(&sched->cpus) : 0);
+    for(int cpu=0; sched->pinned && cpu<CPU_SETSIZE; cpu++){
+        if(CPU_ISSET(cpu, &sched->cpus)){
+            script_emit(script, cpu);
+        }
+    }
+    script_emit(script, sched->niced ? sched->nice + 21 : 0); // Shifted, so that every niceness is positive
+    script_emit(script, sched->policy + 1);
+    script_emit(script, sched->priority);
+    script_emit(script, sched->limit_count);
+    for(int i=0; i<sched->limit_count; i++){
+        script_emit(script, sched->limits[i].resource);
+        script_emit_limit(script, sched->limits[i].limit.rlim_cur);
+        script_emit_limit(script, sched->limits[i].limit.rlim_max);
+    }
+}
+
+void script_emit_memo(struct script_code *script, const struct memo_options *memo){ // Creating a function to append the 'memo' options of a pipeline to a script
+
+    script_emit(script, memo->input_count);
+    for(int i=0; i<memo->input_count; i++){
+        script_emit_string(script, memo->inputs[i]);
+    }
+    script_emit(script, memo->variable_count);
+    for(int i=0; i<memo->variable_count; i++){
+        script_emit_string(script, memo->variables[i]);
+    }
+}
+
+void script_emit_watch(struct script_code *script, const struct watch_options *watch){ // Creating a function to append the 'watch' options of a pipeline to a script
+
+    script_emit(script, watch->path_count);
+    for(int i=0; i<watch->path_count; i++){
+        script_emit_string(script, watch->paths[i]);
+    }
+    script_emit(script, watch->delay);
+}
+
+void script_emit_list(struct script_code *script, const struct shell_pipeline *list){ // Creating a function to append a parsed command list to a script
+
+    uint32_t count = 0;
+    for(const struct shell_pipeline *pipeline = list; pipeline!=NULL; pipeline = pipeline->next){
+        count++;
+    }
+    script_emit(script, STATEMENT_LIST);
+    script_emit(script, count);
+    for(const struct shell_pipeline *pipeline = list; pipeline!=NULL; pipeline = pipeline->next){
+        script_emit(script, pipeline->background | pipeline->timed << 1 | pipeline->time_json << 2 | pipeline->batch << 3 | pipeline->spread << 4 | (pipeline->memo!=NULL) << 5 | (pipeline->watch!=NULL) << 6);
+        script_emit(script, pipeline->then);
+        script_emit(script, (uint32_t)pipeline->pipe_size);
+        script_emit_string(script, pipeline->text);
+        if(pipeline->memo!=NULL){
+            script_emit_memo(script, pipeline->memo);
+        }
+        if(pipeline->watch!=NULL){
+            script_emit_watch(script, pipeline->watch);
+        }
+        script_emit(script, pipeline->stage_count);
+        for(int s=0; s<pipeline->stage_count; s++){
+            const struct shell_command *stage = &pipeline->stages[s];
+            script_emit(script, stage->argc);
+            for(int a=0; a<stage->argc; a++){
+                script_emit_string(script, stage->argv[a]);
+            }
+            script_emit(script, stage->word_flags!=NULL);
+            for(int a=0; stage->word_flags!=NULL && a<stage->argc; a++){
+                script_emit(script, stage->word_flags[a]);
+            }
+            script_emit_sched(script, stage->sched);
+            uint32_t redirections = 0;
+            for(const struct redirection *r = stage->redirections; r!=NULL; r = r->next){
+                redirections++;
+            }
+            script_emit(script, redirections);
+            for(const struct redirection *r = stage->redirections; r!=NULL; r = r->next){
+                script_emit(script, r->type);
+                script_emit(script, (uint32_t)r->fd);
+                script_emit(script, (uint32_t)r->source_fd);
+                script_emit_string(script, r->target);
+                script_emit(script, r->target_flags);
+            }
+        }
+    }
+}
+
+void script_compile(struct script_code *script, char *source){ // Creating a function to parse every line of a script into its code
+
+    struct parser parser = {0};
+    parser.quiet = true; // Errors are reported when their line is reached, after the lines before it ran
+    char *next = source;
+    parser.next_line = string_next_line; // Here-documents take the lines after their command
+    parser.next_line_data = &next;
+    char *line;
+    while((line = string_next_line(&next))!=NULL){
+        line = trim_line(line);
+        if(line==NULL){
+            continue;
+        }
+        struct shell_pipeline *list = prepare_pipeline(&parser, line);
+        if(list==NULL){
+            script_emit(script, STATEMENT_ERROR);
+            script_emit_string(script, line);
+        }else if(list->stage_count>0){
+            script_emit_list(script, list);
+        }
+    }
+    parser_free(&parser);
+}
+
+uint32_t script_word(struct script_reader *reader){ // Creating a function to read the next number of a compiled script
+
+    uint32_t word = 0;
+    for(int shift=0; shift<35; shift+=7){
+        if(reader->next>=reader->code_size){
+            break;
+        }
+        unsigned char byte = reader->code[reader->next++];
+        word |= (uint32_t)(byte & 0x7F) << shift;
+        if(byte<0x80){
+            return word;
+        }
+    }
+    reader->damaged = true;
+    return 0;
+}
+
+uint32_t script_count(struct script_reader *reader){ // Creating a function to read a count, which cannot exceed the bytes left
+    uint32_t count = script_word(reader);
+    if(count>reader->code_size - reader->next){
+        reader->damaged = true;
+        return 0;
+    }
+    return count;
+}
+
+char *script_string(struct script_reader *reader){ // Creating a function to read a string of a compiled script, or NULL
+    uint32_t offset = script_word(reader);
+    if(offset==SCRIPT_NULL){
+        return NULL;
+    }
+    if(offset>=reader->strings_size){
+        reader->damaged = true;
+        return NULL;
+    }
+    return reader->strings + offset;
+}
+
+bool script_word_valid(const char *word, unsigned char flags){ // Creating a function to check that a word of a compiled script is encoded as 'expand_variables' expects
+
+    if(word==NULL || (flags & ~(WORD_GLOB | WORD_VARIABLE | WORD_QUOTED))!=0){
+        return false;
+    }
+    if(!(flags & WORD_VARIABLE)){
+        return true;
+    }
+    for(const char *c=word; *c!='\0'; c++){
+        if(*c=='\\' && c[1]!='\0'){
+            c++;
+        }else if(*c=='$' && c[1]=='('){ // '$(<length>:command)', the command being skipped
+            char *command;
+            if(!isdigit((unsigned char)c[2])){
+                return false;
+            }
+            size_t commandLength = strtoul(c + 2, &command, 10);
+            if(*command!=':' || strnlen(command + 1, commandLength)<commandLength){
+                return false;
+            }
+            c = command + commandLength;
+        }else if(*c=='$'){ // '${NAME}'
+            if(c[1]!='{' || (c = strchr(c, '}'))==NULL){
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+rlim_t script_limit(struct script_reader *reader){ // Creating a function to read a resource limit of a compiled script
+    uint64_t low = script_word(reader);
+    return (rlim_t)(low | (uint64_t)script_word(reader) << 32);
+}
+
+struct stage_sched *script_load_sched(struct script_reader *reader, struct arena *arena){ // Creating a function to rebuild the 'sched' options of a stage, or NULL
+
+    if(script_word(reader)==0){
+        return NULL;
+    }
+    struct stage_sched *sched = arena_alloc(arena, sizeof(struct stage_sched));
+    CPU_ZERO(&sched->cpus);
+    uint32_t cpus = script_count(reader);
+    sched->pinned = cpus>0;
+    for(uint32_t i=0; i<cpus; i++){
+        uint32_t cpu = script_word(reader);
+        if(cpu<CPU_SETSIZE){
+            CPU_SET(cpu, &sched->cpus);
+        }
+    }
+    uint32_t nice = script_word(reader);
+    sched->niced = nice>0;
+    sched->nice = (int)nice - 21;
+    sched->policy = (int)script_word(reader) - 1;
+    sched->priority = (int)script_word(reader);
+    uint32_t limits = script_word(reader);
+    sched->limit_count = limits<=SCHED_MAX_LIMITS ? (int)limits : 0;
+    reader->damaged = reader->damaged || limits>SCHED_MAX_LIMITS;
+    for(int i=0; i<sched->limit_count; i++){
+        sched->limits[i].resource = (int)script_word(reader);
+        sched->limits[i].limit.rlim_cur = script_limit(reader);
+        sched->limits[i].limit.rlim_max = script_limit(reader);
+    }
+    return sched;
+}
+
+struct memo_options *script_load_memo(struct script_reader *reader, struct arena *arena){ // Creating a function to rebuild the 'memo' options of a pipeline
+
+    struct memo_options *memo = arena_alloc(arena, sizeof(struct memo_options));
+    memo->input_count = (int)script_count(reader);
+    memo->inputs = arena_alloc(arena, (memo->input_count + 1) * sizeof(char*));
+    for(int i=0; i<memo->input_count; i++){
+        memo->inputs[i] = script_string(reader);
+        reader->damaged = reader->damaged || memo->inputs[i]==NULL;
+    }
+    memo->variable_count = (int)script_count(reader);
+    memo->variables = arena_alloc(arena, (memo->variable_count + 1) * sizeof(char*));
+    for(int i=0; i<memo->variable_count; i++){
+        memo->variables[i] = script_string(reader);
+        reader->damaged = reader->damaged || memo->variables[i]==NULL;
+    }
+    return memo;
+}
+
+struct watch_options *script_load_watch(struct script_reader *reader, struct arena *arena){ // Creating a function to rebuild the 'watch' options of a pipeline
+
+    struct watch_options *watch = arena_alloc(arena, sizeof(struct watch_options));
+    watch->path_count = (int)script_count(reader);
+    watch->paths = arena_alloc(arena, (watch->path_count + 1) * sizeof(char*));
+    for(int i=0; i<watch->path_count; i++){
+        watch->paths[i] = script_string(reader);
+        reader->damaged = reader->damaged || watch->paths[i]==NULL;
+    }
+    watch->delay = (int)script_word(reader);
+    return watch;
+}
+
+struct shell_pipeline *script_load_list(struct script_reader *reader, struct arena *arena){ // Creating a function to rebuild a command list from a compiled script, its words staying in the script
+
+    struct shell_pipeline *list = NULL;
+    struct shell_pipeline **link = &list;
+    uint32_t count = script_count(reader);
+    for(uint32_t i=0; i<count && !reader->damaged; i++){
+        struct shell_pipeline *pipeline = arena_alloc(arena, sizeof(struct shell_pipeline));
+        uint32_t flags = script_word(reader);
+        pipeline->background = flags & 1;
+        pipeline->timed = flags & 2;
+        pipeline->time_json = flags & 4;
+        pipeline->batch = flags & 8;
+        pipeline->spread = flags & 16;
+        uint32_t then = script_word(reader);
+        pipeline->then = then==LIST_AND ? LIST_AND : then==LIST_OR ? LIST_OR : LIST_SEQUENCE;
+        pipeline->pipe_size = (int)script_word(reader);
+        pipeline->text = script_string(reader);
+        pipeline->memo = flags & 32 ? script_load_memo(reader, arena) : NULL;
+        pipeline->watch = flags & 64 ? script_load_watch(reader, arena) : NULL;
+        pipeline->stage_count = (int)script_count(reader);
+        pipeline->stages = arena_alloc(arena, pipeline->stage_count * sizeof(struct shell_command));
+        pipeline->next = NULL;
+        for(int s=0; s<pipeline->stage_count && !reader->damaged; s++){
+            struct shell_command *stage = &pipeline->stages[s];
+            stage->argc = (int)script_count(reader);
+            stage->argv = arena_alloc(arena, (stage->argc + 1) * sizeof(char*));
+            for(int a=0; a<stage->argc; a++){
+                stage->argv[a] = script_string(reader);
+                reader->damaged = reader->damaged || stage->argv[a]==NULL;
+            }
+            stage->argv[stage->argc] = NULL;
+            reader->damaged = reader->damaged || stage->argc==0; // Every stage has a command, which the parser checked
+            stage->word_flags = NULL;
+            if(script_word(reader)!=0){
+                stage->word_flags = arena_alloc(arena, stage->argc + 1);
+                for(int a=0; a<stage->argc; a++){
+                    uint32_t wordFlags = script_word(reader);
+                    stage->word_flags[a] = (unsigned char)wordFlags;
+                    reader->damaged = reader->damaged || wordFlags>UCHAR_MAX || !script_word_valid(stage->argv[a], stage->word_flags[a]);
+                }
+            }
+            stage->sched = script_load_sched(reader, arena);
+            stage->redirections = NULL;
+            struct redirection **next = &stage->redirections;
+            uint32_t redirections = script_count(reader);
+            for(uint32_t r=0; r<redirections && !reader->damaged; r++){
+                struct redirection *redirection = arena_alloc(arena, sizeof(struct redirection));
+                uint32_t type = script_word(reader);
+                uint32_t fd = script_word(reader);
+                uint32_t sourceFd = script_word(reader);
+                redirection->type = type<=REDIRECT_HEREDOC ? (enum redirection_type)type : REDIRECT_IN;
+                redirection->fd = (int)(fd & INT_MAX);
+                redirection->source_fd = (int)(sourceFd & INT_MAX);
+                redirection->target = script_string(reader);
+                uint32_t targetFlags = script_word(reader);
+                redirection->target_flags = (unsigned char)targetFlags;
+                redirection->next = NULL;
+                bool unnamed = type==REDIRECT_DUP && redirection->target==NULL && targetFlags==0; // The second half of '&>file'
+                reader->damaged = reader->damaged || type>REDIRECT_HEREDOC || fd>INT_MAX || sourceFd>INT_MAX || targetFlags>UCHAR_MAX ||
+                    (!unnamed && !script_word_valid(redirection->target, redirection->target_flags));
+                *next = redirection;
+                next = &redirection->next;
+            }
+        }
+        *link = pipeline;
+        link = &pipeline->next;
+    }
+    return list;
+}
+
+bool script_check(struct script_reader *reader, struct arena *arena){ // Creating a function to decode every statement of a compiled script read from the cache, before any of them runs
+
+    while(reader->next<reader->code_size && !reader->damaged){
+        arena_reset(arena);
+        uint32_t kind = script_word(reader);
+        if(kind==STATEMENT_LIST){
+            struct shell_pipeline *list = script_load_list(reader, arena);
+            reader->damaged = reader->damaged || list==NULL || list->stage_count==0;
+        }else if(kind==STATEMENT_ERROR){
+            reader->damaged = reader->damaged || script_string(reader)==NULL;
+        }else{
+            reader->damaged = true;
+        }
+    }
+    arena_reset(arena);
+    reader->next = 0;
+    return !reader->damaged;
+}
+
+int script_execute(struct script_reader *reader){ // Creating a function to run the statements of a compiled script
+
+    struct arena arena = {0};
+    struct parser *parser = &current_shell->parser;
+    char *(*previousNextLine)(void*) = parser->next_line; // Here-documents were read when the script was compiled
+    void *previousData = parser->next_line_data;
+    parser->next_line = NULL;
+    while(!current_shell->exit_requested && reader->next<reader->code_size){
+        notify_jobs(false); // Reaping finished background jobs before the next statement
+        arena_reset(&arena);
+        if(script_word(reader)==STATEMENT_LIST){
+            execute_list(script_load_list(reader, &arena));
+        }else{
+            execute_shell_command(script_string(reader)); // Reporting the syntax error
+        }
+        fflush(stdout); // Output of builtins must appear before the output of the next command
+    }
+    parser->next_line = previousNextLine;
+    parser->next_line_data = previousData;
+    arena_free(&arena);
+    return current_shell->last_status;
+}
+
+bool make_directories(char *path){ // Creating a function to create a directory and those above it, as 'mkdir -p' does
+
+    for(char *slash = strchr(path + 1, '/'); slash!=NULL; slash = strchr(slash + 1, '/')){
+        *slash = '\0';
+        int result = mkdir(path, 0700);
+        *slash = '/';
+        if(result==-1 && errno!=EEXIST){
+            return false;
+        }
+    }
+    return mkdir(path, 0700)==0 || errno==EEXIST;
+}
+
+bool cache_directory(char *path, size_t size){ // Creating a function to find and create TINYSHELL_CACHE or ~/.cache/tinyshell, returning false when there is no cache
+
+    const char *directory = getenv("TINYSHELL_CACHE");
+    char defaultDirectory[PATH_MAX];
+    const char *cacheHome = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    if(directory==NULL && cacheHome!=NULL && cacheHome[0]=='/'){
+        snprintf(defaultDirectory, sizeof(defaultDirectory), "%s/tinyshell", cacheHome);
+        directory = defaultDirectory;
+    }else if(directory==NULL && home!=NULL){
+        snprintf(defaultDirectory, sizeof(defaultDirectory), "%s/.cache/tinyshell", home);
+        directory = defaultDirectory;
+    }
+    if(directory==NULL || directory[0]=='\0'){ // An empty TINYSHELL_CACHE turns the cache off
+        return false;
+    }
+    return snprintf(path, size, "%s", directory)<(int)size && make_directories(path);
+}
+
+bool script_cache_path(const char *script, char *path, size_t size){ // Creating a function to name the compiled form of a script, returning false when there is no cache
+
+    char resolved[PATH_MAX];
+    char directory[PATH_MAX];
+    if(realpath(script, resolved)==NULL || !cache_directory(directory, sizeof(directory))){
+        return false;
+    }
+    return snprintf(path, size, "%s/%016lx.tsc", directory, hash_string(resolved))<(int)size; // Keyed by the path, the header telling whether the file changed
+}
+
+bool script_matches(const struct script_header *header, const struct stat *info){ // Creating a function to check whether a compiled script describes the file as it is now
+    return header->size==(uint64_t)info->st_size && header->mtime_sec==info->st_mtim.tv_sec && header->mtime_nsec==info->st_mtim.tv_nsec && header->inode==(uint64_t)info->st_ino;
+}
+
+void script_describe(struct script_header *header, const struct stat *info){ // Creating a function to record the file a compiled script was made from
+    header->size = info->st_size;
+    header->mtime_sec = info->st_mtim.tv_sec;
+    header->mtime_nsec = info->st_mtim.tv_nsec;
+    header->inode = info->st_ino;
+}
+
+char *read_file(int fd, size_t size){ // Creating a function to read a whole file into a buffer ending with '\0', or NULL
+
+    char *buffer = malloc(size + 1);
+    size_t used = 0;
+    while(buffer!=NULL && used<size){
+        ssize_t bytes = read(fd, buffer + used, size - used);
+        if(bytes==-1 && errno==EINTR){
+            continue;
+        }
+        if(bytes<=0){ // The file became shorter, what was read is used
+            break;
+        }
+        used += bytes;
+    }
+    if(buffer!=NULL){
+        buffer[used] = '\0';
+    }
+    return buffer;
+}
+
+int run_script(const char *path){ // Creating a function to execute a script file, compiled once and then loaded from the cache with 'mmap'
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat info;
+    if(fd==-1 || fstat(fd, &info)==-1){
+        fprintf(stderr,"Error: Unable to open '%s': %s\n", path, strerror(errno)); // Output error message
+        if(fd!=-1){
+            close(fd);
+        }
+        return 127;
+    }
+    if(!S_ISREG(info.st_mode) || (size_t)info.st_size>SCRIPT_MAX_SIZE){ // Pipes and huge files are read line by line instead
+        int status = run_stream(fd, false);
+        close(fd);
+        return status;
+    }
+
+    char cachePath[PATH_MAX];
+    bool caching = script_cache_path(path, cachePath, sizeof(cachePath));
+    int cacheFd = caching ? open(cachePath, O_RDWR | O_CLOEXEC) : -1;
+    struct stat cacheInfo;
+    char *image = NULL; // The compiled script: a header, the code and the strings
+    size_t imageSize = 0;
+    bool mapped = false;
+    if(cacheFd!=-1 && fstat(cacheFd, &cacheInfo)==0 && (size_t)cacheInfo.st_size>=sizeof(struct script_header)){
+        image = mmap(NULL, cacheInfo.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, cacheFd, 0); // Private, so builtins changing their arguments leave the file alone
+        mapped = image!=MAP_FAILED;
+        image = mapped ? image : NULL;
+        imageSize = cacheInfo.st_size;
+    }
+    struct script_header *header = (struct script_header*)image;
+    if(mapped && (memcmp(header->magic, SCRIPT_CACHE_MAGIC, sizeof(header->magic))!=0 || header->code_size>imageSize || header->strings_size==0 || header->strings_size>imageSize ||
+        sizeof(struct script_header) + header->code_size + header->strings_size!=imageSize || image[imageSize-1]!='\0' ||
+        hash_bytes(image + sizeof(struct script_header), header->code_size + header->strings_size)!=header->checksum)){ // Another layout, or a file cut short or damaged
+        header = NULL;
+    }
+
+    char *source = NULL;
+    if(header!=NULL && !script_matches(header, &info)){ // The file was touched, it is read to see whether it changed
+        source = read_file(fd, info.st_size);
+        if(source!=NULL && hash_bytes(source, strlen(source))==header->hash){
+            struct script_header described = *header;
+            script_describe(&described, &info);
+            if(pwrite(cacheFd, &described, sizeof(described), 0)==-1){ // Sparing the next run from reading the file
+                perror("Unable to update compiled script!"); // Outputting error message
+            }
+        }else{
+            header = NULL;
+        }
+    }
+
+    struct arena arena = {0};
+    struct script_reader reader = {0};
+    if(header!=NULL){
+        reader = (struct script_reader){(const unsigned char*)image + sizeof(struct script_header), header->code_size, 0, image + sizeof(struct script_header) + header->code_size, header->strings_size, false};
+        header = script_check(&reader, &arena) ? header : NULL;
+    }
+    if(cacheFd!=-1){
+        close(cacheFd);
+    }
+
+    if(header==NULL){ // Compiling the script, then saving it for the next run
+        if(mapped){
+            munmap(image, imageSize);
+            mapped = false;
+        }
+        source = source!=NULL ? source : read_file(fd, info.st_size);
+        struct script_code script = {0};
+        if(source==NULL){
+            perror("Unable to read input!"); // Outputting error message
+            close(fd);
+            return EXIT_FAILURE;
+        }
+        unsigned long hash = hash_bytes(source, strlen(source));
+        script_compile(&script, source);
+        script.strings = grow_scratch(script.strings, &script.strings_capacity, script.strings_size + 1, 1); // The strings are never empty, so the last byte of the file is always '\0'
+        script.strings[script.strings_size++] = '\0';
+
+        struct script_header compiled = {SCRIPT_CACHE_MAGIC, 0, 0, 0, 0, hash, script.code_size, script.strings_size, 0};
+        script_describe(&compiled, &info);
+        imageSize = sizeof(compiled) + script.code_size + script.strings_size;
+        image = malloc(imageSize);
+        if(image==NULL){
+            perror("Unable to allocate memory!"); // Outputting error message
+            exit(EXIT_FAILURE);
+        }
+        memcpy(image + sizeof(compiled), script.code, script.code_size);
+        memcpy(image + sizeof(compiled) + script.code_size, script.strings, script.strings_size);
+        compiled.checksum = hash_bytes(image + sizeof(compiled), script.code_size + script.strings_size);
+        memcpy(image, &compiled, sizeof(compiled));
+        free(script.code);
+        free(script.strings);
+        free(script.interned);
+
+        char temporary[PATH_MAX + 32];
+        snprintf(temporary, sizeof(temporary), "%s.%d", cachePath, (int)getpid());
+        int out = caching ? open(temporary, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600) : -1;
+        if(out!=-1){ // Renamed into place once complete, so other runs never map half a file
+            bool written = write_all(out, image, imageSize);
+            close(out);
+            if(!written || rename(temporary, cachePath)==-1){
+                unlink(temporary);
+            }
+        }
+        reader = (struct script_reader){(const unsigned char*)image + sizeof(compiled), script.code_size, 0, image + sizeof(compiled) + script.code_size, script.strings_size, false};
+    }
+    free(source);
+    close(fd);
+    arena_free(&arena);
+
+    int status = script_execute(&reader);
+    if(mapped){
+        munmap(image, imageSize);
+    }else{
+        free(image);
+    }
+    return status;
+}
+
+#define MEMO_MAGIC "TSHMEM1" // Identifying a key file of the memo store, and the version of its layout
+#define MEMO_DEFAULT_SIZE (256ULL << 20) // The size of the memo store, unless TINYSHELL_MEMO_SIZE sets another
+
+struct memo_header{ // Defining the structure at the start of a key file of the memo store, the key itself following it
+    char magic[8];
+    int32_t status; // The exit status of the pipeline
+    uint32_t key_size; // The size of the key, which is compared in full so keys with the same hash never share an output
+    uint64_t output; // The FNV-1a hash of the output, naming the file holding it, so equal outputs are stored once
+    uint64_t output_size;
+};
+
+struct memo_key{ // Defining the structure of the key of a pipeline being built, everything its output depends on
+    char *bytes;
+    size_t size;
+    size_t capacity;
+};
+
+struct memo_file{ // Defining the structure for a file of the memo store, when it is scanned for eviction
+    char name[32];
+    struct timespec used; // Its modification time, set again whenever it is replayed
+    off_t size;
+};
+
+struct memo_statistics{ // Defining the counters reported by 'memo', for the whole process
+    unsigned long hits; // Pipelines whose stored output was replayed
+    unsigned long misses; // Pipelines which had to run
+    unsigned long stored; // Outputs which were stored, those of programs which could not start or were killed are not
+    unsigned long evicted; // Outputs removed to keep the store within its size
+};
+
+struct memo_statistics memo_statistics = {0, 0, 0, 0};
+
+void memo_add(struct memo_key *key, const char *bytes, size_t length){ // Creating a function to append a field to a key, ending it with '\0'
+    key->bytes = grow_scratch(key->bytes, &key->capacity, key->size + length + 1, 1);
+    memcpy(key->bytes + key->size, bytes, length);
+    key->bytes[key->size + length] = '\0';
+    key->size += length + 1;
+}
+
+void memo_add_string(struct memo_key *key, const char *string){ // Creating a function to append a string to a key
+    memo_add(key, string, strlen(string));
+}
+
+void memo_add_file(struct memo_key *key, const char *path){ // Creating a function to append a file to a key: its name, and its inode, size and modification time so that changing it changes the key
+
+    struct stat info;
+    char identity[128];
+    memo_add_string(key, path);
+    if(stat(path, &info)==-1){
+        memo_add_string(key, "-");
+        return;
+    }
+    snprintf(identity, sizeof(identity), "%lx:%lx:%lld:%lld.%09ld", (unsigned long)info.st_dev, (unsigned long)info.st_ino, (long long)info.st_size, (long long)info.st_mtim.tv_sec, info.st_mtim.tv_nsec);
+    memo_add_string(key, identity);
+}
+
+void memo_add_contents(struct memo_key *key, int fd){ // Creating a function to append what a here-document holds to a key, leaving its offset alone
+
+    char buffer[65536];
+    off_t offset = 0;
+    ssize_t length;
+    while((length = pread(fd, buffer, sizeof(buffer), offset))>0 || (length==-1 && errno==EINTR)){
+        if(length>0){
+            key->bytes = grow_scratch(key->bytes, &key->capacity, key->size + length, 1);
+            memcpy(key->bytes + key->size, buffer, length);
+            key->size += length;
+            offset += length;
+        }
+    }
+    memo_add(key, "", 0);
+}
+
+bool memo_output_redirection(const struct redirection *r){ // Creating a function to check whether a redirection of the last stage is where the output goes, which is not part of the key
+    return r->fd==STDOUT_FILENO && (r->type==REDIRECT_OUT || r->type==REDIRECT_APPEND);
+}
+
+void memo_build_key(const struct shell_pipeline *pipeline, struct memo_key *key){ // Creating a function to build the key of an expanded pipeline: its directory, words, programs, input files and declared variables
+
+    char number[32];
+    const char *directory = current_directory();
+    memo_add_string(key, directory!=NULL ? directory : "");
+    for(int i=0; i<pipeline->stage_count; i++){
+        const struct shell_command *stage = &pipeline->stages[i];
+        snprintf(number, sizeof(number), "%d", stage->argc);
+        memo_add_string(key, number);
+        for(int a=0; a<stage->argc; a++){
+            memo_add_string(key, stage->argv[a]);
+        }
+        const char *program = stage->argc==0 || find_builtin(stage->argv[0])!=NULL ? NULL : strchr(stage->argv[0], '/')!=NULL ? stage->argv[0] : command_hash_lookup(stage->argv[0]);
+        memo_add_file(key, program!=NULL ? program : ""); // A program which was replaced gives another output
+        for(const struct redirection *r=stage->redirections; r!=NULL; r=r->next){
+            if(i==pipeline->stage_count-1 && memo_output_redirection(r)){
+                continue;
+            }
+            snprintf(number, sizeof(number), "%d:%d", r->type, r->fd);
+            memo_add_string(key, number);
+            bool heredoc = false;
+            for(size_t f=0; r->type==REDIRECT_DUP && f<current_shell->expansion_fd_count; f++){
+                heredoc = heredoc || current_shell->expansion_fds[f]==r->source_fd;
+            }
+            if(r->type==REDIRECT_IN){
+                memo_add_file(key, r->target);
+            }else if(heredoc){
+                memo_add_contents(key, r->source_fd);
+            }else if(r->type==REDIRECT_DUP){
+                snprintf(number, sizeof(number), "%d", r->source_fd);
+                memo_add_string(key, number);
+            }else{
+                memo_add_string(key, r->target);
+            }
+        }
+    }
+    memo_add_string(key, "-i");
+    for(int i=0; i<pipeline->memo->input_count; i++){
+        memo_add_file(key, pipeline->memo->inputs[i]);
+    }
+    memo_add_string(key, "-e");
+    for(int i=0; i<pipeline->memo->variable_count; i++){
+        const char *name = pipeline->memo->variables[i];
+        const char *value = variable_get(name, strlen(name));
+        memo_add_string(key, name);
+        memo_add_string(key, value!=NULL ? value : "");
+        memo_add_string(key, value!=NULL ? "=" : "-"); // Telling an unset variable from an empty one
+    }
+}
+
+bool memo_directory(char *path, size_t size){ // Creating a function to find and create the memo store, in the cache directory
+    return cache_directory(path, size) && strlen(path) + 5<size && make_directories(strcat(path, "/memo"));
+}
+
+unsigned long long memo_limit(void){ // Creating a function to read the size of the memo store from TINYSHELL_MEMO_SIZE, a number with an optional 'K', 'M' or 'G' suffix or 'unlimited'
+
+    const char *text = getenv("TINYSHELL_MEMO_SIZE");
+    const char *end;
+    rlim_t limit;
+    if(text==NULL || !parse_limit_value(text, &end, &limit) || *end!='\0'){
+        return MEMO_DEFAULT_SIZE;
+    }
+    return limit==RLIM_INFINITY ? ULLONG_MAX : (unsigned long long)limit;
+}
+
+int memo_lookup(const char *directory, const struct memo_key *key, unsigned long keyHash, struct memo_header *header){ // Creating a function to open the stored output of a key, or return -1
+
+    char keyPath[PATH_MAX];
+    char outputPath[PATH_MAX];
+    snprintf(keyPath, sizeof(keyPath), "%s/%016lx.key", directory, keyHash);
+    int fd = open(keyPath, O_RDONLY | O_CLOEXEC);
+    if(fd==-1){
+        return -1;
+    }
+    char *stored = malloc(key->size);
+    bool found = stored!=NULL && read(fd, header, sizeof(*header))==(ssize_t)sizeof(*header) && memcmp(header->magic, MEMO_MAGIC, sizeof(header->magic))==0 &&
+        header->key_size==key->size && read(fd, stored, key->size)==(ssize_t)key->size && memcmp(stored, key->bytes, key->size)==0;
+    free(stored);
+    close(fd);
+    if(!found){
+        return -1;
+    }
+
+    snprintf(outputPath, sizeof(outputPath), "%s/%016lx.out", directory, (unsigned long)header->output);
+    int output = open(outputPath, O_RDONLY | O_CLOEXEC);
+    struct stat info;
+    if(output==-1 || fstat(output, &info)==-1 || (uint64_t)info.st_size!=header->output_size){ // The output was evicted, the key is dropped as well
+        if(output!=-1){
+            close(output);
+        }
+        unlink(keyPath);
+        return -1;
+    }
+    futimens(output, NULL); // The modification times order the files for eviction, the least recently used first
+    utimensat(AT_FDCWD, keyPath, NULL, 0);
+    return output;
+}
+
+int memo_replay(int fd, const struct shell_command *last){ // Creating a function to write an output where the pipeline sends it: the file the stdout of its last stage is redirected to, or stdout
+
+    int out = -1;
+    for(const struct redirection *r=last->redirections; r!=NULL; r=r->next){ // Every file is created or truncated, the last one receiving the output
+        if(!memo_output_redirection(r)){
+            continue;
+        }
+        if(out>=0){
+            close(out);
+        }
+        out = open(r->target, redirection_flags(r->type) | O_CLOEXEC, 0666);
+        if(out==-1){
+            perror(redirection_error(r)); // Outputting error message
+            return 1;
+        }
+    }
+
+    int status = 0;
+    if(out<0 && current_shell->output!=NULL){
+        deliver_output(fd, STDOUT_FILENO);
+    }else{
+        fflush(stdout);
+        if(!copy_data(fd, out>=0 ? out : STDOUT_FILENO)){
+            perror("Unable to write output!"); // Outputting error message
+            status = 1;
+        }
+    }
+    if(out>=0){
+        close(out);
+    }
+    return status;
+}
+
+int compare_memo_files(const void *a, const void *b){ // Creating a function to order the files of the memo store from the least recently used, for 'qsort'
+    const struct memo_file *first = a;
+    const struct memo_file *second = b;
+    if(first->used.tv_sec!=second->used.tv_sec){
+        return first->used.tv_sec < second->used.tv_sec ? -1 : 1;
+    }
+    return (first->used.tv_nsec > second->used.tv_nsec) - (first->used.tv_nsec < second->used.tv_nsec);
+}
+
+unsigned long long memo_scan(const char *directory, struct memo_file **files, size_t *count){ // Creating a function to list the keys and outputs of the memo store, returning their total size
+
+    unsigned long long total = 0;
+    size_t capacity = 0;
+    *files = NULL;
+    *count = 0;
+    DIR *dir = opendir(directory);
+    if(dir==NULL){
+        return 0;
+    }
+    struct dirent *entry;
+    while((entry = readdir(dir))!=NULL){
+        size_t length = strlen(entry->d_name);
+        struct stat info;
+        if(length>=sizeof((*files)->name) || length<5 || (strcmp(entry->d_name + length - 4, ".key")!=0 && strcmp(entry->d_name + length - 4, ".out")!=0) ||
+            fstatat(dirfd(dir), entry->d_name, &info, AT_SYMLINK_NOFOLLOW)==-1){ // Files being written are left alone
+            continue;
+        }
+        *files = grow_scratch(*files, &capacity, *count + 1, sizeof(struct memo_file));
+        struct memo_file *file = &(*files)[(*count)++];
+        strcpy(file->name, entry->d_name);
+        file->used = info.st_mtim;
+        file->size = info.st_size;
+        total += info.st_size;
+    }
+    closedir(dir);
+    return total;
+}
+
+void memo_evict(const char *directory){ // Creating a function to remove the least recently used files of the memo store until it fits in its size
+
+    unsigned long long limit = memo_limit();
+    struct memo_file *files;
+    size_t count;
+    unsigned long long total = memo_scan(directory, &files, &count);
+    if(total>limit){
+        qsort(files, count, sizeof(struct memo_file), compare_memo_files);
+        int dir = open(directory, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        for(size_t i=0; i<count && total>limit && dir!=-1; i++){ // A key whose output is gone is dropped when it is next looked up
+            if(unlinkat(dir, files[i].name, 0)==0){
+                total -= files[i].size;
+                memo_statistics.evicted += strcmp(files[i].name + strlen(files[i].name) - 4, ".out")==0;
+            }
+        }
+        if(dir!=-1){
+            close(dir);
+        }
+    }
+    free(files);
+}
+
+bool memo_store(const char *directory, const char *temporary, int fd, const struct memo_key *key, unsigned long keyHash, int status){ // Creating a function to move an output into the memo store under its hash, then record its key
+
+    struct stat info;
+    if(fstat(fd, &info)==-1){
+        return false;
+    }
+    char *output = info.st_size>0 ? mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0) : NULL;
+    if(output==MAP_FAILED){
+        return false;
+    }
+    unsigned long hash = hash_bytes(output!=NULL ? output : "", info.st_size);
+    if(output!=NULL){
+        munmap(output, info.st_size);
+    }
+
+    char outputPath[PATH_MAX];
+    char keyPath[PATH_MAX];
+    char keyTemporary[PATH_MAX + 32];
+    struct stat existing;
+    snprintf(outputPath, sizeof(outputPath), "%s/%016lx.out", directory, hash);
+    if(stat(outputPath, &existing)==0 && existing.st_size==info.st_size){ // Another key already produced this output
+        unlink(temporary);
+        utimensat(AT_FDCWD, outputPath, NULL, 0);
+    }else if(rename(temporary, outputPath)==-1){
+        return false;
+    }
+
+    struct memo_header header = {MEMO_MAGIC, status, (uint32_t)key->size, hash, (uint64_t)info.st_size};
+    snprintf(keyPath, sizeof(keyPath), "%s/%016lx.key", directory, keyHash);
+    snprintf(keyTemporary, sizeof(keyTemporary), "%s.%d", keyPath, (int)getpid());
+    int out = open(keyTemporary, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if(out==-1){
+        return false;
+    }
+    bool written = write_all(out, (const char*)&header, sizeof(header)) && write_all(out, key->bytes, key->size); // Renamed into place once complete, so a lookup never reads half a key
+    close(out);
+    if(!written || rename(keyTemporary, keyPath)==-1){
+        unlink(keyTemporary);
+        return false;
+    }
+    return true;
+}
+
+int execute_memo(struct shell_pipeline *pipeline){ // Creating a function to run a pipeline prefixed with 'memo', replaying the stored output of an earlier run with the same key instead
+
+    char directory[PATH_MAX];
+    if(!memo_directory(directory, sizeof(directory))){ // Without a cache the pipeline simply runs
+        return -6;
+    }
+    struct memo_key key = {NULL, 0, 0};
+    memo_build_key(pipeline, &key);
+    unsigned long keyHash = hash_bytes(key.bytes, key.size);
+    const struct shell_command *last = &pipeline->stages[pipeline->stage_count-1];
+
+    struct memo_header header;
+    int stored = memo_lookup(directory, &key, keyHash, &header);
+    if(stored>=0){ // Nothing is started, the output and the status are those of the earlier run
+        memo_statistics.hits++;
+        int status = memo_replay(stored, last);
+        close(stored);
+        free(key.bytes);
+        return status!=0 ? status : header.status;
+    }
+
+    char temporary[PATH_MAX + 32];
+    snprintf(temporary, sizeof(temporary), "%s/tmp.XXXXXX", directory);
+    int output = mkostemp(temporary, O_CLOEXEC);
+    if(output==-1){
+        perror("Unable to create memo output!"); // Outputting error message
+        free(key.bytes);
+        return -6;
+    }
+    memo_statistics.misses++;
+
+    int redirectionCount = 1; // The stdout of the last stage goes into the store, to be replayed like a stored output once the pipeline is done
+    for(const struct redirection *r=last->redirections; r!=NULL; r=r->next){
+        redirectionCount++;
+    }
+    struct redirection redirections[redirectionCount];
+    int used = 0;
+    for(const struct redirection *r=last->redirections; r!=NULL; r=r->next){ // Where the output goes is only opened when it is replayed
+        if(!memo_output_redirection(r)){
+            redirections[used++] = *r;
+        }
+    }
+    redirections[used] = (struct redirection){REDIRECT_DUP, STDOUT_FILENO, NULL, output, NULL, 0};
+    for(int i=0; i<used; i++){
+        redirections[i].next = &redirections[i+1];
+    }
+    struct shell_command stages[pipeline->stage_count];
+    memcpy(stages, pipeline->stages, pipeline->stage_count * sizeof(struct shell_command));
+    stages[pipeline->stage_count-1].redirections = redirections;
+    struct shell_pipeline run = *pipeline;
+    run.stages = stages;
+
+    bool detach = current_shell->detach; // The output is only complete once the pipeline is done
+    current_shell->detach = false;
+    int status = fork_exec_pipe_ex(&run, false);
+    current_shell->detach = detach;
+
+    int replayed = lseek(output, 0, SEEK_SET)==0 ? memo_replay(output, last) : 1;
+    if(status>=0 && status<126 && memo_store(directory, temporary, output, &key, keyHash, status)){ // Programs which could not start, and those killed by a signal, run again next time
+        memo_statistics.stored++;
+        memo_evict(directory);
+    }else{
+        unlink(temporary);
+    }
+    close(output);
+    free(key.bytes);
+    return status==0 ? replayed : status;
+}
+
+int builtin_memo(char **args, struct builtin_io *io){ // Implementing a builtin command 'memo', which reports on the memo store (with a command, 'memo' is a prefix)
+
+    char directory[PATH_MAX];
+    if(!memo_directory(directory, sizeof(directory))){
+        fprintf(io->err,"Error: memo: There is no cache directory to store outputs in\n"); // Output error message
+        return 1;
+    }
+    struct memo_file *files;
+    size_t count;
+    size_t outputs = 0;
+    unsigned long long total = memo_scan(directory, &files, &count);
+    for(size_t i=0; i<count; i++){
+        outputs += strcmp(files[i].name + strlen(files[i].name) - 4, ".out")==0;
+    }
+    free(files);
+
+    unsigned long long limit = memo_limit();
+    unsigned long lookups = memo_statistics.hits + memo_statistics.misses;
+    fprintf(io->out,"hits\tmisses\tstored\tevicted\thit rate\n");
+    fprintf(io->out,"%lu\t%lu\t%lu\t%lu\t%.1f%%\n", memo_statistics.hits, memo_statistics.misses, memo_statistics.stored, memo_statistics.evicted, lookups>0 ? 100.0 * memo_statistics.hits / lookups : 0.0);
+    if(limit==ULLONG_MAX){
+        fprintf(io->out,"%s: %zu outputs in %llu bytes, unlimited\n", directory, outputs, total);
+    }else{
+        fprintf(io->out,"%s: %zu outputs in %llu of %llu bytes\n", directory, outputs, total, limit);
+    }
+    return 0;
+}
+
+struct tinyshell *tinyshell_create(void){ // Creating a function to create a shell context
+
+    tinyshell_trace_init();
+    return calloc(1, sizeof(struct tinyshell));
+}
+
+void tinyshell_destroy(struct tinyshell *shell){ // Creating a function to release a shell context
+
+    if(shell==NULL){
+        return;
+    }
+    if(current_shell==shell){
+        current_shell = &default_shell;
+    }
+    struct job *job = job_list;
+    while(job!=NULL){ // Finished jobs are dropped, running ones are collected by the reaper once they finish
+        struct job *next = job->next;
+        if(job->owner==shell){
+            job->owner = NULL;
+            if(job->state==JOB_DONE){
+                job_free(job);
+            }
+        }
+        job = next;
+    }
+    parser_free(&shell->parser);
+    arena_free(&shell->expansion);
+    free(shell->expansion_fds);
+    free(shell->pipeline_status);
+    free(shell->pipeline_usage);
+    if(shell->environment!=NULL){
+        environment_free(shell->environment);
+        free(shell->environment);
+        close(shell->cwd_fd);
+        free(shell->cwd);
+    }
+    free(shell);
+}
+
+bool context_isolate(struct tinyshell *shell){ // Creating a function to give a context a working directory and variables of its own, starting from those of the shell
+
+    const char *cwd = current_directory();
+    int fd = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(fd==-1 || cwd==NULL || (shell->cwd = strdup(cwd))==NULL){
+        perror("Error: cannot keep the working directory");
+        if(fd!=-1){
+            close(fd);
+        }
+        return false;
+    }
+    shell->cwd_fd = fd;
+    shell->environment = malloc(sizeof(struct environment));
+    if(shell->environment==NULL){
+        perror("Unable to allocate memory!"); // Outputting error message
+        exit(EXIT_FAILURE);
+    }
+    environment_copy(shell->environment);
+    return true;
+}
+
+void context_swap(struct tinyshell *shell){ // Creating a function to exchange the working directory and variables of a context with those in use, once to enter it and again to leave
+
+    if(shell->environment==NULL){
+        return;
+    }
+    struct environment variables = environment;
+    environment = *shell->environment;
+    *shell->environment = variables;
+    const char *path = variable_get("PATH", 4); // 'execvpe' and 'posix_spawnp' search the PATH of the process
+    if(path!=NULL){
+        setenv("PATH", path, 1);
+    }else{
+        unsetenv("PATH");
+    }
+    char *cwd = shell_cwd;
+    shell_cwd = shell->cwd;
+    shell->cwd = cwd;
+
+    int here = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC); // The directory being left, which 'cd' may have changed since it was entered
+    if(here==-1){
+        perror("Error: cannot keep the working directory");
+    }else if(fchdir(shell->cwd_fd)==-1){
+        perror("Error: cannot change the working directory");
+        close(here);
+    }else{
+        close(shell->cwd_fd);
+        shell->cwd_fd = here;
+    }
+}
+
+void context_enter(struct tinyshell *shell){ // Creating a function to make a context the current one
+
+    current_shell = shell;
+    context_swap(shell);
+}
+
+void context_leave(struct tinyshell *shell){ // Creating a function to go back to the default context, keeping the state of the one left
+
+    context_swap(shell);
+    current_shell = &default_shell;
+}
+
+void tinyshell_set_output_callback(struct tinyshell *shell, tinyshell_output_callback callback, void *data){
+    shell->output = callback;
+    shell->output_data = data;
+}
+
+void tinyshell_set_status_callback(struct tinyshell *shell, tinyshell_status_callback callback, void *data){
+    shell->status = callback;
+    shell->status_data = data;
+}
+
+int tinyshell_run(struct tinyshell *shell, const char *line){ // Creating a function to run one command line in a context
+
+    struct tinyshell *previous = current_shell; // Contexts can be nested, for example when a callback runs another command
+    current_shell = shell;
+    shell->exit_requested = false;
+    int status = execute_shell_command(line);
+    fflush(stdout);
+    current_shell = previous;
+    return status;
+}
+
+int tinyshell_run_string(struct tinyshell *shell, const char *commands){
+
+    struct tinyshell *previous = current_shell;
+    current_shell = shell;
+    shell->exit_requested = false;
+    int status = run_string(commands);
+    current_shell = previous;
+    return status;
+}
+
+int tinyshell_run_stream(struct tinyshell *shell, int fd, bool interactive){
+
+    struct tinyshell *previous = current_shell;
+    current_shell = shell;
+    shell->exit_requested = false;
+    int status = run_stream(fd, interactive);
+    current_shell = previous;
+    return status;
+}
+
+int tinyshell_run_script(struct tinyshell *shell, const char *path){
+
+    struct tinyshell *previous = current_shell;
+    current_shell = shell;
+    shell->exit_requested = false;
+    int status = run_script(path);
+    current_shell = previous;
+    return status;
+}
+
+struct tinyshell_prepared{ // Defining the structure for a prepared command line, which owns the memory of its pipeline
+    struct parser parser;
+    struct shell_pipeline *pipeline;
+};
+
+struct tinyshell_prepared *tinyshell_prepare(struct tinyshell *shell, const char *line){ // Creating a function to parse a command line once
+
+    struct tinyshell_prepared *prepared = calloc(1, sizeof(struct tinyshell_prepared));
+    if(prepared==NULL){
+        return NULL;
+    }
+    struct tinyshell *previous = current_shell;
+    current_shell = shell;
+    prepared->pipeline = prepare_pipeline(&prepared->parser, line); // The pipeline lives in the arena of its own parser
+    current_shell = previous;
+    if(prepared->pipeline==NULL){
+        tinyshell_prepared_free(prepared);
+        return NULL;
+    }
+    return prepared;
+}
+
+int tinyshell_execute(struct tinyshell *shell, struct tinyshell_prepared *prepared){ // Creating a function to execute a prepared command line
+
+    struct tinyshell *previous = current_shell;
+    current_shell = shell;
+    shell->exit_requested = false;
+    int status = execute_list(prepared->pipeline);
+    fflush(stdout);
+    current_shell = previous;
+    return status;
+}
+
+void tinyshell_prepared_free(struct tinyshell_prepared *prepared){
+
+    if(prepared!=NULL){
+        parser_free(&prepared->parser);
+        free(prepared);
+    }
+}
+
+int tinyshell_last_status(const struct tinyshell *shell){
+    return shell->last_status;
+}
+
+bool tinyshell_exit_requested(const struct tinyshell *shell){
+    return shell->exit_requested;
+}
+
+int tinyshell_select_spawn_backend(const char *name){
+    return select_spawn_backend(name);
+}
+
+struct serve_session{ // Defining the structure of a client connected to the server
+    int fd; // The connection
+    struct tinyshell *shell; // The context of the client, kept between its command lines
+    char *input; // The bytes received which were not run yet
+    size_t length;
+    size_t capacity;
+    struct job *job; // The pipeline being run, or NULL
+    int outputs[2]; // The stdout and stderr of 'job', -1 once closed
+    struct shell_pipeline *pending; // The pipeline of the command list which runs as 'job', the rest of the list following it once it is done
+    pid_t worker; // The process running a command line which would make the other clients wait, or 0
+    bool closed; // Whether the client went away or ran 'exit'
+    struct serve_session *next;
+};
+
+void serve_send(struct serve_session *session, const char *data, size_t length){ // Creating a function to write to a client, dropping it if it cannot be written to
+
+    while(length>0 && !session->closed){
+        ssize_t sent = send(session->fd, data, length, MSG_NOSIGNAL); // A client which went away must not kill the server with SIGPIPE
+        if(sent==-1 && errno==EINTR){
+            continue;
+        }
+        if(sent<=0){
+            session->closed = true;
+            break;
+        }
+        data += sent;
+        length -= sent;
+    }
+}
+
+void serve_output(void *data, int fd, const char *buffer, size_t length){ // Creating a function to send output to a client as an 'out' or 'err' frame
+
+    struct serve_session *session = data;
+    char header[32];
+    int headerLength = snprintf(header, sizeof(header), "%s %zu\n", fd==STDOUT_FILENO ? "out" : "err", length);
+    serve_send(session, header, headerLength);
+    serve_send(session, buffer, length);
+}
+
+void serve_status(struct serve_session *session, int status){ // Creating a function to end the reply to a command line with its 'exit' frame
+
+    char frame[32];
+    int length = snprintf(frame, sizeof(frame), "exit %d\n", status);
+    serve_send(session, frame, length);
+    if(session->shell->exit_requested){ // 'exit' ends the session, the server keeps running
+        session->closed = true;
+    }
+}
+
+void serve_attach(int serverFd, struct serve_session *session){ // Creating a function to collect the pipeline left running from the event loop, reading its output as it comes
+
+    session->job = session->shell->detached;
+    session->shell->detached = NULL;
+    for(int i=0; i<2; i++){
+        session->outputs[i] = session->shell->detached_fds[i];
+        fcntl(session->outputs[i], F_SETFL, O_NONBLOCK);
+        struct epoll_event event = {.events = EPOLLIN, .data.fd = session->outputs[i]};
+        epoll_ctl(serverFd, EPOLL_CTL_ADD, session->outputs[i], &event);
+    }
+}
+
+void serve_list(int serverFd, struct serve_session *session, struct shell_pipeline *pipeline){ // Creating a function to run a command list from 'pipeline' on, until a program is left running, replying once the list is done
+
+    int status = session->shell->last_status;
+    while(pipeline!=NULL && !session->shell->exit_requested){
+        status = execute_parsed(pipeline); // Programs are left running, builtins run in the server
+        if(session->shell->detached!=NULL){ // The list goes on from 'serve_finish'
+            serve_attach(serverFd, session);
+            session->pending = pipeline;
+            return;
+        }
+        if(status==128+SIGINT){
+            break;
+        }
+        pipeline = list_next(pipeline, status);
+    }
+    session->pending = NULL;
+    serve_status(session, status);
+}
+
+void serve_finish(int serverFd, struct serve_session *session){ // Creating a function to reply to a client once its pipeline is done
+
+    char buffer[65536];
+    for(int i=0; i<2; i++){
+        if(session->outputs[i]<0){
+            continue;
+        }
+        ssize_t length;
+        while((length = read(session->outputs[i], buffer, sizeof(buffer)))>0){ // Only what the pipeline wrote before it finished is sent
+            serve_output(session, i + 1, buffer, length);
+        }
+        epoll_ctl(serverFd, EPOLL_CTL_DEL, session->outputs[i], NULL);
+        close(session->outputs[i]);
+        session->outputs[i] = -1;
+    }
+
+    context_enter(session->shell);
+    int status = job_finish(session->job);
+    session->job = NULL;
+    session->shell->last_status = status<0 ? 1 : status;
+    bool stopped = session->shell->last_status==128+SIGINT || session->shell->exit_requested; // Ctrl-C stops the whole list, as in 'execute_list'
+    serve_list(serverFd, session, stopped ? NULL : list_next(session->pending, session->shell->last_status));
+    context_leave(session->shell);
+}
+
+bool serve_inline(const struct shell_pipeline *list){ // Creating a function to check whether a command line can run in the server itself, nothing in it waiting for a program
+
+    for(const struct shell_pipeline *pipeline=list; pipeline!=NULL; pipeline=pipeline->next){
+        if(pipeline->stage_count==0){
+            continue;
+        }
+        if(pipeline->timed || pipeline->batch || pipeline->memo!=NULL || pipeline->watch!=NULL){ // These wait for their pipeline
+            return false;
+        }
+        for(int i=0; i<pipeline->stage_count; i++){ // Command substitution waits for the command
+            const struct shell_command *stage = &pipeline->stages[i];
+            for(int a=0; stage->word_flags!=NULL && a<stage->argc; a++){
+                if((stage->word_flags[a] & WORD_VARIABLE) && strstr(stage->argv[a], "$(")!=NULL){
+                    return false;
+                }
+            }
+            for(const struct redirection *r=stage->redirections; r!=NULL; r=r->next){
+                if((r->target_flags & WORD_VARIABLE) && strstr(r->target, "$(")!=NULL){
+                    return false;
+                }
+            }
+        }
+        const struct shell_command *first = &pipeline->stages[0];
+        if(first->argc>0 && first->word_flags!=NULL && (first->word_flags[0] & WORD_VARIABLE)){ // The command is only known once expanded
+            return false;
+        }
+        const struct builtin_command *builtin = pipeline->stage_count==1 && first->argc>0 ? find_builtin(first->argv[0]) : NULL;
+        if(builtin!=NULL && (builtin->method==builtin_wait || builtin->method==builtin_fg || builtin->method==builtin_parallel)){
+            return false;
+        }
+    }
+    return true;
+}
+
+void serve_worker(int serverFd, struct serve_session *sessions, struct serve_session *session, struct shell_pipeline *list){ // Creating a function to run a command line in a child of the server, which replies to the client itself
+
+    pid_t worker = fork();
+    if(worker==-1){
+        perror("Unable to create new process!"); // Outputting error message
+        serve_status(session, 1);
+        return;
+    }
+    if(worker>0){
+        setpgid(worker, worker); // Before the child does it too, so SIGHUP always reaches its whole group
+        session->worker = worker;
+        return;
+    }
+
+    setpgid(0, 0); // The programs it starts stay in its group, as the server has no job control
+    for(struct serve_session *other=sessions; other!=NULL; other=other->next){ // Other clients must see their connection close when the server closes it
+        if(other!=session){
+            close(other->fd);
+            for(int i=0; i<2; i++){
+                if(other->outputs[i]>=0){
+                    close(other->outputs[i]);
+                }
+            }
+        }
+    }
+    close(serverFd);
+    sigprocmask(SIG_SETMASK, &child_sigmask, NULL); // SIGINT and SIGTERM stop the worker, not a server of its own
+    jobs_forget(); // Its own event loop is set up when the line starts a job
+    session->shell->detach = false;
+    int status = execute_list(list);
+    fflush(stdout);
+    serve_status(session, status);
+    _exit(session->closed ? 1 : 0); // The server drops the client after 'exit'
+}
+
+void serve_run(int serverFd, struct serve_session *sessions, struct serve_session *session){ // Creating a function to run the command lines a client sent, until one of them is left running
+
+    context_enter(session->shell); // The working directory and variables of the client
+    while(session->job==NULL && session->worker==0 && !session->closed){
+        char *newline = memchr(session->input, '\n', session->length);
+        if(newline==NULL){ // Waiting for the rest of the line
+            break;
+        }
+        *newline = '\0';
+
+        session->shell->exit_requested = false;
+        struct shell_pipeline *list = prepare_pipeline(&session->shell->parser, session->input); // The list stays in the parser until it is done, as no other line is parsed meanwhile
+        size_t used = newline + 1 - session->input;
+
+        if(list==NULL){
+            session->shell->last_status = 2; // Syntax errors use the same status as other shells
+            serve_status(session, 2);
+        }else if(list->stage_count==0){ // Nothing was inputted
+            serve_status(session, session->shell->last_status);
+        }else if(serve_inline(list)){
+            serve_list(serverFd, session, list);
+        }else{ // A line which waits for a command or a job would stop the server from answering its other clients
+            serve_worker(serverFd, sessions, session, list);
+        }
+
+        memmove(session->input, session->input + used, session->length - used);
+        session->length -= used;
+    }
+    context_leave(session->shell);
+}
+
+void serve_close(int serverFd, struct serve_session *session){ // Creating a function to drop a client, whose running pipeline is sent SIGHUP
+
+    if(session->worker!=0){ // The worker and the programs of its line
+        kill(-session->worker, SIGHUP);
+        waitpid(session->worker, NULL, 0);
+    }
+    if(session->job!=NULL){
+        for(int i=0; i<session->job->stage_count; i++){
+            if(session->job->pids[i]>0 && !session->job->finished[i]){
+                kill(session->job->pids[i], SIGHUP);
+            }
+        }
+        for(int i=0; i<2; i++){
+            if(session->outputs[i]>=0){
+                epoll_ctl(serverFd, EPOLL_CTL_DEL, session->outputs[i], NULL);
+                close(session->outputs[i]);
+            }
+        }
+    }
+    epoll_ctl(serverFd, EPOLL_CTL_DEL, session->fd, NULL);
+    close(session->fd);
+    tinyshell_destroy(session->shell); // A pipeline still running is collected by the reaper
+    free(session->input);
+    free(session);
+}
+
+int tinyshell_serve(const char *path){ // Creating a function to run command lines sent by clients over a UNIX socket, until SIGINT or SIGTERM
+
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if(strlen(path)>=sizeof(address.sun_path)){
+        fprintf(stderr,"Error: The socket path '%s' is too long\n", path); // Output error message
+        return 2;
+    }
+    strcpy(address.sun_path, path);
+
+    if(!job_control_init(false)){
+        return 1;
+    }
+    sigset_t stop; // Stopping cleanly, so that the socket is removed
+    sigemptyset(&stop);
+    sigaddset(&stop, SIGINT);
+    sigaddset(&stop, SIGTERM);
+    sigprocmask(SIG_BLOCK, &stop, NULL); // Children are started with 'child_sigmask', which does not block them
+
+    int nullFd = open("/dev/null", O_RDONLY | O_CLOEXEC); // Commands read nothing, stdin belongs to nobody
+    if(nullFd>=0){
+        dup2(nullFd, STDIN_FILENO);
+        close(nullFd);
+    }
+
+    struct stat info;
+    if(lstat(path, &info)==0 && S_ISSOCK(info.st_mode)){ // Replacing the socket left by a server which did not stop cleanly
+        unlink(path);
+    }
+    int listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int stopFd = signalfd(-1, &stop, SFD_NONBLOCK | SFD_CLOEXEC);
+    int serverFd = epoll_create1(EPOLL_CLOEXEC); // The jobs have their own event loop, which is watched as a whole through 'event_fd'
+    if(listenFd==-1 || bind(listenFd, (struct sockaddr*)&address, sizeof(address))==-1 || listen(listenFd, SOMAXCONN)==-1 || stopFd==-1 || serverFd==-1){
+        perror("Unable to start server!"); // Outputting error message
+        return 1;
+    }
+    int watched[] = {listenFd, stopFd, event_fd};
+    for(int i=0; i<3; i++){
+        struct epoll_event event = {.events = EPOLLIN, .data.fd = watched[i]};
+        epoll_ctl(serverFd, EPOLL_CTL_ADD, watched[i], &event);
+    }
+
+    struct serve_session *sessions = NULL;
+    bool running = true;
+    while(running){
+        struct epoll_event events[64];
+        int count = epoll_wait(serverFd, events, 64, -1);
+        if(count==-1 && errno!=EINTR){
+            perror("Unable to wait for clients!"); // Outputting error message
+            break;
+        }
+
+        for(int e=0; e<count; e++){
+            int fd = events[e].data.fd;
+
+            if(fd==stopFd){
+                running = false;
+            }else if(fd==listenFd){ // A new client, with a context of its own
+                int client = accept4(listenFd, NULL, NULL, SOCK_CLOEXEC);
+                struct serve_session *session = client>=0 ? calloc(1, sizeof(struct serve_session)) : NULL;
+                struct tinyshell *shell = session!=NULL ? tinyshell_create() : NULL;
+                if(shell==NULL || !context_isolate(shell)){ // Starting from the working directory and variables of the server
+                    tinyshell_destroy(shell);
+                    free(session);
+                    if(client>=0){
+                        close(client);
+                    }
+                    continue;
+                }
+                session->fd = client;
+                session->shell = shell;
+                session->outputs[0] = session->outputs[1] = -1;
+                shell->detach = true;
+                tinyshell_set_output_callback(shell, serve_output, session);
+                struct epoll_event event = {.events = EPOLLIN, .data.fd = client};
+                epoll_ctl(serverFd, EPOLL_CTL_ADD, client, &event);
+                session->next = sessions;
+                sessions = session;
+            }else if(fd==event_fd){ // Children changed state
+                reap_children();
+                for(struct serve_session *session=sessions; session!=NULL; session=session->next){
+                    int status;
+                    if(session->job!=NULL && session->job->state==JOB_DONE){
+                        serve_finish(serverFd, session);
+                        serve_run(serverFd, sessions, session); // Running the lines which arrived meanwhile
+                    }else if(session->worker!=0 && waitpid(session->worker, &status, WNOHANG)==session->worker){
+                        session->worker = 0;
+                        if(WIFSIGNALED(status)){ // The reply was cut short
+                            session->closed = true;
+                        }else{
+                            session->closed = session->closed || WEXITSTATUS(status)!=0;
+                            serve_run(serverFd, sessions, session);
+                        }
+                    }
+                }
+            }else{
+                for(struct serve_session *session=sessions; session!=NULL; session=session->next){
+                    if(fd==session->fd){ // A client sent command lines
+                        if(session->capacity - session->length < 4096){
+                            size_t capacity = session->capacity * 2 + 4096;
+                            char *input = realloc(session->input, capacity);
+                            if(input==NULL){
+                                session->closed = true;
+                                break;
+                            }
+                            session->input = input;
+                            session->capacity = capacity;
+                        }
+                        ssize_t length = read(fd, session->input + session->length, session->capacity - session->length - 1);
+                        if(length<=0){
+                            session->closed = length==0 || errno!=EINTR;
+                        }else{
+                            session->length += length;
+                            serve_run(serverFd, sessions, session);
+                        }
+                        break;
+                    }else if(fd==session->outputs[0] || fd==session->outputs[1]){ // The pipeline of a client wrote something
+                        int stream = fd==session->outputs[0] ? 0 : 1;
+                        char buffer[65536];
+                        ssize_t length = read(fd, buffer, sizeof(buffer));
+                        if(length>0){
+                            serve_output(session, stream + 1, buffer, length);
+                        }else if(length==0){ // Closed by every stage, the status follows once they are reaped
+                            epoll_ctl(serverFd, EPOLL_CTL_DEL, fd, NULL);
+                            close(fd);
+                            session->outputs[stream] = -1;
+                        }
+                        break;
+                    }
+                }
+            }
+        }
+
+        struct serve_session **link = &sessions;
+        while(*link!=NULL){ // Dropping the clients which went away
+            struct serve_session *session = *link;
+            if(session->closed){
+                *link = session->next;
+                serve_close(serverFd, session);
+            }else{
+                link = &session->next;
+            }
+        }
+    }
+
+    while(sessions!=NULL){
+        struct serve_session *next = sessions->next;
+        serve_close(serverFd, sessions);
+        sessions = next;
+    }
+    close(serverFd);
+    close(stopFd);
+    close(listenFd);
+    unlink(path);
+    return 0;
+}
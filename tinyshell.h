@@ -0,0 +1,84 @@
+#ifndef TINYSHELL_H
+#define TINYSHELL_H
+
+// libtinyshell: the parser and executor of TinyShell, for programs which run shell commands without starting a shell for each one.
+//
+// A context ('struct tinyshell') holds everything that belongs to one caller: the parser, the exit status of the last command,
+// the pipe size and the callbacks. Contexts are independent of each other, but a context must only be used by one thread at a time.
+// The job table, the command hash, the working directory and the environment belong to the process and are shared.
+// The environment is copied from the process when it is first needed; 'export' and 'unset' change both copies, but later
+// setenv() calls of the program are not seen by the programs the shell starts.
+//
+// The library blocks SIGCHLD and receives it through a signalfd, so it never installs a signal handler. It only waits for the
+// children it started itself, other children of the program are left alone.
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#if defined(__GNUC__)
+#define TINYSHELL_API __attribute__((visibility("default")))
+#else
+#define TINYSHELL_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct tinyshell; // A shell context
+struct tinyshell_prepared; // A command line which was parsed once, to be executed any number of times
+
+// Receives the output of the commands of a context, 'fd' being 1 for stdout and 2 for stderr.
+// Programs write straight into a pipe read by the library; builtins write into a buffer delivered when they finish.
+typedef void (*tinyshell_output_callback)(void *data, int fd, const char *buffer, size_t length);
+
+// Receives the result of every pipeline run by a context, those of a command list ('a && b; c') one by one: its text, its exit status
+// and the status of every stage.
+// 'stage_count' is 0 when the line ran inside the shell (a builtin, or a file copy).
+typedef void (*tinyshell_status_callback)(void *data, const char *command, int status, const int *stage_statuses, int stage_count);
+
+TINYSHELL_API struct tinyshell *tinyshell_create(void); // Creating a context, or NULL when out of memory
+TINYSHELL_API void tinyshell_destroy(struct tinyshell *shell);
+
+// Capturing the stdout and stderr of foreground commands instead of writing them to the descriptors of the program.
+// Background jobs and the messages of the shell itself (errors, 'time' reports) are not captured. NULL turns capturing off.
+TINYSHELL_API void tinyshell_set_output_callback(struct tinyshell *shell, tinyshell_output_callback callback, void *data);
+TINYSHELL_API void tinyshell_set_status_callback(struct tinyshell *shell, tinyshell_status_callback callback, void *data);
+
+TINYSHELL_API int tinyshell_run(struct tinyshell *shell, const char *line); // Running one command line, returning the exit status of its last pipeline; the lines of its here-documents follow it after '\n'
+TINYSHELL_API int tinyshell_run_string(struct tinyshell *shell, const char *commands); // Running every line of a string, as '-c' does
+TINYSHELL_API int tinyshell_run_stream(struct tinyshell *shell, int fd, bool interactive); // Running every line read from a descriptor, with a prompt and job control when interactive
+// Running a script file. It is compiled once into $TINYSHELL_CACHE (by default ~/.cache/tinyshell, an empty value turning this off),
+// later runs mapping the compiled form instead of parsing the script again until the file changes. 127 means it could not be opened.
+TINYSHELL_API int tinyshell_run_script(struct tinyshell *shell, const char *path);
+
+TINYSHELL_API struct tinyshell_prepared *tinyshell_prepare(struct tinyshell *shell, const char *line); // Parsing a command line, or NULL on a syntax error (reported on stderr)
+TINYSHELL_API int tinyshell_execute(struct tinyshell *shell, struct tinyshell_prepared *prepared); // Executing a prepared command line, returning its exit status
+TINYSHELL_API void tinyshell_prepared_free(struct tinyshell_prepared *prepared);
+
+TINYSHELL_API int tinyshell_last_status(const struct tinyshell *shell); // The exit status of the last command line
+TINYSHELL_API bool tinyshell_exit_requested(const struct tinyshell *shell); // Whether the 'exit' builtin ran, the status being its argument
+
+// Serving command lines sent over a UNIX socket until SIGINT or SIGTERM, returning 0 then, or non-zero if the server cannot start.
+// Every connection gets a context of its own and sends command lines ending with '\n'. The reply to each line is any number of
+// "out <length>\n" and "err <length>\n" frames, each followed by that many bytes of output, then "exit <status>\n".
+// Clients are served from one event loop: a program runs while the server answers other clients, builtins run in the server itself,
+// and a command list goes on once each of its programs is done. A line which waits inside a single command ('$(...)', 'time',
+// 'memo', 'watch', 'batch', 'wait', 'fg', 'parallel') runs in a child of the server instead, so its changes to the state are not kept.
+// 'exit' closes the connection. Each client starts in the working directory and with the environment of the server, and its 'cd',
+// 'export' and 'unset' only change its own copies; the process itself keeps them. The command hash is shared by every client.
+// Here-documents cannot be used, as every line is a command line.
+TINYSHELL_API int tinyshell_serve(const char *path);
+
+// Completing the word before 'cursor' in 'line', as Tab does: a command name (programs of $PATH and builtins) at the start of a
+// pipeline, a file path elsewhere. Every candidate is passed to 'callback' (directories end with '/'); the number of them is returned.
+TINYSHELL_API size_t tinyshell_complete(const char *line, size_t cursor, void (*callback)(void *data, const char *candidate), void *data);
+
+TINYSHELL_API int tinyshell_select_spawn_backend(const char *name); // Choosing "fork" (the default, also for NULL) or "posix_spawn" for the whole process, 0 on success
+TINYSHELL_API void tinyshell_trace_init(void); // Starting the TINYSHELL_TRACE trace, if that variable names a file
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif